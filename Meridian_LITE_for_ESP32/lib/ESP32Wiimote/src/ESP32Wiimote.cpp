@@ -45,10 +45,26 @@
 //#define UNVERBOSE_PRINT(...) Serial.printf(__VA_ARGS__)
 #define UNVERBOSE_PRINT(...) do {} while(0)
 
+// Each direction owns a fixed pool of packet slots. The pools are allocated
+// once by init(), so a build that never starts the Wiimote pays nothing for
+// them. Free slots are kept in a FreeRTOS queue of pointers, so taking and
+// returning a slot is safe from both the VHCI callbacks and the BT task, and
+// no heap is used after init. The slot counts can be set from build flags.
+#ifndef RX_QUEUE_SIZE
 #define RX_QUEUE_SIZE 32
+#endif
+#ifndef TX_QUEUE_SIZE
 #define TX_QUEUE_SIZE 32
+#endif
 xQueueHandle ESP32Wiimote::rxQueue = NULL;
 xQueueHandle ESP32Wiimote::txQueue = NULL;
+xQueueHandle ESP32Wiimote::rxFreeQueue = NULL;
+xQueueHandle ESP32Wiimote::txFreeQueue = NULL;
+ESP32Wiimote::queuedata_t *ESP32Wiimote::rxPool = NULL;
+ESP32Wiimote::queuedata_t *ESP32Wiimote::txPool = NULL;
+std::atomic<uint32_t> ESP32Wiimote::rxExhausted(0);
+std::atomic<uint32_t> ESP32Wiimote::txExhausted(0);
+std::atomic<uint32_t> ESP32Wiimote::oversized(0);
 
 const TwHciInterface ESP32Wiimote::tinywii_hci_interface = {
   ESP32Wiimote::hciHostSendPacket
@@ -70,6 +86,15 @@ void ESP32Wiimote::notifyHostSendAvailable(void) {
 }
 
 void ESP32Wiimote::createQueue(void) {
+  if (txQueue != NULL){
+    return; // already created by an earlier init()
+  }
+  txPool = (queuedata_t*)malloc(sizeof(queuedata_t) * TX_QUEUE_SIZE);
+  rxPool = (queuedata_t*)malloc(sizeof(queuedata_t) * RX_QUEUE_SIZE);
+  if (txPool == NULL || rxPool == NULL){
+    VERBOSE_PRINTLN("malloc(pool) failed");
+    return;
+  }
   txQueue = xQueueCreate(TX_QUEUE_SIZE, sizeof(queuedata_t*));
   if (txQueue == NULL){
     VERBOSE_PRINTLN("xQueueCreate(txQueue) failed");
@@ -80,6 +105,20 @@ void ESP32Wiimote::createQueue(void) {
     VERBOSE_PRINTLN("xQueueCreate(rxQueue) failed");
     return;
   }
+  txFreeQueue = xQueueCreate(TX_QUEUE_SIZE, sizeof(queuedata_t*));
+  rxFreeQueue = xQueueCreate(RX_QUEUE_SIZE, sizeof(queuedata_t*));
+  if (txFreeQueue == NULL || rxFreeQueue == NULL){
+    VERBOSE_PRINTLN("xQueueCreate(freeQueue) failed");
+    return;
+  }
+  for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+    queuedata_t *slot = &txPool[i];
+    xQueueSend(txFreeQueue, &slot, 0);
+  }
+  for (int i = 0; i < RX_QUEUE_SIZE; i++) {
+    queuedata_t *slot = &rxPool[i];
+    xQueueSend(rxFreeQueue, &slot, 0);
+  }
 }
 
 void ESP32Wiimote::handleTxQueue(void) {
@@ -91,7 +130,7 @@ void ESP32Wiimote::handleTxQueue(void) {
       if(xQueueReceive(txQueue, &queuedata, 0) == pdTRUE){
         esp_vhci_host_send_packet(queuedata->data, queuedata->len);
         UNVERBOSE_PRINT("SEND => %s\n", format2Hex(queuedata->data, queuedata->len));
-        free(queuedata);
+        xQueueSend(txFreeQueue, &queuedata, 0);
       }
     }
   }
@@ -102,35 +141,43 @@ void ESP32Wiimote::handleRxQueue(void) {
     queuedata_t *queuedata = NULL;
     if(xQueueReceive(rxQueue, &queuedata, 0) == pdTRUE){
       handleHciData(queuedata->data, queuedata->len);
-      free(queuedata);
+      xQueueSend(rxFreeQueue, &queuedata, 0);
     }
   }
 }
 
-esp_err_t ESP32Wiimote::sendQueueData(xQueueHandle queue, uint8_t *data, size_t len) {
+esp_err_t ESP32Wiimote::sendQueueData(xQueueHandle queue, xQueueHandle freeQueue, std::atomic<uint32_t> *exhausted,
+                                      uint8_t *data, size_t len) {
     VERBOSE_PRINTLN("sendQueueData");
     if(!data || !len){
         VERBOSE_PRINTLN("no data");
         return ESP_OK;
     }
-    queuedata_t * queuedata = (queuedata_t*)malloc(sizeof(queuedata_t) + len);
-    if(!queuedata){
-        VERBOSE_PRINTLN("malloc failed");
+    if(len > PACKET_DATA_MAX){
+        VERBOSE_PRINTLN("packet too large");
+        oversized.fetch_add(1, std::memory_order_relaxed);
+        return ESP_FAIL;
+    }
+    queuedata_t *queuedata = NULL;
+    if(xQueueReceive(freeQueue, &queuedata, 0) != pdTRUE){
+        VERBOSE_PRINTLN("packet pool exhausted");
+        exhausted->fetch_add(1, std::memory_order_relaxed);
         return ESP_FAIL;
     }
     queuedata->len = len;
     memcpy(queuedata->data, data, len);
     UNVERBOSE_PRINT("RECV <= %s\n", format2Hex(queuedata->data, queuedata->len));
-    if (xQueueSend(queue, &queuedata, portMAX_DELAY) != pdPASS) {
+    // The queue is as long as the pool, so a slot taken from the pool always fits
+    if (xQueueSend(queue, &queuedata, 0) != pdPASS) {
         VERBOSE_PRINTLN("xQueueSend failed");
-        free(queuedata);
+        xQueueSend(freeQueue, &queuedata, 0);
         return ESP_FAIL;
     }
     return ESP_OK;
 }
 
 void ESP32Wiimote::hciHostSendPacket(uint8_t *data, size_t len) {
-  sendQueueData(txQueue, data, len);
+  sendQueueData(txQueue, txFreeQueue, &txExhausted, data, len);
 }
 
 int ESP32Wiimote::notifyHostRecv(uint8_t *data, uint16_t len) {
@@ -141,7 +188,7 @@ int ESP32Wiimote::notifyHostRecv(uint8_t *data, uint16_t len) {
   }
   VERBOSE_PRINTLN("");
 
-  if(ESP_OK == sendQueueData(rxQueue, data, len)){
+  if(ESP_OK == sendQueueData(rxQueue, rxFreeQueue, &rxExhausted, data, len)){
     return ESP_OK;
   }else{
     return ESP_FAIL;
@@ -321,6 +368,15 @@ int ESP32Wiimote::available(void)
         );
 }
 
+ESP32Wiimote::PoolStats ESP32Wiimote::getPoolStats(void)
+{
+    PoolStats stats;
+    stats.rxExhausted = rxExhausted.load(std::memory_order_relaxed);
+    stats.txExhausted = txExhausted.load(std::memory_order_relaxed);
+    stats.oversized = oversized.load(std::memory_order_relaxed);
+    return stats;
+}
+
 ButtonState ESP32Wiimote::getButtonState(void)
 {
   return _buttonState;
@@ -15,6 +15,7 @@
 #ifndef __ESP32_WIIMOTE_H__
 #define __ESP32_WIIMOTE_H__
 
+#include <atomic>
 #include "esp_bt.h"
 #include "TinyWiimote.h"
 
@@ -79,11 +80,22 @@ public:
   NunchukState getNunchukState(void);
   void addFilter(int action, int filter);
 
+  // HCI packet pool counters (cumulative since init)
+  typedef struct {
+          uint32_t rxExhausted; // received packets dropped because no pool slot was free
+          uint32_t txExhausted; // packets to send dropped because no pool slot was free
+          uint32_t oversized;   // packets dropped because they exceed PACKET_DATA_MAX
+  } PoolStats;
+  PoolStats getPoolStats(void);
+
 private:
 
+  // Largest HCI packet kept in a pool slot: H4 type + event header + 255 parameter bytes
+  static const size_t PACKET_DATA_MAX = 260;
+
   typedef struct {
           size_t len;
-          uint8_t data[];
+          uint8_t data[PACKET_DATA_MAX];
   } queuedata_t;
 
   ButtonState _buttonState;
@@ -103,11 +115,20 @@ private:
   static esp_vhci_host_callback_t vhci_callback;
   static xQueueHandle txQueue;
   static xQueueHandle rxQueue;
+  static xQueueHandle txFreeQueue;
+  static xQueueHandle rxFreeQueue;
+  static queuedata_t *txPool; // TX_QUEUE_SIZE slots, allocated by init()
+  static queuedata_t *rxPool; // RX_QUEUE_SIZE slots, allocated by init()
+  // Pool counters. oversized is counted from both the VHCI callback and the BT task
+  static std::atomic<uint32_t> rxExhausted;
+  static std::atomic<uint32_t> txExhausted;
+  static std::atomic<uint32_t> oversized;
 
   static void createQueue(void);
   static void handleTxQueue(void);
   static void handleRxQueue(void);
-  static esp_err_t sendQueueData(xQueueHandle queue, uint8_t *data, size_t len);
+  static esp_err_t sendQueueData(xQueueHandle queue, xQueueHandle freeQueue, std::atomic<uint32_t> *exhausted,
+                                 uint8_t *data, size_t len);
   static void notifyHostSendAvailable(void);
   static int notifyHostRecv(uint8_t *data, uint16_t len);
   static void hciHostSendPacket(uint8_t *data, size_t len);
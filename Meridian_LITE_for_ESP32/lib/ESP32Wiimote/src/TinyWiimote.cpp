@@ -18,6 +18,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <atomic>
 #include <HardwareSerial.h> // for Arduino
 
 #include "time.h"
@@ -956,23 +957,28 @@ static void handleExtensionControllerReports(uint16_t ch, uint16_t channelID, ui
 /**
  * Received Data
  */
+// Single-producer/single-consumer ring. wp is written only by the producer
+// (putWiimoteReceivedData) and rp only by the consumer (TinyWiimoteRead).
+// Both are free-running counters; the slot is the counter modulo the ring size,
+// which must be a power of 2 so that the uint8_t wrap-around stays consistent.
 struct recv_data_rb {
-  uint8_t wp;
-  uint8_t rp;
-  uint8_t cnt;
+  std::atomic<uint8_t> wp;
+  std::atomic<uint8_t> rp;
 };
 static recv_data_rb receivedDataRb;
-#define RECIEVED_DATA_MAX_NUM     (5)
+#define RECIEVED_DATA_MAX_NUM     (8)
+static_assert((RECIEVED_DATA_MAX_NUM & (RECIEVED_DATA_MAX_NUM - 1)) == 0, "ring size must be a power of 2");
 static TinyWiimoteData receivedData[RECIEVED_DATA_MAX_NUM];
 
 void putWiimoteReceivedData(uint8_t number, uint8_t* data, uint8_t len) {
-  if(receivedDataRb.cnt < RECIEVED_DATA_MAX_NUM) {
-    TinyWiimoteData *target = &(receivedData[receivedDataRb.wp]);
+  uint8_t wp = receivedDataRb.wp.load(std::memory_order_relaxed);
+  uint8_t rp = receivedDataRb.rp.load(std::memory_order_acquire);
+  if((uint8_t)(wp - rp) < RECIEVED_DATA_MAX_NUM) {
+    TinyWiimoteData *target = &(receivedData[wp % RECIEVED_DATA_MAX_NUM]);
     memcpy(target->data, data, len);
     target->number = number;
     target->len = len;
-    receivedDataRb.wp = (receivedDataRb.wp + 1) % RECIEVED_DATA_MAX_NUM;
-    receivedDataRb.cnt++;
+    receivedDataRb.wp.store(wp + 1, std::memory_order_release);
   }
   VERBOSE_PRINTLN("");
 }
@@ -1067,25 +1073,24 @@ bool TinyWiimoteDeviceIsInited(void) {
 }
 
 int TinyWiimoteAvailable() {
-  return receivedDataRb.cnt;
+  return (uint8_t)(receivedDataRb.wp.load(std::memory_order_acquire) - receivedDataRb.rp.load(std::memory_order_relaxed));
 }
 
 TinyWiimoteData TinyWiimoteRead() {
   TinyWiimoteData target;
   target.number = 0;
   target.len = 0;
-  if(receivedDataRb.cnt > 0) {
-    target = receivedData[receivedDataRb.rp];
-    receivedDataRb.rp = (receivedDataRb.rp + 1) % RECIEVED_DATA_MAX_NUM;
-    receivedDataRb.cnt--;
+  uint8_t rp = receivedDataRb.rp.load(std::memory_order_relaxed);
+  if(rp != receivedDataRb.wp.load(std::memory_order_acquire)) {
+    target = receivedData[rp % RECIEVED_DATA_MAX_NUM];
+    receivedDataRb.rp.store(rp + 1, std::memory_order_release);
   }
   return target;
 }
 
 void TinyWiimoteInit(TwHciInterface hciInterface) {
-    receivedDataRb.cnt = 0;
-    receivedDataRb.wp = 0;
-    receivedDataRb.rp = 0;
+    receivedDataRb.wp.store(0, std::memory_order_relaxed);
+    receivedDataRb.rp.store(0, std::memory_order_relaxed);
     _hciInterface = hciInterface;
 }
 
@@ -65,6 +65,12 @@ namespace gs2d
 			return (length == data[0]);
 		}
 
+		// 受信フレーム長の判定関数(先頭バイトがフレーム長)
+		int frameLength(uint8_t* data, uint8_t length)
+		{
+			return (data[0] == 0) ? -1 : data[0];
+		}
+
 		// ID不正チェック関数
 		bool checkId(uint8_t id)
 		{
@@ -85,26 +91,29 @@ namespace gs2d
 		{
 			uint32_t tmp = 0;
 
-			// エラーステータスを更新
-			this->errorBits |= status;
+			// 今回の受信のエラー(別スレッドのコマンド追加でerrorBitsが書き換わっても混ざらないようにする)
+			uint8_t error = status;
 
 			do {
 				// エラーがあれば受信を中止
-				if (this->errorBits != 0) break;
+				if (error != 0) break;
 
 				// データ長チェック
-				if (length != data[0]) { this->errorBits |= ResponseError; break; }
+				if (length != data[0]) { error |= ResponseError; break; }
 
 				// チェックサム確認
-				if (calculateCheckSum(data, length) != data[length - 1]) { this->errorBits |= ResponseError; break; }
+				if (calculateCheckSum(data, length) != data[length - 1]) { error |= ResponseError; break; }
 			} while (false);
 
+			// エラーステータスを更新
+			this->errorBits |= error;
+
 			// エラーがあれば強制的に完了処理
-			if (this->errorBits != 0) {
+			if (error != 0) {
 				// コールバックがあれば起動
-				if (this->currentCommand.callback) {
-					CallbackEventArgs e(this->errorBits);
-					this->currentCommand.callback(e);
+				if (this->currentCommand->callback) {
+					CallbackEventArgs e(error);
+					this->currentCommand->callback(e);
 					if (operatingMode) return;
 				}
 				responseData.set((int32_t)0);
@@ -120,21 +129,21 @@ namespace gs2d
 			}
 
 			// エラーがなければ完了処理
-			if (this->currentCommand.responseProcess) {
-				if (this->currentCommand.callback) {
-					CallbackEventArgs e(data[3], this->errorBits, this->currentCommand.responseProcess(tmp));
-					this->currentCommand.callback(e);
+			if (this->currentCommand->responseProcess) {
+				if (this->currentCommand->callback) {
+					CallbackEventArgs e(data[3], error, this->currentCommand->responseProcess(tmp));
+					this->currentCommand->callback(e);
 					if (!operatingMode) isReceived.set(true);
 				}
 				else {
-					responseData = (this->currentCommand.responseProcess(tmp));
+					responseData = (this->currentCommand->responseProcess(tmp));
 					isReceived.set(true);
 				}
 			}
 			else {
-				if (this->currentCommand.callback) {
-					CallbackEventArgs e(data[3], this->errorBits, (int32_t)tmp);
-					this->currentCommand.callback(e);
+				if (this->currentCommand->callback) {
+					CallbackEventArgs e(data[3], error, (int32_t)tmp);
+					this->currentCommand->callback(e);
 					if (!operatingMode) isReceived.set(true);
 				}
 				else {
@@ -164,7 +173,12 @@ namespace gs2d
 
 			// コールバックが無い且つ同期モードの時のみバス待ち
 			if (!operatingMode || callback == 0) {
-				while (!this->isTrafficFree.get());
+				// 即時送信しない設定では返信を戻り値で待つ呼出しは受け付けない
+				if (!this->waitTrafficFree(count != 0)) {
+					delete[] command;
+					this->invalidMode();
+					return EventDataType((int32_t)0);
+				}
 				this->isReceived.set(false);
 			}
 
@@ -172,8 +186,12 @@ namespace gs2d
 			this->errorBits = 0;
 
 			// コマンドを送信
-			this->addCommand(command, bufferLength, responseProcess, callback, count);
+			bool queued = this->addCommand(command, bufferLength, responseProcess, callback, count);
 			delete[] command;
+			if (!queued) {
+				this->errorBits |= SystemError;
+				return EventDataType((int32_t)0);
+			}
 
 			// 不必要なら空データを返す
 			if (operatingMode && callback != 0 || count == 0) return EventDataType((int32_t)0);
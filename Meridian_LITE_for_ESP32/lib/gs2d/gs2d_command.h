@@ -9,6 +9,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "gs2d_type.h"
 #include <inttypes.h>
+#include <string.h>
 
 namespace gs2d
 {
@@ -40,109 +41,228 @@ namespace gs2d
 	class CommandHandler
 	{
 	protected:
-		// 受信タイムアウト
+		// 受信タイムアウト(返信1件あたり。複数の返信を待つコマンドは返信を受け取るたびに数え直す)
 		uint16_t receiveTimeout = 2000; // msec
 
 		// シリアルポート
 		SerialClass serialPort;
 
 		// コマンドバッファ
+		// 送信中のコマンドは完了するまでバッファの先頭に置いたまま参照する
 		CircularBuffer<CommandBufferType<commandSize>, bufferSize> commandStack;
-		CommandBufferType<commandSize> currentCommand;
+		CommandBufferType<commandSize>* currentCommand = nullptr;
 
 		// 受信データ
-		uint8_t response[100];
+		static const uint8_t responseSize = 100;
+		uint8_t response[responseSize];
 		uint8_t responsePos = 0;
 
+		// 受信リングバッファ(位置はuint8_tの桁あふれで一周する)
+		uint8_t rxBuffer[256];
+		uint8_t rxHead = 0;
+		uint8_t rxTail = 0;
+
 		// 継承先の関数
 		virtual bool isComplete(uint8_t* data, uint8_t length) = 0;
 		virtual void dataReceivedEvent(uint8_t* data, uint8_t length, uint8_t status) = 0;
 
+		// 受信フレーム長の判定関数(継承先で上書き可)
+		// フレーム全体の長さを返す。まだ判定できない場合は0、先頭がフレームの開始でない場合は-1
+		// 上書きしない場合は1バイトごとにisComplete()で判定する
+		virtual int frameLength(uint8_t* data, uint8_t length)
+		{
+			return isComplete(data, length) ? length : 0;
+		}
+
 		// 処理ステータス
 		Gs2dType<bool> isTrafficFree;
 
+		// コマンド追加時にすぐ送信するか
+		// falseの場合、追加側はバッファに積むだけで、送信と受信はlistener()を呼ぶスレッドが行う
+		Gs2dType<bool> autoSend;
+
 		// タイマ
 		uint64_t startTime = 0;
 
 		//
-		CommandHandler() : isTrafficFree(true), currentCommand() { serialPort.open(); }
+		CommandHandler() : isTrafficFree(true), autoSend(true) { serialPort.open(); }
 		virtual ~CommandHandler() { serialPort.close(); }
 
 		// コマンド追加関数
-		void addCommand(uint8_t* data, uint8_t length, ResponseProcess response, CallbackType callback, uint8_t count)
+		bool addCommand(uint8_t* data, uint8_t length, ResponseProcess response, CallbackType callback, uint8_t count)
+		{
+			// バッファ内に直接構築する。満杯の場合は即時送信モードなら先頭のコマンドの完了を待つ
+			while (!commandStack.emplace(data, length, count, response, callback))
+			{
+				if (!autoSend.get()) return false;
+				listener();
+			}
+			if (autoSend.get() && isTrafficFree.get()) sendCommand();
+			return true;
+		}
+
+		// 返信を待つ前のバス待ち
+		// 即時送信しない設定では送受信はlistener()を呼ぶ別のスレッドが行うため待たない。
+		// この場合、返信を待つ呼出し(needResponse)は受信側が二重になるので受け付けずfalseを返す
+		bool waitTrafficFree(bool needResponse)
 		{
-			CommandBufferType<commandSize> command(data, length, count, response, callback);
-			commandStack.push(command);
-			if (isTrafficFree.get()) sendCommand();
+			if (!autoSend.get()) return !needResponse;
+			while (!isTrafficFree.get());
+			return true;
 		}
 
-		// コマンド送信
-		void sendCommand()
+		// コマンド送信(継承先で上書き可)
+		virtual void sendCommand()
 		{
-			// コマンドを取り出して送信
-			currentCommand = commandStack.pop();
-			serialPort.write(currentCommand.data, currentCommand.length);
+			// 先頭のコマンドを送信
+			while ((currentCommand = commandStack.front()) != nullptr)
+			{
+				serialPort.write(currentCommand->data, currentCommand->length);
 
-			// リスナ初期化
-			// 受信個数が0個でも無視
-			if (currentCommand.count == 0) {
-				// コマンドがたまっている場合は送信
-				if (!commandStack.isEmpty()) sendCommand();
-				else isTrafficFree.set(true);
+				// リスナ初期化
+				if (currentCommand->count != 0) {
+					responsePos = 0;
+					rxTail = rxHead;
+					isTrafficFree.set(false);
+					startTime = serialPort.time();
+					return;
+				}
+
+				// 受信個数が0個なら破棄して次のコマンドへ
+				commandStack.drop();
+			}
+			isTrafficFree.set(true);
+		}
+
+		// 送信中のコマンドを破棄し、コマンドがたまっている場合は送信
+		void finishCommand()
+		{
+			currentCommand = nullptr;
+			commandStack.drop();
+			sendCommand();
+		}
+
+	public:
+		// コマンド追加時の即時送信の切替
+		// falseにすると、追加側(例:制御用のコア)はバッファに積むだけになり、
+		// listener()を呼ぶ側(例:別コアのバスタスク)が送信と受信を行う。この場合は返信をコールバックで受け取ること
+		// (返信を戻り値で待つ呼出しはBadInputErrorで失敗し、バッファが満杯の場合はSystemErrorで失敗する)
+		void setAutoSend(bool enable) { autoSend.set(enable); }
+
+	protected:
+		// SerialClassに一括読み込み関数 read(uint8_t*, int) があれば使い、なければ1バイトずつ読む
+		template<class S>
+		static auto serialRead(S& serial, uint8_t* data, int size, int) -> decltype(serial.read(data, size))
+		{
+			return serial.read(data, size);
+		}
+		template<class S>
+		static int serialRead(S& serial, uint8_t* data, int size, long)
+		{
+			int count = 0;
+			while (count < size) {
+				int tmp = serial.read();
+				if (tmp == -1) break;
+				data[count++] = (uint8_t)tmp;
+			}
+			return count;
+		}
+
+		// シリアルポートの受信済みデータをすべて受信リングバッファに取り込む
+		void fillRxBuffer(void)
+		{
+			while (true) {
+				// 空き領域のうち連続する部分
+				uint8_t space = (uint8_t)(rxTail - rxHead - 1);
+				if (space == 0) return;
+				int chunk = 256 - rxHead;
+				if (chunk > space) chunk = space;
+
+				int count = serialRead(serialPort, &rxBuffer[rxHead], chunk, 0);
+				if (count <= 0) return;
+				rxHead += (uint8_t)count;
+				if (count < chunk) return;
 			}
-			else {
-				responsePos = 0;
-				isTrafficFree.set(false);
-				startTime = serialPort.time();
+		}
+
+		// 受信リングバッファから最大size個を取り出す
+		uint8_t takeRxBuffer(uint8_t* data, uint8_t size)
+		{
+			uint8_t count = 0;
+			while (count < size && rxTail != rxHead) data[count++] = rxBuffer[rxTail++];
+			return count;
+		}
+
+		// 受信フレーム1個分の完了処理
+		void frameReceived(uint8_t status)
+		{
+			dataReceivedEvent(response, responsePos, status);
+			responsePos = 0;
+
+			// 全サーボ受信完了チェック
+			currentCommand->count--;
+			if (currentCommand->count == 0) {
+				// コマンドがたまっている場合は送信
+				finishCommand();
+				return;
 			}
+
+			// 次の返信のタイムアウトを数え直す
+			startTime = serialPort.time();
 		}
 
 		// リスナー関数
 		void listener(void)
 		{
-			// 無意味なデータを無視
-			if (isTrafficFree.get()) return;
+			// 待機中はたまったコマンドの送信のみ
+			if (isTrafficFree.get()) {
+				if (!commandStack.isEmpty()) sendCommand();
+				return;
+			}
 
 			if (serialPort.isConnected())
 			{
-				// タイムアウト確認
-				if (serialPort.time() > startTime + receiveTimeout)
+				// 受信済みのデータをまとめて取り込み、フレームの区切りを探す
+				fillRxBuffer();
+				while (!isTrafficFree.get())
 				{
-					// タイムアウトを通知
-					dataReceivedEvent(0, 0, TimeoutError);
+					int length = (responsePos > 0) ? frameLength(response, responsePos) : 0;
 
-					// コマンドがたまっている場合は送信
-					if (!commandStack.isEmpty()) sendCommand();
-					else isTrafficFree.set(true);
-
-					return;
-				}
+					// フレームの開始でなければ先頭を1バイト捨てて同期し直す
+					if (length < 0) {
+						responsePos--;
+						memmove(response, response + 1, responsePos);
+						continue;
+					}
 
-				// データが無ければ終了
-				int data = serialPort.read();
-				if (data == -1) return;
+					// 受信完了
+					if (length > 0 && responsePos >= length) {
+						frameReceived(0);
+						continue;
+					}
 
-				// 受信データ保存
-				response[responsePos++] = data;
+					// バッファに収まらないフレームは受信エラーとして捨てる
+					if (length > responseSize || (length == 0 && responsePos >= responseSize)) {
+						frameReceived(ResponseError);
+						continue;
+					}
 
-				// TODO:エラー処理
-				if (responsePos >= 100) responsePos = 0;
+					// 長さが分かっていれば不足分をまとめて、分からなければ1バイトずつ取り出す
+					uint8_t need = (length > 0) ? (uint8_t)(length - responsePos) : 1;
+					uint8_t count = takeRxBuffer(&response[responsePos], need);
+					if (count == 0) break;
+					responsePos += count;
+				}
+				if (isTrafficFree.get()) return;
 
-				// 受信完了チェック
-				if (isComplete(response, responsePos))
+				// タイムアウト確認
+				if (serialPort.time() > startTime + receiveTimeout)
 				{
-					dataReceivedEvent(response, responsePos, 0);
-
-					// 全サーボ受信完了チェック
-					currentCommand.count--;
-					if (currentCommand.count == 0) {
-						// コマンドがたまっている場合は送信
-						if (!commandStack.isEmpty()) sendCommand();
-						else isTrafficFree.set(true);
-					}
-					else {
-						responsePos = 0;
-					}
+					// タイムアウトを通知
+					dataReceivedEvent(0, 0, TimeoutError);
+
+					// コマンドがたまっている場合は送信
+					finishCommand();
 				}
 			}
 		}
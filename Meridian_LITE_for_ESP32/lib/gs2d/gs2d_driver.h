@@ -18,8 +18,11 @@ namespace gs2d
 	{
 	protected:
 		// エラーコード保存用（例外発生はしない）
-		uint8_t errorBits = 0;
+		// コマンドを追加するスレッドとlistener()を呼ぶスレッドの両方から更新するためatomicとする
+		std::atomic<uint8_t> errorBits{ 0 };
 		void notSupport(void) { errorBits |= NotSupportError; }
+		// 現在の動作モードでは使えない機能を呼んだ場合
+		void invalidMode(void) { errorBits |= BadInputError; }
 		void badInput(void) {
 			errorBits |= BadInputError;
 		}
@@ -52,6 +52,14 @@ namespace gs2d
             return (length >= data[5] + 8);
         }
 
+        // 受信フレーム長の判定関数(ヘッダ FD DF で同期する)
+        int frameLength(uint8_t* data, uint8_t length)
+        {
+            if (data[0] != 0xFD || (length >= 2 && data[1] != 0xDF)) return -1;
+            if (length < 6) return 0;
+            return data[5] + 8;
+        }
+
         // ID不正チェック関数
         bool checkId(uint8_t id)
         {
@@ -72,23 +80,26 @@ namespace gs2d
         {
             uint32_t tmp = 0;
 
-            // エラーステータスを更新
-            this->errorBits |= status;
+            // 今回の受信のエラー(別スレッドのコマンド追加でerrorBitsが書き換わっても混ざらないようにする)
+            uint8_t error = status;
 
             do {
                 // エラーがあれば受信を中止
-                if (this->errorBits != 0) break;
+                if (error != 0) break;
 
                 // チェックサム確認
-                if (data[length - 1] != calculateCheckSum(data, length)) { this->errorBits |= ResponseError; break; }
+                if (data[length - 1] != calculateCheckSum(data, length)) { error |= ResponseError; break; }
             } while (false);
 
+            // エラーステータスを更新
+            this->errorBits |= error;
+
             // エラーがあれば強制的に完了処理
-            if (this->errorBits != 0) {
+            if (error != 0) {
                 // コールバックがあれば起動
-                if (this->currentCommand.callback) {
-                    CallbackEventArgs e(this->errorBits);
-                    this->currentCommand.callback(e);
+                if (this->currentCommand->callback) {
+                    CallbackEventArgs e(error);
+                    this->currentCommand->callback(e);
                     if (operatingMode) return;
                 }
                 responseData.set((int32_t)0);
@@ -104,21 +115,21 @@ namespace gs2d
             }
 
             // エラーがなければ完了処理
-            if (this->currentCommand.responseProcess) {
-                if (this->currentCommand.callback) {
-                    CallbackEventArgs e(data[2], this->errorBits, this->currentCommand.responseProcess(tmp));
-                    this->currentCommand.callback(e);
+            if (this->currentCommand->responseProcess) {
+                if (this->currentCommand->callback) {
+                    CallbackEventArgs e(data[2], error, this->currentCommand->responseProcess(tmp));
+                    this->currentCommand->callback(e);
                     if (!operatingMode) isReceived.set(true);
                 }
                 else {
-                    responseData = (this->currentCommand.responseProcess(tmp));
+                    responseData = (this->currentCommand->responseProcess(tmp));
                     isReceived.set(true);
                 }
             }
             else {
-                if (this->currentCommand.callback) {
-                    CallbackEventArgs e(data[2], this->errorBits, (int32_t)tmp);
-                    this->currentCommand.callback(e);
+                if (this->currentCommand->callback) {
+                    CallbackEventArgs e(data[2], error, (int32_t)tmp);
+                    this->currentCommand->callback(e);
                     if (!operatingMode) isReceived.set(true);
                 }
                 else {
@@ -147,8 +158,9 @@ namespace gs2d
             this->errorBits = 0;
 
             // コマンド送信
-            this->addCommand(command, bufferLength, responseProcess, callback, 0);
+            bool queued = this->addCommand(command, bufferLength, responseProcess, callback, 0);
             delete[] command;
+            if (!queued) this->errorBits |= SystemError;
         }
 
         EventDataType getFunction(uint8_t id, uint8_t address, uint8_t flag, uint8_t length, ResponseProcess responseProcess = 0, CallbackType callback = 0)
@@ -165,7 +177,12 @@ namespace gs2d
 
             // コールバックが無い且つ同期モードの時のみバス待ち
             if (!operatingMode || callback == 0) {
-                while (!this->isTrafficFree.get());
+                // 即時送信しない設定では返信を戻り値で待つ呼出しは受け付けない
+                if (!this->waitTrafficFree(true)) {
+                    delete[] command;
+                    this->invalidMode();
+                    return EventDataType((int32_t)0);
+                }
                 this->isReceived.set(false);
             }
 
@@ -173,8 +190,12 @@ namespace gs2d
             this->errorBits = 0;
 
             // コマンドを送信
-            this->addCommand(command, bufferLength, responseProcess, callback, 1);
+            bool queued = this->addCommand(command, bufferLength, responseProcess, callback, 1);
             delete[] command;
+            if (!queued) {
+                this->errorBits |= SystemError;
+                return EventDataType((int32_t)0);
+            }
 
             // 不必要なら空データを返す
             if (operatingMode && callback != 0) return EventDataType((int32_t)0);
@@ -209,7 +230,7 @@ namespace gs2d
 
             // コールバックが無い且つ同期モードの時のみバス待ち
             if (!operatingMode || callback == 0) {
-                while (!this->isTrafficFree.get());
+                this->waitTrafficFree(false);
                 this->isReceived.set(false);
             }
 
@@ -217,8 +238,9 @@ namespace gs2d
             this->errorBits = 0;
 
             // コマンドを送信
-            this->addCommand(command, bufferLength, responseProcess, callback, 0);
+            bool queued = this->addCommand(command, bufferLength, responseProcess, callback, 0);
             delete[] command;
+            if (!queued) this->errorBits |= SystemError;
         }
         void spin() { this->listener(); }
 
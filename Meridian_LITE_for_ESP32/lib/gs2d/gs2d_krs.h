@@ -34,21 +34,35 @@ namespace gs2d
 	    
 
 		// EEPROM用に関数二つをoverride
-		void addCommand(uint8_t* data, uint8_t length, ResponseProcess response, CallbackType callback, KRSTarget target = { 0, 0 })
+		// バッファが満杯の場合は、即時送信モードなら先頭のコマンドの完了を待ち、そうでなければfalseを返す
+		bool addCommand(uint8_t* data, uint8_t length, ResponseProcess response, CallbackType callback, KRSTarget target = { 0, 0 })
 		{
-			CommandBufferType<commandSize> command(data, length, 1, response, callback);
-			this->commandStack.push(command);
+			while (this->commandStack.isFull())
+			{
+				if (!this->autoSend.get()) return false;
+				this->listener();
+			}
+
+			// 別スレッドのlistener()がコマンドを見つけた時点で読込み先が積まれているよう、読込み先を先に積む
 			targetStack.push(target);
-			if (this->isTrafficFree.get()) sendCommand();
+			this->commandStack.emplace(data, length, 1, response, callback);
+			if (this->autoSend.get() && this->isTrafficFree.get()) sendCommand();
+			return true;
 		}
 
-		void sendCommand()
+		// listener()の完了処理からも呼ばれるため、読込み先(targetStack)もコマンドと一緒に進める
+		void sendCommand() override
 		{
-			this->currentCommand = this->commandStack.pop();
+			this->currentCommand = this->commandStack.front();
+			if (this->currentCommand == nullptr) {
+				this->isTrafficFree.set(true);
+				return;
+			}
 			currentTarget = targetStack.pop();
-			this->serialPort.write(this->currentCommand.data, this->currentCommand.length);
+			this->serialPort.write(this->currentCommand->data, this->currentCommand->length);
 
 			this->responsePos = 0;
+			this->rxTail = this->rxHead;
 			this->isTrafficFree.set(false);
 			this->startTime = this->serialPort.time();
 		}
@@ -106,14 +120,15 @@ namespace gs2d
 		{
 			uint32_t tmp = 0;
 
-			// エラーステータスを更新
-			this->errorBits |= status;
+			// 今回の受信のエラー(別スレッドのコマンド追加でerrorBitsが書き換わっても混ざらないようにする)
+			uint8_t error = status;
+			this->errorBits |= error;
 
 			// エラーがあれば強制的に完了処理
-			if (this->errorBits != 0) {
-				if (this->currentCommand.callback) {
-					CallbackEventArgs e(this->errorBits);
-					this->currentCommand.callback(e);
+			if (error != 0) {
+				if (this->currentCommand->callback) {
+					CallbackEventArgs e(error);
+					this->currentCommand->callback(e);
 					if (operatingMode) return;
 				}
 				responseData.set((int32_t)0);
@@ -165,21 +180,21 @@ namespace gs2d
 			}
 
 			// エラーがなければ完了処理
-			if (this->currentCommand.responseProcess) {
-				if (this->currentCommand.callback) {
-					CallbackEventArgs e(data[0] & 0b11111, this->errorBits, this->currentCommand.responseProcess(tmp));
-					this->currentCommand.callback(e);
+			if (this->currentCommand->responseProcess) {
+				if (this->currentCommand->callback) {
+					CallbackEventArgs e(data[0] & 0b11111, error, this->currentCommand->responseProcess(tmp));
+					this->currentCommand->callback(e);
 					if (!operatingMode) isReceived.set(true);
 				}
 				else {
-					responseData = (this->currentCommand.responseProcess(tmp));
+					responseData = (this->currentCommand->responseProcess(tmp));
 					isReceived.set(true);
 				}
 			}
 			else {
-				if (this->currentCommand.callback) {
-					CallbackEventArgs e(data[0] & 0b11111, this->errorBits, (int32_t)tmp);
-					this->currentCommand.callback(e);
+				if (this->currentCommand->callback) {
+					CallbackEventArgs e(data[0] & 0b11111, error, (int32_t)tmp);
+					this->currentCommand->callback(e);
 					if (!operatingMode) isReceived.set(true);
 				}
 				else {
@@ -193,7 +208,11 @@ namespace gs2d
 		{
 			// コールバックが無い且つ同期モードの時のみバス待ち
 			if (!operatingMode || callback == 0) {
-				while (!this->isTrafficFree.get());
+				// 即時送信しない設定では返信を戻り値で待つ呼出しは受け付けない
+				if (!this->waitTrafficFree(true)) {
+					this->invalidMode();
+					return EventDataType((int32_t)0);
+				}
 				this->isReceived.set(false);
 			}
 
@@ -201,7 +220,10 @@ namespace gs2d
 			this->errorBits = 0;
 
 			// コマンドを送信
-			this->addCommand(command, length, responseProcess, callback, target);
+			if (!this->addCommand(command, length, responseProcess, callback, target)) {
+				this->errorBits |= SystemError;
+				return EventDataType((int32_t)0);
+			}
 
 			// 不必要なら空データを返す
 			if (operatingMode && callback != 0) return EventDataType((int32_t)0);
@@ -74,6 +74,17 @@ namespace gs2d
 			return (length >= data[5] + 7);
 		}
 
+		// 受信フレーム長の判定関数(ヘッダ FF FF FD 00 で同期する)
+		int frameLength(uint8_t* data, uint8_t length)
+		{
+			static const uint8_t header[4] = { 0xFF, 0xFF, 0xFD, 0x00 };
+			for (uint8_t i = 0; i < length && i < 4; i++) {
+				if (data[i] != header[i]) return -1;
+			}
+			if (length < 7) return 0;
+			return data[5] + (data[6] << 8) + 7;
+		}
+
 		// ID不正チェック関数
 		bool checkId(uint8_t id)
 		{
@@ -87,36 +98,39 @@ namespace gs2d
 			uint32_t tmp = 0; // パラメータ用
 			uint16_t paramLength = 0;
 
-			// エラーステータスを更新
-			this->errorBits |= status;
+			// 今回の受信のエラー(別スレッドのコマンド追加でerrorBitsが書き換わっても混ざらないようにする)
+			uint8_t error = status;
 
 			do {
 				// エラー状態チェック
-				if (this->errorBits != 0) break;
+				if (error != 0) break;
 
 				// 最低限の長さがあるか確認
-				if (length < 9) { this->errorBits |= ResponseError; break; }
+				if (length < 9) { error |= ResponseError; break; }
 
 				// インストラクション値を確認
-				if (data[7] != 0x55) { this->errorBits |= ResponseError; break; }
+				if (data[7] != 0x55) { error |= ResponseError; break; }
 
 				// Lengthを取得して確認
 				paramLength = (data[5] + (data[6] << 8));
-				if (length != paramLength + 7) { this->errorBits |= ResponseError; break; }
+				if (length != paramLength + 7) { error |= ResponseError; break; }
 
 				// Errorバイトを確認
-				if (data[8] != 0) { this->errorBits |= ProtocolError; break; }
+				if (data[8] != 0) { error |= ProtocolError; break; }
 
 				// CheckSum検証
 				uint16_t crc = data[length - 2] + (data[length - 1] << 8);
-				if (crc != crc16::calculate(data, length - 2)) { this->errorBits |= ResponseError; break; }
+				if (crc != crc16::calculate(data, length - 2)) { error |= ResponseError; break; }
 			} while (false);
 
+			// エラーステータスを更新
+			this->errorBits |= error;
+
 			// エラーがあれば終了
-			if (this->errorBits != 0) {
-				if (this->currentCommand.callback) {
-					CallbackEventArgs e(this->errorBits);
-					this->currentCommand.callback(e);
+			if (error != 0) {
+				if (this->currentCommand->callback) {
+					CallbackEventArgs e(error);
+					this->currentCommand->callback(e);
 					if (operatingMode) return;
 				}
 				responseData.set((int32_t)0);
@@ -133,21 +147,21 @@ namespace gs2d
 			}
 
 			// データをコールバックか戻り値へ
-			if (this->currentCommand.responseProcess) {
-				if (this->currentCommand.callback) {
-					CallbackEventArgs e(data[4], this->errorBits, this->currentCommand.responseProcess(tmp));
-					this->currentCommand.callback(e);
+			if (this->currentCommand->responseProcess) {
+				if (this->currentCommand->callback) {
+					CallbackEventArgs e(data[4], error, this->currentCommand->responseProcess(tmp));
+					this->currentCommand->callback(e);
 					if (!operatingMode) isReceived.set(true);
 				}
 				else {
-					responseData = (this->currentCommand.responseProcess(tmp));
+					responseData = (this->currentCommand->responseProcess(tmp));
 					isReceived.set(true);
 				}
 			}
 			else {
-				if (this->currentCommand.callback) {
-					CallbackEventArgs e(data[4], this->errorBits, (int32_t)tmp);
-					this->currentCommand.callback(e);
+				if (this->currentCommand->callback) {
+					CallbackEventArgs e(data[4], error, (int32_t)tmp);
+					this->currentCommand->callback(e);
 					if (!operatingMode) isReceived.set(true);
 				}
 				else {
@@ -203,13 +217,22 @@ namespace gs2d
 
 			// バス待ち
 			if (!operatingMode || callback == 0) {
-				while (!this->isTrafficFree.get());
+				// 即時送信しない設定では返信を戻り値で待つ呼出しは受け付けない
+				if (!this->waitTrafficFree(count != 0)) {
+					delete[] command;
+					this->invalidMode();
+					return EventDataType((int32_t)0);
+				}
 				this->isReceived.set(false);
 			}
 
 			// 送信
-			this->addCommand(command, bufferLength, responseProcess, callback, count);
+			bool queued = this->addCommand(command, bufferLength, responseProcess, callback, count);
 			delete[] command;
+			if (!queued) {
+				this->errorBits |= SystemError;
+				return EventDataType((int32_t)0);
+			}
 
 			// 不必要なら空データを返す
 			if (operatingMode && callback != 0 || count == 0) return EventDataType((int32_t)0);
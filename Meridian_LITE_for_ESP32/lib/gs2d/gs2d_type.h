@@ -4,15 +4,17 @@
 * @date    2021/01/26
 * @brief
 *
-* マルチスレッド処理を行った際、データ入出力にエラーが起こる場合は
-* 以下のクラスを環境向けにスレッドセーフに組み直す必要があるかも知れません。
-* CircularBuffer, ThreadSafeType
+* CircularBufferは1対1(書き込み1スレッド、読み出し1スレッド)のロックフリーなリングバッファ、
+* Gs2dTypeはacquire/releaseで読み書きするatomicな変数です。
 *
 */
 #pragma once
 
 /* Includes ------------------------------------------------------------------*/
 #include <inttypes.h>
+#include <atomic>
+#include <new>
+#include <utility>
 
 namespace gs2d
 {
@@ -68,53 +70,87 @@ namespace gs2d
 		~CallbackEventArgs() {}
 	};
 
+	// 2のべき乗への切り上げ
+	constexpr uint32_t ceilPow2(uint32_t value, uint32_t pow = 1)
+	{
+		return (pow >= value) ? pow : ceilPow2(value, pow << 1);
+	}
+
 	// gs2d用サーキュラバッファクラス
-	template<class T, unsigned char bufferSize = 50>
+	// 書き込み側と読み出し側がそれぞれ1スレッドであれば、別コアからでもロックなしで使える。
+	// 容量はbufferSizeを2のべき乗に切り上げた数で、位置は割り算せずに進め続けてマスクで要素を選ぶ。
+	template<class T, unsigned int bufferSize = 50>
 	class CircularBuffer
 	{
+	public:
+		static constexpr uint32_t capacity = ceilPow2(bufferSize);
+
 	private:
-		T buffer[bufferSize];
-		volatile uint8_t writePos = 0;
-		volatile uint8_t readPos = 0;
-		uint8_t size;
+		static constexpr uint32_t mask = capacity - 1;
+		T buffer[capacity];
+		std::atomic<uint32_t> writePos{ 0 };
+		std::atomic<uint32_t> readPos{ 0 };
 
 	public:
-		CircularBuffer() : size(bufferSize) {}
+		CircularBuffer() {}
 		virtual ~CircularBuffer() {}
 
-		inline bool push(T data)
+		// [書き込み側] 要素をバッファ内に直接構築して追加
+		template<class... Args>
+		inline bool emplace(Args&&... args)
 		{
-			uint8_t tempPos = (uint8_t)((writePos + 1) % size);
-			if (tempPos == readPos) return false;
-			buffer[writePos++] = data;
-			writePos %= size;
+			const uint32_t w = writePos.load(std::memory_order_relaxed);
+			if (w - readPos.load(std::memory_order_acquire) >= capacity) return false;
+			T* slot = &buffer[w & mask];
+			slot->~T();
+			new (slot) T(std::forward<Args>(args)...);
+			writePos.store(w + 1, std::memory_order_release);
 			return true;
 		}
 
+		// [書き込み側] 要素をコピーして追加
+		inline bool push(const T& data) { return emplace(data); }
+
+		// [読み出し側] 先頭の要素を取り出さずに参照(空の場合はnullptr)
+		inline T* front(void)
+		{
+			const uint32_t r = readPos.load(std::memory_order_relaxed);
+			if (r == writePos.load(std::memory_order_acquire)) return nullptr;
+			return &buffer[r & mask];
+		}
+
+		// [読み出し側] 先頭の要素を破棄して領域を書き込み側に返す
+		inline void drop(void)
+		{
+			const uint32_t r = readPos.load(std::memory_order_relaxed);
+			if (r != writePos.load(std::memory_order_acquire)) readPos.store(r + 1, std::memory_order_release);
+		}
+
+		// [読み出し側] 先頭の要素をコピーして取り出す(空の場合は直前の要素)
 		inline T pop(void)
 		{
-			uint8_t tmpPos = readPos;
-			if (writePos != readPos) {
-				readPos++; readPos %= size;
-			}
-			return buffer[tmpPos];
+			const uint32_t r = readPos.load(std::memory_order_relaxed);
+			T data = buffer[r & mask];
+			drop();
+			return data;
 		}
 
-		bool isEmpty() { return (writePos == readPos); }
+		bool isEmpty() { return writePos.load(std::memory_order_acquire) == readPos.load(std::memory_order_acquire); }
+		bool isFull() { return writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire) >= capacity; }
 	};
 
-	// スレッドセーフにする必要があるかもしれないので、念の為
+	// 別スレッドから読み書きするフラグ等の型
 	template<class T>
 	class Gs2dType
 	{
 	private:
-		volatile T variable;
+		std::atomic<T> variable;
 
 	public:
-		inline void set(T data) { variable = data; }
-		inline T get(void) { return variable; }
+		inline void set(T data) { variable.store(data, std::memory_order_release); }
+		inline T get(void) { return variable.load(std::memory_order_acquire); }
 
-		Gs2dType(T data) { variable = data; }
+		Gs2dType(T data) : variable(data) {}
 		~Gs2dType() {}
 	};
 
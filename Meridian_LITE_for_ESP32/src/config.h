@@ -106,7 +106,18 @@
 // [...]     ...
 // [78]      サーボID R14 コマンド
 // [79]      サーボID R14 データ値
-// [80]-[MRDM_LEN-3] free (Meridim90では[87]まで)
+// [80]      L系統サーボの通信不能ビットマップ (MRD_SERVO_ERR_L)
+// [81]      R系統サーボの通信不能ビットマップ (MRD_SERVO_ERR_R)
+// [82]      巡回テレメトリの項目番号 (MRD_TELEM_KEY)
+// [83]      巡回テレメトリの値 (MRD_TELEM_VAL)
+// [84]      IMU/AHRS値の計測からの経過時間 (MRD_IMU_AGE)
+// [85]      別送したIMU一括データグラムのサンプル数 (MRD_IMU_BATCH)
+// [86]      押されたボタンのラッチ (MRD_PAD_LATCH)
+// [87]      ボタンの押下と解放のエッジの累計 (MRD_PAD_EVENTS)
+// [88]-[117] サーボID C0-C14 コマンド/データ値 (MOUNT_SERVO_LINE_C が1の拡張フレームのみ)
+// [MRD_EST_ORIGIDX]- 推定位置/推定速度 (SERVO_ESTIMATOR が1の拡張フレームのみ)
+//                    系統ごとにサーボ15個分の 推定位置(degree*100),推定速度(degree/s*10) の組,
+//                    続いて系統ごとの外挿フラグのビットマップ(今回のフレームで返信がなく予測値を出したサーボ)
 // [MRDM_LEN-2] ERROR CODE
 // [MRDM_LEN-1] チェックサム
 
@@ -116,17 +127,24 @@
 
 // VR射的用カウント
 #define VRSHATEKI_CENTERING_TIMER 300    // VR射的でセンタリングに費やす時間
-#define SERVO_MOVE_LIMIT 3               // 1フレームあたりのサーボ移動のリミット値（degree)
+#define SERVO_MOVE_LIMIT 3               // 動作プロファイルの最大速度の既定値(degree/frame, 0:制限なし)
+#define SERVO_PROFILE_ACC 0              // 動作プロファイルの最大加速度の既定値(degree*100/frame^2, 0:制限なし)
+#define SERVO_PROFILE_JERK 0             // 動作プロファイルの最大躍度の既定値(degree*100/frame^3, 0:制限なし)
 #define VRSHATEKI_TRIGGER_ANGLE 30       // VR射的でトリガーを引く時のサーボ位置
 #define VRSHATEKI_TRIGGER_SERVO_NUMBER 0 // VR射的でトリガーを引く時のサーボ位置
 
 // Meridimの基本設定
-#define MRDM_LEN 90        // Meridim配列の長さ設定(デフォルトは90)
+#define MRDM_LEN (90 + (MOUNT_SERVO_LINE_C ? 30 : 0) + MRD_EST_LEN) // Meridim配列の長さ(デフォルトは90, C系統と推定値の分を拡張)
 #define FRAME_DURATION 10  // 1フレームあたりの単位時間(単位ms, デフォルトは10)
 #define CHARGE_TIME 200    // 起動時のコンデンサチャージ待機時間(単位ms)
 #define MRD_L_ORIGIDX 20   // Meridim配列のL系統の最初のインデックス(デフォルトは20)
 #define MRD_R_ORIGIDX 50   // Meridim配列のR系統の最初のインデックス(デフォルトは50)
+#define MRD_C_ORIGIDX 88   // Meridim配列のC系統の最初のインデックス(拡張フレームのみ)
 #define MRD_SERVO_SLOTS 15 // Meridim配列の1系統あたりの最大接続サーボ数(デフォルトは15)
+#define MOUNT_SERVO_LINE_C 0 // 第3のサーボ系統Cを使うか(0:NO, 1:YES). 使う場合はMeridim配列を120に拡張する
+#define MRD_SERVO_LINES (MOUNT_SERVO_LINE_C ? 3 : 2) // サーボの系統数(L,R / L,R,C)
+#define MRD_EST_ORIGIDX (MOUNT_SERVO_LINE_C ? 118 : 88) // Meridim配列の推定値の最初のインデックス(拡張フレームのみ)
+#define MRD_EST_LEN (SERVO_ESTIMATOR ? MRD_SERVO_LINES * (MRD_SERVO_SLOTS * 2 + 1) : 0) // 推定値の拡張分の長さ
 
 // 各種ハードウェアのマウント有無
 #define MOUNT_SD 0                // SDカードリーダーの有無s(0:なし, 1:あり)
@@ -137,6 +155,8 @@
 #define MODE_ESP32_STANDALONE 0 // ESP32をボードに挿さず動作確認(0:NO, 1:YES)
 #define MODE_UDP_RECEIVE 1      // PCからのデータ受信(0:OFF, 1:ON, 通常は1)
 #define MODE_UDP_SEND 1         // PCへのデータ送信(0:OFF, 1:ON, 通常は1)
+#define MODE_KEYFRAME 0         // PCからの目標値をキーフレームとしてボード上で補間(0:OFF, 1:ON)
+#define KEYFRAME_CURVE 0        // キーフレーム補間の曲線(0:3次エルミート, 1:5次エルミート(速度0からは最小躍度))
 
 // Wifi/有線LANの設定(SSID, パスワード, 固定IP, MACアドレス等は別途keys.hで指定)
 #define MODE_ETHER 1    // WiFiか有線LANか(0:wifi, 1:有線LAN, 通常は0)
@@ -166,8 +186,21 @@
 
 // I2C設定, I2Cセンサ関連設定
 #define I2C0_SPEED 400000   // I2Cの速度(400kHz推奨)
+#define I2C_BUS_MANAGER 1   // I2Cを管理スレッド経由で使う(0:センサ用スレッドが直接使う, 1:管理スレッドが優先度順に実行)
 #define IMUAHRS_INTERVAL 10 // IMU/AHRSのセンサの読み取り間隔(ms)
-#define IMUAHRS_STOCK 4     // MPUで移動平均を取る際の元にする時系列データの個数
+#define IMUAHRS_TIMER 1     // IMU/AHRSの読み取り周期を作るハードウェアタイマーの番号(0はフレーム用)
+#define MPU6050_RAW_FUSION 0    // MPU6050の姿勢推定(0:DMP, 1:生値を高速に読みボード上のMahonyフィルタで推定)
+#define MPU6050_RAW_PERIOD 1000 // MPU6050の生値の読み取り周期(us). 1000で1kHz
+#define MAHONY_KP 1.0f          // Mahonyフィルタの比例ゲイン
+#define MAHONY_KI 0.0f          // Mahonyフィルタの積分ゲイン(ジャイロのバイアス推定)
+#define IMUAHRS_STOCK 32    // AHRSのフィルタバンクの移動平均の窓の最大長
+#define IMU_BATCH_SEND 0    // 前フレーム以降の全IMUサンプルを別のデータグラムでUDP_IMU_SEND_PORTに送る(0:OFF, 1:ON)
+#define IMU_RING_LEN 64     // 送信待ちのIMUサンプルのリングの長さ(2のべき乗)
+#define IMU_BATCH_MAX 32    // 1つのデータグラムに詰める最大のサンプル数
+#define BNO055_I2C_ADDR 0x28 // BNO055のI2Cアドレス
+#define BNO055_BURST_READ 1  // BNO055のデータレジスタを1回のI2C通信でまとめて読む(0:項目ごとに読む, 1:まとめて読む)
+#define BNO055_CALIB_LOAD 1  // 起動時にEEPROMに保存したBNO055のキャリブレーション値を書き戻す
+#define MPU6050_I2C_ADDR 0x68 // MPU6050のI2Cアドレス
 // #define I2C1_SPEED 100000  // I2Cの速度(100kHz推奨?)
 // #define I2C1_MERIMOTE_ADDR 0x58 // MerimoteのI2Cアドレス
 
@@ -183,11 +216,15 @@
 #define PAD_INTERVAL 10        // JOYPADのデータを読みに行くフレーム間隔 (※KRC-5FHでは4推奨)
 #define PAD_BUTTON_MARGE 1     // 0:JOYPADのボタンデータをMeridim受信値に論理積, 1:Meridim受信値に論理和
 #define PAD_GENERALIZE 1       // ジョイパッドの入力値をPS系に一般化する
+#define PAD_EVENT_RING_LEN 32  // Bluetoothスレッドからloop()へのボタンのエッジのリングの長さ(2のべき乗)
 
 // ピンアサイン
 #define PIN_ERR_LED 13       // LED用 処理が時間内に収まっていない場合に点灯
 #define PIN_EN_L 33          // サーボL系統のENピン
 #define PIN_EN_R 4           // サーボR系統のENピン
+#define PIN_EN_C 1           // サーボC系統のENピン(C系統使用時. UART0の付け替えで空くTX0. GPIO12はストラッピングピンのため不可)
+#define PIN_TX_C 2           // サーボC系統のTXピン(C系統使用時. 空きピンに合わせて変更)
+#define PIN_RX_C 35          // サーボC系統のRXピン(C系統使用時. 空きピンに合わせて変更)
 #define PIN_CHIPSELECT_SD 15 // SDカード用のCSピン
 #define PIN_CHIPSELECT_LAN 5 // 有線LAN用のCSピン
 #define PIN_RESET_LAN 14     // W5500リセットピン(※ボード裏から半田付けにてフリーピンに配線)
@@ -201,23 +238,44 @@
 // サーボ設定
 //-------------------------------------------------------------------------
 
-// コマンドサーボの種類
-// 00: NOSERVO (マウントなし),            01: PWM_S1 (Single PWM)[WIP]
-// 11: PCA9685 (I2C_PCA9685toPWM)[WIP], 21: FTBRSX (FUTABA_RSxTTL)[WIP]
-// 31: DXL1 (DYNAMIXEL 1.0)[WIP],       32: DXL2 (DYNAMIXEL 2.0)[WIP]
-// 43: KOICS3 (KONDO_ICS 3.5 / 3.6),    44: KOPMX (KONDO_PMX)[WIP]
-// 51: JRXBUS (JRPROPO_XBUS)[WIP]
-// 61: FTCSTS (FEETECH_STS)[WIP],       62: FTCSCS (FEETECH_SCS)[WIP]
-#define MOUNT_SERVO_TYPE_L 43 // L系統のコマンドサーボの種類
-#define MOUNT_SERVO_TYPE_R 43 // R系統のコマンドサーボの種類
+// コマンドサーボの種類はスロットごとにIXL_MT, IXR_MTで指定する.
+// 1系統に複数の種類を混在させる場合は, 全サーボを同じ通信速度に揃えること.
 
 // サーボ関連設定
 // #define SERVO_BAUDRATE_L 1250000 // L系統のICSサーボの通信速度bps
-#define SERVO_BAUDRATE_L 115200  // L系統のICSサーボの通信速度bps
-#define SERVO_BAUDRATE_R 1250000 // R系統のICSサーボの通信速度bps
-#define SERVO_TIMEOUT_L 2        // L系統のICS返信待ちのタイムアウト時間
-#define SERVO_TIMEOUT_R 2        // R系統のICS返信待ちのタイムアウト時間
+#define SERVO_BAUDRATE_L 115200  // L系統のサーボの通信速度bps
+#define SERVO_BAUDRATE_R 1250000 // R系統のサーボの通信速度bps
+#define SERVO_TIMEOUT_L 2        // L系統のサーボ返信待ちのタイムアウト時間(ms)
+#define SERVO_TIMEOUT_R 2        // R系統のサーボ返信待ちのタイムアウト時間(ms)
+#define SERVO_BAUDRATE_C 1250000 // C系統のサーボの通信速度bps
+#define SERVO_TIMEOUT_C 2        // C系統のサーボ返信待ちのタイムアウト時間(ms)
+// gs2dで駆動するサーボ(IXL_MT, IXR_MTがKOICS3以外)の返信待ち. 同期読込みでは返信1件ごとに数え直す.
+// millis()で判定するため, 実際の待ち時間は指定値から指定値+1msになる.
+#define SERVO_GS2D_TIMEOUT_L 3   // L系統のgs2dサーボの返信1件あたりのタイムアウト時間(ms)
+#define SERVO_GS2D_TIMEOUT_R 3   // R系統のgs2dサーボの返信1件あたりのタイムアウト時間(ms)
+// C系統に使うUART. ESP32のUARTは3つのみのため, C系統はUART0(PCとのUSBシリアル)のピンを付け替えて使う.
+// C系統を使う場合, PCへのモニタ表示(serial_pc)は全て破棄される. C系統はICSサーボのみ対応.
+#define SERVO_SERIAL_C Serial
+#define MODE_SERVO_SIM 0         // ICSサーボを仮想バスで置き換える(0:OFF, 1:ON)
+#define SERVO_SIM_LATENCY_US 100 // 仮想サーボの返信遅延(us)
 #define SERVO_LOST_ERR_WAIT 6    // 連続何フレームサーボ信号をロストしたら異常とするか
+#define SERVO_DIRTY_SKIP 0        // 目標値の変化が不感帯以内のサーボへの送信を省略(0:OFF, 1:ON)
+#define SERVO_FEEDBACK_INTERVAL 5 // 送信を省略したサーボの現在位置を読み直す間隔(frame)
+#define SERVO_ESTIMATOR 0         // サーボの返信から位置と速度を推定しMeridimの拡張領域で送る(0:OFF, 1:ON)
+#define SERVO_EST_ALPHA 0.5f      // 推定の位置の補正係数(alpha-betaフィルタ, 0-1)
+#define SERVO_EST_BETA 0.1f       // 推定の速度の補正係数(alpha-betaフィルタ, 0-1)
+#define SERVO_EST_HOLD_MS 50      // 返信がない場合に速度で外挿する最長時間(ms). 以降は位置を保持する
+
+// サーボの健康状態モニタ(温度, 電流, ストレッチ, スピードを1フレームに1項目ずつ巡回して読む)
+#define SERVO_HEALTH 0                // 健康状態の巡回読み取り(0:OFF, 1:ON)
+#define SERVO_HEALTH_MARGIN_US 3000   // フレームの残り時間がこれ以上ある場合のみ読む(us)
+#define SERVO_HEALTH_TMP_LIMIT 40     // トルクを下げる温度値(ICSの温度値は127:低温 <=> 0:高温)
+#define SERVO_HEALTH_CUR_LIMIT 40     // トルクを下げる電流値(ICSの電流値 0-63)
+#define SERVO_HEALTH_HYSTERESIS 5     // トルクを戻す際のヒステリシス(温度値, 電流値)
+#define SERVO_HEALTH_STRC_REDUCED 20  // トルク低減時のストレッチ値(1-127)
+#define SERVO_DISCOVER 0              // ICSサーボの抜き差し検出(0:OFF, 1:ON). 通信不能の切り離しと再接続の探索
+#define SERVO_DISCOVER_MARGIN_US 3000 // フレームの残り時間がこれ以上ある場合のみ探索する(us)
+#define SERVO_DISCOVER_INTERVAL 10    // 切り離したサーボへの問い合わせ間隔(フレーム)
 
 // 各サーボ系統の最大サーボマウント数
 #define IXL_MAX 15 // L系統の最大サーボ数. 標準は15.
@@ -225,8 +283,8 @@
 
 // L系統のサーボのマウントの設定
 // 00: NOSERVO (マウントなし),            01: PWM_S1 (Single PWM)[WIP]
-// 11: PCA9685 (I2C_PCA9685toPWM)[WIP], 21: FTBRSX (FUTABA_RSxTTL)[WIP]
-// 31: DXL1 (DYNAMIXEL 1.0)[WIP],       32: DXL2 (DYNAMIXEL 2.0)[WIP]
+// 11: PCA9685 (I2C_PCA9685toPWM)[WIP], 21: FTBRSX (FUTABA_RSxTTL)
+// 31: DXL1 (DYNAMIXEL 1.0)[WIP],       32: DXL2 (DYNAMIXEL 2.0)
 // 43: KOICS3 (KONDO_ICS 3.5 / 3.6),    44: KOPMX (KONDO_PMX)[WIP]
 // 51: JRXBUS (JRPROPO_XBUS)[WIP]
 // 61: FTCSTS (FEETECH_STS)[WIP],       62: FTCSCS (FEETECH_SCS)[WIP]
@@ -251,8 +309,8 @@ int IXL_MT[IXL_MAX] = {
 
 // R系統のサーボのマウントの設定
 // 00: NOSERVO (マウントなし),            01: PWM_S1 (Single PWM)[WIP]
-// 11: PCA9685 (I2C_PCA9685toPWM)[WIP], 21: FTBRSX (FUTABA_RSxTTL)[WIP]
-// 31: DXL1 (DYNAMIXEL 1.0)[WIP],       32: DXL2 (DYNAMIXEL 2.0)[WIP]
+// 11: PCA9685 (I2C_PCA9685toPWM)[WIP], 21: FTBRSX (FUTABA_RSxTTL)
+// 31: DXL1 (DYNAMIXEL 1.0)[WIP],       32: DXL2 (DYNAMIXEL 2.0)
 // 43: KOICS3 (KONDO_ICS 3.5 / 3.6),    44: KOPMX (KONDO_PMX)[WIP]
 // 51: JRXBUS (JRPROPO_XBUS)[WIP]
 // 61: FTCSTS (FEETECH_STS)[WIP],       62: FTCSCS (FEETECH_SCS)[WIP]
@@ -390,6 +448,143 @@ float IXR_TRIM[IXR_MAX] = {
     0.0,    // [14]追加サーボ用
 };
 
+// L系統の不感帯(degree*100, SERVO_DIRTY_SKIPで使用)
+int IXL_DB[IXL_MAX] = {
+    5, // [00]頭ヨー
+    5, // [01]左肩ピッチ
+    5, // [02]左肩ロール
+    5, // [03]左肘ヨー
+    5, // [04]左肘ピッチ
+    5, // [05]左股ヨー
+    5, // [06]左股ロール
+    5, // [07]左股ピッチ
+    5, // [08]左膝ピッチ
+    5, // [09]左足首ピッチ
+    5, // [10]左足首ロール
+    5, // [11]追加サーボ用
+    5, // [12]追加サーボ用
+    5, // [13]追加サーボ用
+    5  // [14]追加サーボ用
+};
+
+// R系統の不感帯(degree*100, SERVO_DIRTY_SKIPで使用)
+int IXR_DB[IXR_MAX] = {
+    5, // [00]腰ヨー
+    5, // [01]右肩ピッチ
+    5, // [02]右肩ロール
+    5, // [03]右肘ヨー
+    5, // [04]右肘ピッチ
+    5, // [05]右股ヨー
+    5, // [06]右股ロール
+    5, // [07]右股ピッチ
+    5, // [08]右膝ピッチ
+    5, // [09]右足首ピッチ
+    5, // [10]右足首ロール
+    5, // [11]追加サーボ用
+    5, // [12]追加サーボ用
+    5, // [13]追加サーボ用
+    5  // [14]追加サーボ用
+};
+
+// C系統のサーボ設定(MOUNT_SERVO_LINE_Cが1の場合のみ使用. ICSサーボのみ対応)
+#define IXC_MAX 15 // C系統の最大サーボ数. 標準は15.
+
+// C系統のサーボのマウントの設定(00: NOSERVO, 43: KOICS3)
+int IXC_MT[IXC_MAX] = {
+    // C系統のマウント状態
+    0, // [00]C系統サーボ
+    0, // [01]C系統サーボ
+    0, // [02]C系統サーボ
+    0, // [03]C系統サーボ
+    0, // [04]C系統サーボ
+    0, // [05]C系統サーボ
+    0, // [06]C系統サーボ
+    0, // [07]C系統サーボ
+    0, // [08]C系統サーボ
+    0, // [09]C系統サーボ
+    0, // [10]C系統サーボ
+    0, // [11]C系統サーボ
+    0, // [12]C系統サーボ
+    0, // [13]C系統サーボ
+    0  // [14]C系統サーボ
+};
+
+// C系統のコード上のサーボIndexに対し, 実際に呼び出すハードウェアのID番号
+int IXC_ID[IXC_MAX] = {
+    0, // [00]C系統サーボ
+    1, // [01]C系統サーボ
+    2, // [02]C系統サーボ
+    3, // [03]C系統サーボ
+    4, // [04]C系統サーボ
+    5, // [05]C系統サーボ
+    6, // [06]C系統サーボ
+    7, // [07]C系統サーボ
+    8, // [08]C系統サーボ
+    9, // [09]C系統サーボ
+    10, // [10]C系統サーボ
+    11, // [11]C系統サーボ
+    12, // [12]C系統サーボ
+    13, // [13]C系統サーボ
+    14  // [14]C系統サーボ
+};
+
+// C系統のサーボ回転方向補正(1:変更なし, -1:逆転)
+int IXC_CW[IXC_MAX] = {
+    1, // [00]C系統サーボ
+    1, // [01]C系統サーボ
+    1, // [02]C系統サーボ
+    1, // [03]C系統サーボ
+    1, // [04]C系統サーボ
+    1, // [05]C系統サーボ
+    1, // [06]C系統サーボ
+    1, // [07]C系統サーボ
+    1, // [08]C系統サーボ
+    1, // [09]C系統サーボ
+    1, // [10]C系統サーボ
+    1, // [11]C系統サーボ
+    1, // [12]C系統サーボ
+    1, // [13]C系統サーボ
+    1  // [14]C系統サーボ
+};
+
+// C系統のトリム値(degree)
+float IXC_TRIM[IXC_MAX] = {
+    0, // [00]C系統サーボ
+    0, // [01]C系統サーボ
+    0, // [02]C系統サーボ
+    0, // [03]C系統サーボ
+    0, // [04]C系統サーボ
+    0, // [05]C系統サーボ
+    0, // [06]C系統サーボ
+    0, // [07]C系統サーボ
+    0, // [08]C系統サーボ
+    0, // [09]C系統サーボ
+    0, // [10]C系統サーボ
+    0, // [11]C系統サーボ
+    0, // [12]C系統サーボ
+    0, // [13]C系統サーボ
+    0  // [14]C系統サーボ
+};
+
+// C系統の不感帯(degree*100, SERVO_DIRTY_SKIPで使用)
+int IXC_DB[IXC_MAX] = {
+    5, // [00]C系統サーボ
+    5, // [01]C系統サーボ
+    5, // [02]C系統サーボ
+    5, // [03]C系統サーボ
+    5, // [04]C系統サーボ
+    5, // [05]C系統サーボ
+    5, // [06]C系統サーボ
+    5, // [07]C系統サーボ
+    5, // [08]C系統サーボ
+    5, // [09]C系統サーボ
+    5, // [10]C系統サーボ
+    5, // [11]C系統サーボ
+    5, // [12]C系統サーボ
+    5, // [13]C系統サーボ
+    5  // [14]C系統サーボ
+};
+
 //-------------------------------------------------------------------------
 //  固定値, マスターコマンド定義
 //-------------------------------------------------------------------------
@@ -398,7 +593,7 @@ float IXR_TRIM[IXR_MAX] = {
 #define MCMD_DUMMY_DATA -32768            // SPI送受信用のダミーデータ判定用
 #define MCMD_TEST_VALUE -32767            // テスト用の仮設変数
 #define MCMD_SENSOR_YAW_CALIB 10002       // センサの推定ヨー軸を現在値センターとしてリセット
-#define MCMD_SENSOR_ALL_CALIB 10003       // センサの3軸について現在値を原点としてリセット
+#define MCMD_SENSOR_ALL_CALIB 10003       // キャリブレーション完了済みのセンサの補正値をEEPROMに保存
 #define MCMD_ERR_CLEAR_SERVO_ID 10004     // 通信エラーのサーボのIDをクリア(MRD_ERR_l)
 #define MCMD_BOARD_TRANSMIT_ACTIVE 10005  // ボードが定刻で送信を行うモード(PC側が受信待ち)
 #define MCMD_BOARD_TRANSMIT_PASSIVE 10006 // ボードが受信を待ち返信するモード(PC側が定刻送信)
@@ -412,6 +607,8 @@ float IXR_TRIM[IXR_MAX] = {
 #define MCMD_SDCARD_EXIT_WRITE 10014      // SDCARD書き込みモードの終了
 #define MCMD_SDCARD_ENTER_READ 10015      // SDCARD読み出しモードのスタート
 #define MCMD_SDCARD_EXIT_READ 10016       // SDCARD読み出しモードの終了
+#define MCMD_SENSOR_FILTER 10017          // センサ値のフィルタをチャンネルごとに設定([MRD_FILTER_*]で指定)
+#define MCMD_PAD_LATCH_ACK 10018          // [MRD_PAD_LATCH]で指定したビットのボタン押下のラッチを解除
 #define MCMD_START_TRIM_SETTING 10100     // トリム設定モードに入る(Meridian_console.py連携)
 #define MCMD_EEPROM_SAVE_TRIM 10101       // 現在の姿勢をトリム値としてEEPROMに書き込む
 #define MCMD_EEPROM_LOAD_TRIM 10102       // EEPROMのトリム値をサーボに反映する
@@ -451,6 +648,10 @@ float IXR_TRIM[IXR_MAX] = {
 #define MRD_PAD_L2R2VAL 18   // リモコンのL2R2ボタンアナログ値
 #define MRD_MOTION_FRAMES 19 // モーション設定のフレーム数
 #define MRD_STOP_FRAMES 19   // ボード停止時のフレーム数(MCMD_BOARD_STOP_DURINGで指定)
+#define MRD_FILTER_CH 2      // 設定するチャンネルのビットマップ(MCMD_SENSOR_FILTERで指定. bit n:ahrs_sample.read[n])
+#define MRD_FILTER_MODE 3    // フィルタの種類 0:なし, 1:移動平均, 2:2次ローパス(MCMD_SENSOR_FILTERで指定)
+#define MRD_FILTER_PARAM 4   // 移動平均の窓の長さ, またはローパスのカットオフ周波数(0.1Hz単位)
+#define MRD_FILTER_MEDIAN 5  // 3点メディアンによるスパイク除去 0:なし, 1:あり
 #define C_HEAD_Y_CMD 20      // 頭ヨーのコマンド
 #define C_HEAD_Y_VAL 21      // 頭ヨーの値
 #define L_SHOULDER_P_CMD 22  // 左肩ピッチのコマンド
@@ -513,14 +714,14 @@ float IXR_TRIM[IXR_MAX] = {
 #define R_SERVO_IX14_CMD 78 // 追加テスト用のコマンド
 #define R_SERVO_IX14_VAL 79 // 追加テスト用の値
 
-#define MRD_USERDATA_80 80 // ユーザー定義用
-#define MRD_USERDATA_81 81 // ユーザー定義用
-#define MRD_USERDATA_82 82 // ユーザー定義用
-#define MRD_USERDATA_83 83 // ユーザー定義用
-#define MRD_USERDATA_84 84 // ユーザー定義用
-#define MRD_USERDATA_85 85 // ユーザー定義用
-#define MRD_USERDATA_86 86 // ユーザー定義用
-#define MRD_USERDATA_87 87 // ユーザー定義用
+#define MRD_SERVO_ERR_L 80 // L系統サーボの通信不能ビットマップ(bit n:インデックスn)
+#define MRD_SERVO_ERR_R 81 // R系統サーボの通信不能ビットマップ(bit n:インデックスn)
+#define MRD_TELEM_KEY 82   // 巡回テレメトリの項目番号(種類*1000 + 系統100/200 + インデックス)
+#define MRD_TELEM_VAL 83   // 巡回テレメトリの値
+#define MRD_IMU_AGE 84     // 送信するIMU/AHRS値の計測からの経過時間(0.1ms単位, 65535は計測値なし)
+#define MRD_IMU_BATCH 85   // 同じフレームで別送したIMU一括データグラムのサンプル数
+#define MRD_PAD_LATCH 86   // 押されたボタンのビット(MCMD_PAD_LATCH_ACKで解除されるまで保持)
+#define MRD_PAD_EVENTS 87  // ボタンの押下と解放のエッジの累計(65535の次は0)
 // #define MRD_ERR         88 // エラーコード (MRDM_LEN - 2)
 // #define MRD_CKSM        89 // チェックサム (MRDM_LEN - 1)
 
@@ -7,6 +7,7 @@
 #define WIFI_SEND_IP "192.168.3.3" // 送り先のPCのIPアドレス(PCのIPアドレスを調べておく)
 #define UDP_SEND_PORT 22222        // 送り先のポート番号
 #define UDP_RECV_PORT 22224        // このESP32のポート番号
+#define UDP_IMU_SEND_PORT 22226    // IMU一括データグラムの送り先のポート番号(config.hのIMU_BATCH_SENDが1の場合)
 
 // Wifi用のESP32固定IPアドレスの設定
 // ※config.hの MODE_FIXED_IP を1に設定することで有効
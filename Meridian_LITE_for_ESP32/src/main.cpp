@@ -34,6 +34,9 @@
 MERIDIANFLOW::Meridian mrd;
 IcsHardSerialClass ics_L(&Serial1, PIN_EN_L, SERVO_BAUDRATE_L, SERVO_TIMEOUT_L);
 IcsHardSerialClass ics_R(&Serial2, PIN_EN_R, SERVO_BAUDRATE_R, SERVO_TIMEOUT_R);
+#if MOUNT_SERVO_LINE_C
+IcsHardSerialClass ics_C(&SERVO_SERIAL_C, PIN_EN_C, SERVO_BAUDRATE_C, SERVO_TIMEOUT_C);
+#endif
 
 // ライブラリ導入
 #include <Arduino.h>
@@ -92,67 +95,95 @@ void setup()
   // サーボ値の初期設定
   sv.num_max = max(mrd_max_used_index(IXL_MT, IXL_MAX),  //
                    mrd_max_used_index(IXR_MT, IXR_MAX)); // サーボ処理回数
-  for (int i = 0; i <= sv.num_max; i++)
+  for (int i = 0; i < MRD_SERVO_SLOTS; i++)
   { // configで設定した値を反映させる
-    sv.ixl_mount[i] = IXL_MT[i];
-    sv.ixr_mount[i] = IXR_MT[i];
-    sv.ixl_type[i] = IXL_MT[i];
-    sv.ixr_type[i] = IXR_MT[i];
-    sv.ixl_id[i] = IXL_ID[i];
-    sv.ixr_id[i] = IXR_ID[i];
-    sv.ixl_cw[i] = IXL_CW[i];
-    sv.ixr_cw[i] = IXR_CW[i];
-    sv.ixl_trim[i] = IXL_TRIM[i];
-    sv.ixr_trim[i] = IXR_TRIM[i];
+    if (IXL_MT[i])
+      sv.mount[L] |= (1UL << i);
+    if (IXR_MT[i])
+      sv.mount[R] |= (1UL << i);
+    sv.type[L][i] = IXL_MT[i];
+    sv.type[R][i] = IXR_MT[i];
+    sv.id[L][i] = IXL_ID[i];
+    sv.id[R][i] = IXR_ID[i];
+    sv.cw[L][i] = IXL_CW[i];
+    sv.cw[R][i] = IXR_CW[i];
+    sv.trim[L][i] = IXL_TRIM[i];
+    sv.trim[R][i] = IXR_TRIM[i];
+    sv.deadband[L][i] = IXL_DB[i];
+    sv.deadband[R][i] = IXR_DB[i];
   };
+#if MOUNT_SERVO_LINE_C
+  sv.num_max = max(sv.num_max, mrd_max_used_index(IXC_MT, IXC_MAX));
+  for (int i = 0; i < MRD_SERVO_SLOTS; i++)
+  { // C系統はICSサーボのみ対応
+    if (IXC_MT[i] == KOICS3)
+      sv.mount[C] |= (1UL << i);
+    sv.type[C][i] = IXC_MT[i];
+    sv.id[C][i] = IXC_ID[i];
+    sv.cw[C][i] = IXC_CW[i];
+    sv.trim[C][i] = IXC_TRIM[i];
+    sv.deadband[C][i] = IXC_DB[i];
+  }
+#endif
+  mrd_servo_ics_affine_update(sv); // ICSサーボの角度変換係数を作成
+  mrd_mv_profile_load(sv, nullptr);  // 動作プロファイルの上限値をconfig.hの既定値に設定
 
   // サーボUARTの通信速度の表示
   mrd_disp.servo_bps_2lines(SERVO_BAUDRATE_L, SERVO_BAUDRATE_R);
 
   // サーボ用UART設定
-  mrd_servo_begin(L, MOUNT_SERVO_TYPE_L);         // サーボモータの通信初期設定. Serial2
-  mrd_servo_begin(R, MOUNT_SERVO_TYPE_R);         // サーボモータの通信初期設定. Serial3
-  mrd_disp.servo_protocol(L, MOUNT_SERVO_TYPE_R); // サーボプロトコルの表示
-  mrd_disp.servo_protocol(R, MOUNT_SERVO_TYPE_R);
+  mrd_servo_group_build(sv); // マウント済みのサーボを系統と種類ごとにまとめる
+  for (int g = 0; g < sv_groups.num; g++)
+  {
+    mrd_servo_group_select(sv_groups.grp[g].line, sv_groups.grp[g].type); // サーボモータの通信初期設定
+    mrd_disp.servo_protocol(sv_groups.grp[g].line, sv_groups.grp[g].type);  // サーボプロトコルの表示
+  }
+  if (MODE_SERVO_SIM)
+  { // 実機のサーボの代わりに仮想バスを使う
+    mrd_ics_sim_begin(sv);
+    serial_pc.println("Servo bus is simulated.");
+  }
 
   // マウントされたサーボIDの表示
   mrd_disp.servo_mounts_2lines(sv);
 
   // EEPROMの開始
-  Serial.print("Initializing EEPROM... ");
+  serial_pc.print("Initializing EEPROM... ");
   if (mrd_eeprom_init(EEPROM_SIZE))
   { // EEPROMの初期化
-    Serial.println("OK");
+    serial_pc.println("OK");
   }
   else
   {
-    Serial.println("Failed");
+    serial_pc.println("Failed");
   }
 
   // EEPROMにconfigのサーボ設定値を書き込む場合
   if (EEPROM_SET)
   {
-    Serial.println("Set EEPROM data from config.");
+    serial_pc.println("Set EEPROM data from config.");
     // 書き込みデータの作成と書き込み
     if (
-        mrd_eeprom_write(mrd_eeprom_make_data_from_config(sv), EEPROM_PROTECT, Serial))
+        mrd_eeprom_write(mrd_eeprom_make_data_from_config(sv), EEPROM_PROTECT, serial_pc))
     {
-      Serial.println("Write EEPROM succeed.");
+      serial_pc.println("Write EEPROM succeed.");
     }
     else
     {
-      Serial.println("Write EEPROM failed.");
+      serial_pc.println("Write EEPROM failed.");
     };
   }
 
   // EEPROMからサーボ設定の内容を読み込んで反映する場合
   if (EEPROM_LOAD)
   {
-    mrd_eeprom_load_servosettings(sv, true, Serial);
+    mrd_eeprom_load_servosettings(sv, true, serial_pc);
+    mrd_servo_ics_affine_update(sv); // トリム値の変更を角度変換係数に反映
+    mrd_mv_profile_load(sv, mrd_eeprom_read().saval[EEPROM_PROFILE_PAGE]); // 動作プロファイルの上限値を読み込む
   }
 
   // EEPROMの内容ダンプ表示をする場合
-  mrd_eeprom_dump_at_boot(EEPROM_DUMP, EEPROM_STYLE, Serial); //
+  mrd_eeprom_dump_at_boot(EEPROM_DUMP, EEPROM_STYLE, serial_pc); //
 
   // EEPROMのリードライトテスト
   // mrd_eeprom_write_read_check(mrd_eeprom_make_data_from_config(),
@@ -163,13 +194,25 @@ void setup()
   mrd_sd_check(MOUNT_SD, PIN_CHIPSELECT_SD, CHECK_SD_RW);
 
   // I2Cの初期化と開始
-  mrd_wire0_setup(BNO055_AHRS, I2C0_SPEED, ahrs, PIN_I2C0_SDA, PIN_I2C0_SCL);
+  mrd_wire0_setup(MOUNT_IMUAHRS, I2C0_SPEED, ahrs, PIN_I2C0_SDA, PIN_I2C0_SCL);
+  if (I2C_BUS_MANAGER && MOUNT_IMUAHRS != NO_IMU)
+  {
+    mrd_i2c_bus_begin(); // 以降のI2C通信は管理スレッド経由
+  }
 
   // I2Cスレッドの開始
   if (MOUNT_IMUAHRS == BNO055_AHRS)
   {
     xTaskCreatePinnedToCore(mrd_wire0_Core0_bno055_r, "Core0_bno055_r", 4096, NULL, 2, &thp[0], 0);
-    Serial.println("Core0 thread for BNO055 start.");
+    mrd_wire0_timer_begin(IMUAHRS_INTERVAL * 1000); // 読み取り周期のタイマー通知を開始
+    serial_pc.println("Core0 thread for BNO055 start.");
+    delay(10);
+  }
+  else if (MOUNT_IMUAHRS == MPU6050_IMU && MPU6050_RAW_FUSION)
+  {
+    xTaskCreatePinnedToCore(mrd_wire0_Core0_mpu6050_r, "Core0_mpu6050_r", 4096, NULL, 2, &thp[0], 0);
+    mrd_wire0_timer_begin(MPU6050_RAW_PERIOD); // 読み取り周期のタイマー通知を開始
+    serial_pc.println("Core0 thread for MPU6050 start.");
     delay(10);
   }
 
@@ -179,20 +222,20 @@ void setup()
     mrd_disp.esp_wifi(WIFI_AP_SSID);
     if (MODE_FIXED_IP)
     { // 固定IPを使用する場合はwifi.configの設定を使用する
-      IPAddress fixed_ip = mrd_parse_ip_address(FIXED_IP_ADDR, Serial);
-      IPAddress fixed_gw = mrd_parse_ip_address(FIXED_IP_GATEWAY, Serial);
-      IPAddress fixed_sb = mrd_parse_ip_address(FIXED_IP_SUBNET, Serial);
-      if (mrd_validate_network_config(fixed_ip, fixed_gw, fixed_sb, Serial))
+      IPAddress fixed_ip = mrd_parse_ip_address(FIXED_IP_ADDR, serial_pc);
+      IPAddress fixed_gw = mrd_parse_ip_address(FIXED_IP_GATEWAY, serial_pc);
+      IPAddress fixed_sb = mrd_parse_ip_address(FIXED_IP_SUBNET, serial_pc);
+      if (mrd_validate_network_config(fixed_ip, fixed_gw, fixed_sb, serial_pc))
       {                                            // IPチェック
         WiFi.config(fixed_ip, fixed_gw, fixed_sb); // 固定IPを設定
-        Serial.println("FIXEDIP****");
+        serial_pc.println("FIXEDIP****");
       }
       else
       { // IPのパースが失敗なら停止
-        mrd_error_stop(PIN_ERR_LED, "Please Check '#define FIXED_IP_ADDR, FIXED_IP_GATEWAY, FIXED_IP_SUBNET' in 'keys.h'", Serial);
+        mrd_error_stop(PIN_ERR_LED, "Please Check '#define FIXED_IP_ADDR, FIXED_IP_GATEWAY, FIXED_IP_SUBNET' in 'keys.h'", serial_pc);
       }
     }
-    if (mrd_wifi_init(udp, WIFI_AP_SSID, WIFI_AP_PASS, Serial))
+    if (mrd_wifi_init(udp, WIFI_AP_SSID, WIFI_AP_PASS, serial_pc))
     {                                                              // wifiの初期化
       mrd_disp.esp_ip(MODE_FIXED_IP, WIFI_SEND_IP, FIXED_IP_ADDR); // wifiIPの表示
     }
@@ -204,27 +247,27 @@ void setup()
     if (parseMacAddress(ETHER_MAC, ether_mac))
     {
 
-      if (mrd_ether_init(udp_et, PIN_CHIPSELECT_LAN, ether_mac, Serial))
+      if (mrd_ether_init(udp_et, PIN_CHIPSELECT_LAN, ether_mac, serial_pc))
       {
         // Ethernet送信先IPの事前パース
-        ether_send_ip = mrd_parse_ip_address(ETHER_GATEWAY, Serial);
+        ether_send_ip = mrd_parse_ip_address(ETHER_GATEWAY, serial_pc);
 
         if (ether_send_ip == IPAddress(0, 0, 0, 0))
         {
           // エラー状態でシステム停止（LEDで視覚的に通知）
-          mrd_error_stop(PIN_ERR_LED, "ERROR: Ethernet initialization failed. Fix WIFI_SEND_IP and restart", Serial);
+          mrd_error_stop(PIN_ERR_LED, "ERROR: Ethernet initialization failed. Fix WIFI_SEND_IP and restart", serial_pc);
         }
       }
       else
       {
-        mrd_error_stop(PIN_ERR_LED, "ERROR: Ethernet initialization failed. Check Ethernet hardware/config.", Serial);
+        mrd_error_stop(PIN_ERR_LED, "ERROR: Ethernet initialization failed. Check Ethernet hardware/config.", serial_pc);
       }
     }
     else
     {
-      Serial.print("ERROR: Failed to parse MAC address ");
-      Serial.println(ETHER_MAC);
-      mrd_error_stop(PIN_ERR_LED, "Please check '#define ETHER_MAC' in 'keys.h'", Serial);
+      serial_pc.print("ERROR: Failed to parse MAC address ");
+      serial_pc.println(ETHER_MAC);
+      mrd_error_stop(PIN_ERR_LED, "Please check '#define ETHER_MAC' in 'keys.h'", serial_pc);
     }
   }
 
@@ -234,10 +277,18 @@ void setup()
   // Bluetoothの開始と表示(WIIMOTE)
   if (MOUNT_PAD == WIIMOTE)
   { // Bluetooth用スレッドの開始
-    mrd_bt_settings(MOUNT_PAD, PAD_INIT_TIMEOUT, wiimote, PIN_LED_BT, Serial);
+    mrd_bt_settings(MOUNT_PAD, PAD_INIT_TIMEOUT, wiimote, PIN_LED_BT, serial_pc);
     xTaskCreatePinnedToCore(Core0_BT_r, "Core0_BT_r", 2048, NULL, 5, &thp[2], 0);
   }
 
+#if MOUNT_SERVO_LINE_C
+  // C系統のサーボ用スレッドの開始
+  if (mrd_servo_line_c_task_begin())
+  {
+    serial_pc.println("Core0 thread for servo line C start.");
+  }
+#endif
+
   // UDP開始用ダミーデータの生成
   s_udp_meridim.sval[MRD_MASTER] = 90;
   s_udp_meridim.sval[MRD_CKSM] = mrd.cksm_val(s_udp_meridim.sval, MRDM_LEN);
@@ -286,6 +337,17 @@ void loop()
       // 事前にパース済みのIPアドレスを使用
       mrd_ether_udp_send(s_udp_meridim.bval, MRDM_BYTE, udp_et, ether_send_ip, UDP_SEND_PORT);
     }
+    if (IMU_BATCH_SEND && imu_batch.count > 0)
+    { // 前フレーム以降の全IMUサンプルを別のデータグラムで送信
+      if (!MODE_ETHER)
+      {
+        mrd_wifi_udp_send((byte *)&imu_batch, mrd_imu_batch_len(imu_batch), udp, UDP_IMU_SEND_PORT);
+      }
+      else
+      {
+        mrd_ether_udp_send((byte *)&imu_batch, mrd_imu_batch_len(imu_batch), udp_et, ether_send_ip, UDP_IMU_SEND_PORT);
+      }
+    }
     flg.udp_busy = false; // UDP使用中フラグをサゲる
     flg.udp_rcvd = false; // UDP受信完了フラグをサゲる
   }
@@ -318,13 +380,18 @@ void loop()
           flg.udp_rcvd = true; // UDP受信完了フラグをアゲる
         }
       }
+      // キーフレームモードではキーフレームの間のフレームに受信がないのが通常のため, 1回だけ確認して待たない
+      if (MODE_KEYFRAME)
+      {
+        break;
+      }
       // タイムアウト抜け処理
       unsigned long current_tmp = millis();
       if (current_tmp - start_tmp >= UDP_TIMEOUT)
       {
         if (millis() > MONITOR_SUPPRESS_DURATION)
         { // 起動直後はエラー表示を抑制
-          Serial.println("UDP timeout");
+          serial_pc.println("UDP timeout");
         }
         flg.udp_rcvd = false;
         break;
@@ -334,53 +401,61 @@ void loop()
   }
   flg.udp_busy = false; // UDP使用中フラグをサゲる
 
-  // @[2-2] チェックサムを確認
-  if (mrd.cksm_rslt(r_udp_meridim.sval, MRDM_LEN)) // Check sum OK!
+  // キーフレームモードで今回のフレームに受信がなければ, 前回のデータを使い続けエラーとしない
+  if (MODE_KEYFRAME && !flg.udp_rcvd)
+  {
+    flg.meridim_rcvd = false; // Meridim受信成功フラグをサゲる.
+  }
+  else
   {
-    mrd.monitor_check_flow("CsOK", monitor.flow); // デバグ用フロー表示
+    // @[2-2] チェックサムを確認
+    if (mrd.cksm_rslt(r_udp_meridim.sval, MRDM_LEN)) // Check sum OK!
+    {
+      mrd.monitor_check_flow("CsOK", monitor.flow); // デバグ用フロー表示
 
-    // @[2-3] UDP受信配列から UDP送信配列にデータを転写
-    memcpy(s_udp_meridim.bval, r_udp_meridim.bval, MRDM_LEN * 2);
+      // @[2-3] UDP受信配列から UDP送信配列にデータを転写
+      memcpy(s_udp_meridim.bval, r_udp_meridim.bval, MRDM_LEN * 2);
 
-    // @[2-4a] エラービット14番(ESP32のPCからのUDP受信エラー検出)をサゲる
-    mrd_clear_bit16(s_udp_meridim.usval[MRD_ERR], ERRBIT_14_PC_ESP);
+      // @[2-4a] エラービット14番(ESP32のPCからのUDP受信エラー検出)をサゲる
+      mrd_clear_bit16(s_udp_meridim.usval[MRD_ERR], ERRBIT_14_PC_ESP);
 
-    if (s_udp_meridim.sval[0] == MCMD_EEPROM_SAVE_TRIM)
-    {
-      Serial.println(r_udp_meridim.sval[0]);
+      if (s_udp_meridim.sval[0] == MCMD_EEPROM_SAVE_TRIM)
+      {
+        serial_pc.println(r_udp_meridim.sval[0]);
+      }
     }
-  }
-  else // チェックサムがNGならバッファから転記せず前回のデータを使用する
-  {
+    else // チェックサムがNGならバッファから転記せず前回のデータを使用する
+    {
 
-    // @[2-4b] エラービット14番(ESP32のPCからのUDP受信エラー検出)をアゲる
-    mrd_set_bit16(s_udp_meridim.usval[MRD_ERR], ERRBIT_14_PC_ESP);
-    err.pc_esp++;
-    mrd.monitor_check_flow("CsErr*", monitor.flow); // デバグ用フロー表示
-  }
+      // @[2-4b] エラービット14番(ESP32のPCからのUDP受信エラー検出)をアゲる
+      mrd_set_bit16(s_udp_meridim.usval[MRD_ERR], ERRBIT_14_PC_ESP);
+      err.pc_esp++;
+      mrd.monitor_check_flow("CsErr*", monitor.flow); // デバグ用フロー表示
+    }
 
-  // @[2-5] シーケンス番号チェック
-  mrdsq.r_expect = mrd_seq_predict_num(mrdsq.r_expect); // シーケンス番号予想値の生成
+    // @[2-5] シーケンス番号チェック
+    mrdsq.r_expect = mrd_seq_predict_num(mrdsq.r_expect); // シーケンス番号予想値の生成
 
-  // @[2-6] シーケンス番号のシリアルモニタ表示
-  mrd_disp.seq_number(mrdsq.r_expect, r_udp_meridim.usval[MRD_SEQ], monitor.seq_num);
+    // @[2-6] シーケンス番号のシリアルモニタ表示
+    mrd_disp.seq_number(mrdsq.r_expect, r_udp_meridim.usval[MRD_SEQ], monitor.seq_num);
 
-  if (mrd.seq_compare_nums(mrdsq.r_expect, int(s_udp_meridim.usval[MRD_SEQ])))
-  {
+    if (mrd.seq_compare_nums(mrdsq.r_expect, int(s_udp_meridim.usval[MRD_SEQ])))
+    {
 
-    // エラービット10番[ESP受信のスキップ検出]をサゲる
-    mrd_clear_bit16(s_udp_meridim.usval[MRD_ERR], ERRBIT_10_UDP_ESP_SKIP);
-    flg.meridim_rcvd = true; // Meridim受信成功フラグをアゲる.
-  }
-  else
-  {                                                     // 受信シーケンス番号の値が予想と違ったら
-    mrdsq.r_expect = int(s_udp_meridim.usval[MRD_SEQ]); // 現在の受信値を予想結果としてキープ
+      // エラービット10番[ESP受信のスキップ検出]をサゲる
+      mrd_clear_bit16(s_udp_meridim.usval[MRD_ERR], ERRBIT_10_UDP_ESP_SKIP);
+      flg.meridim_rcvd = true; // Meridim受信成功フラグをアゲる.
+    }
+    else
+    {                                                     // 受信シーケンス番号の値が予想と違ったら
+      mrdsq.r_expect = int(s_udp_meridim.usval[MRD_SEQ]); // 現在の受信値を予想結果としてキープ
 
-    // エラービット10番[ESP受信のスキップ検出]をアゲる
-    mrd_set_bit16(s_udp_meridim.usval[MRD_ERR], ERRBIT_10_UDP_ESP_SKIP);
+      // エラービット10番[ESP受信のスキップ検出]をアゲる
+      mrd_set_bit16(s_udp_meridim.usval[MRD_ERR], ERRBIT_10_UDP_ESP_SKIP);
 
-    err.esp_skip++;
-    flg.meridim_rcvd = false; // Meridim受信成功フラグをサゲる.
+      err.esp_skip++;
+      flg.meridim_rcvd = false; // Meridim受信成功フラグをサゲる.
+    }
   }
 
   //------------------------------------------------------------------------------------
@@ -393,20 +468,20 @@ void loop()
   // if (s_udp_meridim.sval[MRD_MASTER] == MCMD_ALL_SERVOS_CENTER)
   // {
   //   flg.vrshateki_trigger = true;
-  //   Serial.println("HIT");
+  //   serial_pc.println("HIT");
   //   delay(500);
   // }
 
   // if (flg.vrshateki_trigger)
   // {
   //   flg.vrshateki_centering_count -= 1;
-  //   Serial.println(flg.vrshateki_centering_count);
+  //   serial_pc.println(flg.vrshateki_centering_count);
   //   if (flg.vrshateki_centering_count < 0)
   //   {
   //     s_udp_meridim.sval[MRD_MASTER] = 90;                       // マスターコマンドを90に
   //     flg.vrshateki_centering_count = VRSHATEKI_CENTERING_TIMER; // カウンタを復活
   //     flg.vrshateki_trigger = false;                             // センタリングモードの終了
-  //     Serial.println("Centering Ended.");
+  //     serial_pc.println("Centering Ended.");
   //   }
   //   else
   //   {
@@ -416,7 +491,7 @@ void loop()
   // }
 
   // @[3-1] MasterCommand group1 の処理
-  execute_master_command_1(s_udp_meridim, flg.meridim_rcvd, sv, Serial);
+  execute_master_command_1(s_udp_meridim, flg.meridim_rcvd, sv, serial_pc);
 
   //------------------------------------------------------------------------------------
   //  [ 4 ] センサー類読み取り
@@ -424,7 +499,9 @@ void loop()
   mrd.monitor_check_flow("[4]", monitor.flow); // デバグ用フロー表示
 
   // @[4-1] センサ値のMeridimへの転記
-  meriput90_ahrs(s_udp_meridim, ahrs.read, MOUNT_IMUAHRS); // BNO055_AHRS
+  ahrs_sample.update();                                                   // センサ読込スレッドが公開した最新の一式に切り替え
+  mrd_wire0_bno055_calib_poll(serial_pc);                                 // キャリブレーション値の保存依頼が読込済みならEEPROMに書き込む
+  meriput90_ahrs(s_udp_meridim, ahrs_sample.front().read, MOUNT_IMUAHRS); // BNO055_AHRS
 
   //------------------------------------------------------------------------------------
   //  [ 5 ] リモコンの読み取り
@@ -440,6 +517,7 @@ void loop()
 
     // リモコンの値をmeridimに格納する
     meriput90_pad(s_udp_meridim, pad_array, PAD_BUTTON_MARGE);
+    meriput90_pad_edge(s_udp_meridim, pad_edge); // フレーム間の押下のラッチとエッジの累計
   }
 
   //------------------------------------------------------------------------------------
@@ -448,7 +526,7 @@ void loop()
   mrd.monitor_check_flow("[6]", monitor.flow); // デバグ用フロー表示
 
   // @[6-1] MasterCommand group2 の処理
-  execute_master_command_2(s_udp_meridim, flg.meridim_rcvd, sv, Serial);
+  execute_master_command_2(s_udp_meridim, flg.meridim_rcvd, sv, serial_pc);
 
   //------------------------------------------------------------------------------------
   //  [ 7 ] ESP32内部で位置制御する場合の処理
@@ -456,30 +534,33 @@ void loop()
   mrd.monitor_check_flow("[7]", monitor.flow); // デバグ用フロー表示
 
   // @[7-1] 前回のラストに読み込んだサーボ位置をサーボ配列に書き込む
-  for (int i = 0; i <= sv.num_max; i++)
+  memcpy(sv.tgt_past, sv.tgt, sizeof(sv.tgt)); // 前回のdegree*100をキープ
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
   {
-    sv.ixl_tgt_past[i] = sv.ixl_tgt[i];                    // 前回のdegreeをキープ
-    sv.ixr_tgt_past[i] = sv.ixr_tgt[i];                    // 前回のdegreeをキープ
-    sv.ixl_tgt[i] = s_udp_meridim.sval[i * 2 + 21] * 0.01; // 受信したdegreeを格納
-    sv.ixr_tgt[i] = s_udp_meridim.sval[i * 2 + 51] * 0.01; // 受信したdegreeを格納
+    for (int i = 0; i < sv.num_max; i++)
+    {
+      sv.tgt[line][i] = s_udp_meridim.sval[MRD_SV_ORIGIDX[line] + 1 + i * 2]; // 受信したdegree*100を格納
+    }
   }
 
-  // 移動差が大きい時に和らげる補正フィルタ
-  for (int i = 0; i <= sv.num_max; i++)
+  // キーフレームモードでは受信した目標値をフレーム数で補間する
+  if (MODE_KEYFRAME)
   {
-    sv.ixl_tgt[i] = mrd_servo_move_limit(sv.ixl_tgt_past[i], sv.ixl_tgt[i], SERVO_MOVE_LIMIT);
-    sv.ixr_tgt[i] = mrd_servo_move_limit(sv.ixr_tgt_past[i], sv.ixr_tgt[i], SERVO_MOVE_LIMIT);
+    mrd_mv_keyframe_update(s_udp_meridim, flg.meridim_rcvd, sv);
   }
 
+  // 関節ごとの速度・加速度・躍度の上限で目標値を制限する
+  mrd_mv_profile_update(s_udp_meridim, sv);
+
   // @[7-2] ESP32による次回動作の計算
   // 以下はリモコンの左十字キー左右でL系統0番サーボ(首部)を30度左右にふるサンプル
   if (s_udp_meridim.sval[MRD_PAD_BUTTONS] == PAD_RIGHT)
   {
-    sv.ixl_tgt[0] = -30.00; // -30度
+    sv.tgt[L][0] = -3000; // -30度
   }
   else if (s_udp_meridim.sval[MRD_PAD_BUTTONS] == PAD_LEFT)
   {
-    sv.ixl_tgt[0] = 30.00; // +30度
+    sv.tgt[L][0] = 3000; // +30度
   }
 
   // @[7-3] 各種処理
@@ -487,15 +568,17 @@ void loop()
   // サーボ物理トルクオフスイッチの処理★
   if (digitalRead(PIN_SERVO_ONOFF)) // サーボオフ
   {
-    for (int i = 0; i <= sv.num_max; i++)
+    for (int line = 0; line < MRD_SERVO_LINES; line++)
     {
-      s_udp_meridim.sval[i * 2 + 20] = 0; // サーボトルク0
-      s_udp_meridim.sval[i * 2 + 50] = 0; // サーボトルク0
+      for (int i = 0; i < sv.num_max; i++)
+      {
+        s_udp_meridim.sval[MRD_SV_ORIGIDX[line] + i * 2] = 0; // サーボトルク0
+      }
     }
     // s_udp_meridim.sval[MRD_MASTER] = 0; // マスターコマンドを90に
     if (flg.torq_switch_disp)
     {
-      Serial.println("TORQ OFF");
+      serial_pc.println("TORQ OFF");
       flg.torq_switch_disp = false;
     }
     analogWrite(PIN_LED_VCC, 0);
@@ -504,15 +587,15 @@ void loop()
   {
     if (!flg.torq_switch_disp)
     {
-      Serial.println("TORQ ON");
+      serial_pc.println("TORQ ON");
       flg.torq_switch_disp = true;
     }
-    // Serial.println("TORQ ON");
+    // serial_pc.println("TORQ ON");
     analogWrite(PIN_LED_VCC, 170);
     // s_udp_meridim.sval[MRD_MASTER] = 90; // マスターコマンドを90に
   }
 
-  // Serial.println(r_udp_meridim.sval[21]);
+  // serial_pc.println(r_udp_meridim.sval[21]);
 
   //------------------------------------------------------------------------------------
   //  [ 8 ] サーボ動作の実行
@@ -521,13 +604,34 @@ void loop()
 
   // @[8-1] サーボ受信値の処理
   if (!MODE_ESP32_STANDALONE)
-  {                                                                                  // サーボ処理を行うかどうか
-    mrd_servo_drive_lite(s_udp_meridim, MOUNT_SERVO_TYPE_L, MOUNT_SERVO_TYPE_R, sv); // サーボ動作を実行する
+  {                                          // サーボ処理を行うかどうか
+    mrd_servo_drive_lite(s_udp_meridim, sv); // サーボ動作を実行する
   }
   else
   {
     // ボード単体動作モードの場合はサーボ処理をせずL0番サーボ値として+-30度のサインカーブ値を返す
-    sv.ixl_tgt[0] = sin(tmr.count_loop * M_PI / 180.0) * 30;
+    sv.tgt[L][0] = mrd.float2HfShort(sin(tmr.count_loop * M_PI / 180.0) * 30);
+  }
+
+  // @[8-2] フレームの残り時間でサーボの健康状態を1項目読む
+  if (SERVO_HEALTH && !MODE_ESP32_STANDALONE)
+  {
+    mrd_sv_health_read(sv, tmr.frame_start_us);
+  }
+
+  // @[8-3] 通信不能のサーボを切り離し, フレームの残り時間で切り離したサーボに問い合わせる
+  if (SERVO_DISCOVER && !MODE_ESP32_STANDALONE)
+  {
+    if (mrd_sv_discover_step(sv, tmr.frame_start_us))
+    {
+      mrd_servo_group_build(sv); // マウントの変化をグループに反映する
+    }
+  }
+
+  // @[8-4] 今回の返信をサーボの位置と速度の推定に取り込む
+  if (SERVO_ESTIMATOR && !MODE_ESP32_STANDALONE)
+  {
+    mrd_sv_est_update(sv);
   }
 
   //------------------------------------------------------------------------------------
@@ -536,11 +640,17 @@ void loop()
   mrd.monitor_check_flow("[9]", monitor.flow); // デバグ用フロー表示
 
   // @[9-1] サーボIDごとにの現在位置もしくは計算結果を配列に格納
-  for (int i = 0; i <= sv.num_max; i++)
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
   {
-    // 最新のサーボ角度をdegreeで格納
-    s_udp_meridim.sval[i * 2 + 21] = mrd.float2HfShort(sv.ixl_tgt[i]);
-    s_udp_meridim.sval[i * 2 + 51] = mrd.float2HfShort(sv.ixr_tgt[i]);
+    for (int i = 0; i < sv.num_max; i++)
+    {
+      // 最新のサーボ角度をdegree*100で格納
+      s_udp_meridim.sval[MRD_SV_ORIGIDX[line] + 1 + i * 2] = sv.tgt[line][i];
+    }
+  }
+  if (SERVO_ESTIMATOR)
+  { // 推定位置と推定速度を拡張領域に格納
+    mrd_sv_est_put(s_udp_meridim, sv);
   }
 
   // サーボ物理スイッチのスイッチモニタリング用★
@@ -567,7 +677,7 @@ void loop()
   //------------------------------------------------------------------------------------
   mrd.monitor_check_flow("[11]", monitor.flow); // デバグ用フロー表示
 
-  execute_master_command_3(s_udp_meridim, flg.meridim_rcvd, sv, Serial);
+  execute_master_command_3(s_udp_meridim, flg.meridim_rcvd, sv, serial_pc);
 
   //------------------------------------------------------------------------------------
   //  [ 12 ] UDP送信信号作成
@@ -578,8 +688,19 @@ void loop()
   mrdsq.s_increment = mrd.seq_increase_num(mrdsq.s_increment);
   s_udp_meridim.usval[1] = mrdsq.s_increment;
 
-  // @[12-2] エラーが出たサーボのインデックス番号を格納
+  // @[12-2] エラーが出たサーボのインデックス番号とビットマップを格納
   s_udp_meridim.ubval[MRD_ERR_l] = mrd_servo_make_errcode_lite(sv);
+  mrd_servo_put_errbits(s_udp_meridim, sv);
+  const bool discover_put = SERVO_DISCOVER && mrd_sv_discover_put(s_udp_meridim); // マウントの変化を優先して送る
+  if (SERVO_HEALTH && !discover_put)
+  {
+    mrd_sv_health_put(s_udp_meridim, sv); // サーボの健康状態を巡回テレメトリ欄に格納
+  }
+  meriput90_ahrs_age(s_udp_meridim, ahrs_sample.front(), MOUNT_IMUAHRS); // 送信するセンサ値の経過時間
+  if (IMU_BATCH_SEND)
+  {
+    mrd_imu_batch_build(s_udp_meridim, imu_batch); // 次のフレームの冒頭で別送するIMUサンプル
+  }
 
   // @[12-3] チェックサムを計算して格納
   mrd_meriput90_cksm(s_udp_meridim);
@@ -604,6 +725,7 @@ void loop()
       }
     }
   }
+  tmr.frame_start_us = micros(); // 次のフレームの開始時刻
 
   // @[13-2] 必要に応じてフレームの遅延累積時間frameDelayをリセット
   if (flg.count_frame_reset)
@@ -3,6 +3,8 @@
 
 // ヘッダファイルの読み込み
 #include "config.h"
+#include "mrd_sync.h"
+#include "mrd_servo_param.h"
 
 // ライブラリ導入
 #include <Adafruit_BNO055.h>            // 9軸センサBNO055用
@@ -12,33 +14,14 @@ extern MERIDIANFLOW::Meridian mrd;
 #include <IcsHardSerialClass.h> // ICSサーボのインスタンス設定
 extern IcsHardSerialClass ics_L;
 extern IcsHardSerialClass ics_R;
+#if MOUNT_SERVO_LINE_C
+extern IcsHardSerialClass ics_C;
+#endif
 
 //------------------------------------------------------------------------------------
 //  列挙型
 //------------------------------------------------------------------------------------
 
-enum UartLine
-{    // サーボ系統の列挙型(L,R,C)
-  L, // Left
-  R, // Right
-  C  // Center
-};
-
-enum ServoType
-{               // サーボプロトコルのタイプ
-  NOSERVO = 0,  // サーボなし
-  PWM_S = 1,    // Single PWM (WIP)
-  PCA9685 = 11, // I2C_PCA9685 to PWM (WIP)
-  FTBRSX = 21,  // FUTABA_RSxTTL (WIP)
-  DXL1 = 31,    // DYNAMIXEL 1.0 (WIP)
-  DXL2 = 32,    // DYNAMIXEL 2.0 (WIP)
-  KOICS3 = 43,  // KONDO_ICS 3.5 / 3.6
-  KOPMX = 44,   // KONDO_PMX (WIP)
-  JRXBUS = 51,  // JRPROPO_XBUS (WIP)
-  FTCSTS = 61,  // FEETECH_STS (WIP)
-  FTCSCS = 62   // FEETECH_SCS (WIP)
-};
-
 enum ImuAhrsType
 {                  // 6軸9軸センサ種の列挙型(NO_IMU, MPU6050_IMU, MPU9250_IMU, BNO055_AHRS)
   NO_IMU = 0,      // IMU/AHRS なし.
@@ -92,11 +75,12 @@ enum BinHexDec
 //------------------------------------------------------------------------------------
 
 // システム用の変数
-const int MRDM_BYTE = MRDM_LEN * 2;    // Meridim配列のバイト型の長さ
 const int MRD_ERR = MRDM_LEN - 2;      // エラーフラグの格納場所(配列の末尾から2つめ)
 const int MRD_ERR_u = MRD_ERR * 2 + 1; // エラーフラグの格納場所(上位8ビット)
 const int MRD_ERR_l = MRD_ERR * 2;     // エラーフラグの格納場所(下位8ビット)
 const int MRD_CKSM = MRDM_LEN - 1;     // チェックサムの格納場所(配列の末尾)
+const int MRD_SV_EEPROM_LINES = 2;     // EEPROMに保存するサーボ系統数(L,R)
+static_assert(MRD_EST_ORIGIDX + MRD_EST_LEN <= MRDM_LEN - 2, "推定値がMeridim配列に収まらない");
 const int PAD_LEN = 5;                 // リモコン用配列の長さ
 TaskHandle_t thp[4];                   // マルチスレッドのタスクハンドル格納用
 
@@ -104,14 +88,7 @@ TaskHandle_t thp[4];                   // マルチスレッドのタスクハ
 //  クラス・構造体・共用体
 //------------------------------------------------------------------------------------
 
-// Meridim配列用の共用体の設定
-typedef union
-{
-  short sval[MRDM_LEN + 4];           // short型で90個の配列データを持つ
-  unsigned short usval[MRDM_LEN + 2]; // 上記のunsigned short型
-  uint8_t bval[+4];                   // byte型で180個の配列データを持つ
-  uint8_t ubval[MRDM_BYTE + 4];       // 上記のunsigned byte型
-} Meridim90Union;
+// Meridim配列(共用体の定義はmrd_servo_param.h)
 Meridim90Union s_udp_meridim;       // Meridim配列データ送信用(short型, センサや角度は100倍値)
 Meridim90Union r_udp_meridim;       // Meridim配列データ受信用
 Meridim90Union s_udp_meridim_dummy; // SPI送信ダミー用
@@ -158,11 +135,12 @@ MrdSq mrdsq;
 // タイマー管理用の変数
 struct MrdTimer
 {
-  long frame_ms = FRAME_DURATION; // 1フレームあたりの単位時間(ms)
-  int count_loop = 0;             // サイン計算用の循環カウンタ
-  int count_loop_dlt = 2;         // サイン計算用の循環カウンタを1フレームにいくつ進めるか
-  int count_loop_max = 359999;    // 循環カウンタの最大値
-  unsigned long count_frame = 0;  // メインフレームのカウント
+  long frame_ms = FRAME_DURATION;   // 1フレームあたりの単位時間(ms)
+  int count_loop = 0;               // サイン計算用の循環カウンタ
+  int count_loop_dlt = 2;           // サイン計算用の循環カウンタを1フレームにいくつ進めるか
+  int count_loop_max = 359999;      // 循環カウンタの最大値
+  unsigned long count_frame = 0;    // メインフレームのカウント
+  unsigned long frame_start_us = 0; // 今回のフレームの開始時刻(us)
 
   int pad_interval = (PAD_INTERVAL - 1 > 0) ? PAD_INTERVAL - 1 : 1; // パッドの問い合わせ待機時間
 };
@@ -194,6 +172,13 @@ typedef union // リモコン値格納用
 PadUnion pad_array = {0}; // pad値の格納用配列
 PadUnion pad_i2c = {0};   // pad値のi2c送受信用配列
 
+// リモコンの受信値一式(Core0のBluetoothスレッドからloop()へトリプルバッファで受け渡す)
+struct PadSample
+{
+  uint64_t ui64val = 0; // pad_arrayと同じ並びのボタンとアナログ値
+};
+MrdTripleBuffer<PadSample> pad_sample;
+
 // リモコンのアナログ入力データ
 struct PadValue
 {
@@ -212,7 +197,7 @@ PadValue pad_analog;
 // 6軸or9軸センサーの値
 struct AhrsValue
 {
-  Adafruit_BNO055 bno = Adafruit_BNO055(55, 0x28, &Wire); // BNO055のインスタンス
+  Adafruit_BNO055 bno = Adafruit_BNO055(55, BNO055_I2C_ADDR, &Wire); // BNO055のインスタンス
 
   MPU6050 mpu6050;        // MPU6050のインスタンス
   uint8_t mpuIntStatus;   // holds actual interrupt status byte from MPU
@@ -228,10 +213,7 @@ struct AhrsValue
   float read[16]; // mpuからの読み込んだ一次データacc_x,y,z,gyro_x,y,z,mag_x,y,z,gr_x,y,z,rpy_r,p,y,temp
 
   float zeros[16] = {0};               // リセット用
-  float ave_data[16];                  // 上記の移動平均値を入れる
   float result[16];                    // 加工後の最新のmpuデータ(二次データ)
-  float stock_data[IMUAHRS_STOCK][16]; // 上記の移動平均値計算用のデータストック
-  int stock_count = 0;                 // 上記の移動平均値計算用のデータストックを輪番させる時の変数
   VectorInt16 aa;                      // [x, y, z]            加速度センサの測定値
   VectorInt16 gyro;                    // [x, y, z]            角速度センサの測定値
   VectorInt16 mag;                     // [x, y, z]            磁力センサの測定値
@@ -239,61 +221,53 @@ struct AhrsValue
 };
 AhrsValue ahrs;
 
-// サーボ用変数
-struct ServoParam
+// AHRSの計測値一式(Core0のセンサ読込スレッドからloop()へトリプルバッファで受け渡す)
+struct AhrsSample
 {
-  // サーボの最大接続 (サーボ送受信のループ処理数)
-  int num_max;
-
-  // 各サーボのマウントありなし(config.hで設定)
-  int ixl_mount[IXL_MAX]; // L系統
-  int ixr_mount[IXR_MAX]; // R系統
-
-  // 各サーボのコード上のインデックスに対し, 実際に呼び出すハードウェアのID番号(config.hで設定)
-  int ixl_id[IXL_MAX]; // L系統の実サーボ呼び出しID番号
-  int ixr_id[IXR_MAX]; // R系統の実サーボ呼び出しID番号
-
-  // 各サーボの正逆方向補正用配列(config.hで設定)
-  int ixl_cw[IXL_MAX]; // L系統
-  int ixr_cw[IXR_MAX]; // R系統
-
-  // 各サーボの直立ポーズトリム値(config.hで設定)
-  float ixl_trim[IXL_MAX]; // L系統
-  float ixr_trim[IXR_MAX]; // R系統
-
-  // 各サーボのベンダーと型番(config.hで設定)
-  float ixl_type[IXL_MAX]; // L系統
-  float ixr_type[IXR_MAX]; // R系統
-
-  // 各サーボのポジション値(degree)
-  float ixl_tgt[IXL_MAX] = {0};      // L系統の目標値
-  float ixr_tgt[IXR_MAX] = {0};      // R系統の目標値
-  float ixl_tgt_past[IXL_MAX] = {0}; // L系統の前回の値
-  float ixr_tgt_past[IXR_MAX] = {0}; // R系統の前回の値
-
-  // サーボのエラーカウンタ配列
-  int ixl_err[IXL_MAX] = {0}; // L系統
-  int ixr_err[IXR_MAX] = {0}; // R系統
-
-  // サーボのコンディションステータス配列
-  uint16_t ixl_stat[IXL_MAX] = {0}; // L系統サーボのコンディションステータス配列
-  uint16_t ixr_stat[IXR_MAX] = {0}; // R系統サーボのコンディションステータス配列
+  float read[16] = {0};   // ahrs.readと同じ並び. acc_x,y,z,gyro_x,y,z,mag_x,y,z,gr_x,y,z,rpy_r,p,y,temp
+  float quat[4] = {1, 0}; // 姿勢のクオータニオン w,x,y,z (BNO055_BURST_READのみ)
+  float lin_acc[3] = {0}; // 重力を除いた加速度 x,y,z m/s^2 (BNO055_BURST_READのみ)
+  uint8_t calib = 0;      // BNO055のキャリブレーション状態(CALIB_STATレジスタ値)
+  uint32_t t_us = 0;      // 計測時刻(読み取り開始時のmicros())
+  uint32_t seq = 0;       // 計測の通し番号
 };
+MrdTripleBuffer<AhrsSample> ahrs_sample;
+
+// サーボ用変数(構造体の定義はmrd_servo_param.h)
 ServoParam sv;
 
+// PCへのモニタ表示の出力先
+// C系統はUART0(PCとのUSBシリアル)のピンを付け替えて使うため, C系統を使う場合は表示を全て捨て,
+// サーボの通信に混ざらないようにする.
+class MrdNullStream : public Stream
+{
+public:
+  size_t write(uint8_t) { return 1; }
+  size_t write(const uint8_t *, size_t a_size) { return a_size; }
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+};
+#if MOUNT_SERVO_LINE_C
+MrdNullStream serial_null;
+Stream &serial_pc = serial_null;
+#else
+Stream &serial_pc = Serial;
+#endif
+
 // モニタリング設定
 struct MrdMonitor
 {
-  bool flow = MONITOR_FLOW;           // フローを表示
-  bool all_err = MONITOR_ERR_ALL;     // 全経路の受信エラー率を表示
-  bool servo_err = MONITOR_ERR_SERVO; // サーボエラーを表示
-  bool seq_num = MONITOR_SEQ;         // シーケンス番号チェックを表示
-  bool pad = MONITOR_PAD;             // リモコンのデータを表示
+  bool flow = MONITOR_FLOW && !MOUNT_SERVO_LINE_C; // フローを表示(Meridianライブラリが直接UART0に出力する)
+  bool all_err = MONITOR_ERR_ALL;                  // 全経路の受信エラー率を表示
+  bool servo_err = MONITOR_ERR_SERVO;              // サーボエラーを表示
+  bool seq_num = MONITOR_SEQ;                      // シーケンス番号チェックを表示
+  bool pad = MONITOR_PAD;                          // リモコンのデータを表示
 };
 MrdMonitor monitor;
 
 #include "mrd_disp.h"
-MrdMsgHandler mrd_disp(Serial);
+MrdMsgHandler mrd_disp(serial_pc);
 
 //==================================================================================================
 //  関数各種
@@ -4,6 +4,7 @@
 // ヘッダファイルの読み込み
 #include "config.h"
 #include "main.h"
+#include "mrd_module/sv_ics.h"
 
 // ライブラリ導入
 #include <ESP32Wiimote.h> // Wiiコントローラー
@@ -19,6 +20,39 @@ constexpr unsigned short PAD_TABLE_WIIMOTE_ORIG[16] = {
 constexpr unsigned short PAD_TABLE_KRC5FH_TO_COMMON[16] = { //
     0, 64, 32, 128, 1, 4, 2, 8, 1024, 4096, 512, 2048, 16, 64, 32, 256};
 
+// ボタンの押下/解放のエッジ. WIIMOTEはBluetoothスレッドが受信ごとに検出し, リングでloop()へ受け渡す
+struct PadEvent {
+  uint32_t t_us;     // 検出時刻(micros())
+  uint16_t pressed;  // 押されたボタンのビット
+  uint16_t released; // 離されたボタンのビット
+};
+MrdSpscRing<PadEvent, PAD_EVENT_RING_LEN> pad_event_ring;
+
+// loop()側で集計したエッジ. Meridimの[MRD_PAD_LATCH], [MRD_PAD_EVENTS]で送信する
+struct PadEdge {
+  uint16_t prev = 0;      // KRR5FH用の前回のボタン値
+  uint16_t latched = 0;   // 押されたボタンのビット. MCMD_PAD_LATCH_ACKで解除されるまで保持
+  uint16_t count = 0;     // 押下と解放のエッジの累計(ボタンごとに1つ)
+  uint32_t last_t_us = 0; // 最後のエッジの検出時刻
+};
+PadEdge pad_edge;
+
+/// @brief 前回と今回のボタン値からエッジを作る.
+/// @return エッジがあればtrue.
+bool mrd_pad_make_event(uint16_t a_prev, uint16_t a_now, PadEvent &a_event) {
+  a_event.t_us = micros();
+  a_event.pressed = a_now & ~a_prev;
+  a_event.released = a_prev & ~a_now;
+  return (a_event.pressed | a_event.released) != 0;
+}
+
+/// @brief エッジをラッチとカウンタに反映する. loop()から呼ぶ.
+void mrd_pad_apply_event(PadEdge &a_edge, const PadEvent &a_event) {
+  a_edge.latched |= a_event.pressed;
+  a_edge.count += __builtin_popcount(a_event.pressed) + __builtin_popcount(a_event.released);
+  a_edge.last_t_us = a_event.t_us;
+}
+
 //==================================================================================================
 //  タイプ別のJOYPAD読み込み処理
 //==================================================================================================
@@ -29,8 +63,9 @@ constexpr unsigned short PAD_TABLE_KRC5FH_TO_COMMON[16] = { //
 
 /// @brief KRC-5FHジョイパッドからデータを読み取り, 指定された間隔でデータを更新する.
 /// @param a_interval 読み取り間隔(ミリ秒).
+/// @param a_ics KRR-5FHの受信機がつながるICSの通信バス.
 /// @return 更新されたジョイパッドの状態を64ビット整数で返す.
-uint64_t mrd_pad_read_krc(uint a_interval, IcsHardSerialClass &a_ics) {
+uint64_t mrd_pad_read_krc(uint a_interval, IcsBaseClass &a_ics) {
   static uint64_t pre_val_tmp = 0; // 前回の値を保持する静的変数
   int8_t pad_analog_tmp[4] = {0};  // アナログ入力のデータ組み立て用
   static int calib[4] = {0};       // アナログスティックのキャリブレーション値
@@ -43,7 +78,7 @@ uint64_t mrd_pad_read_krc(uint a_interval, IcsHardSerialClass &a_ics) {
     int krr_analog_tmp[4];             // krrからのアナログ入力データ
     unsigned short pad_common_tmp = 0; // PS準拠に変換後のボタンデータ
     bool rcvd_tmp;                     // 受信機がデータを受信成功したか
-    rcvd_tmp = ics_R.getKrrAllData(&krr_button_tmp, krr_analog_tmp);
+    rcvd_tmp = a_ics.getKrrAllData(&krr_button_tmp, krr_analog_tmp);
     delayMicroseconds(2);
 
     if (rcvd_tmp) // リモコンデータが受信できていたら
@@ -110,9 +145,10 @@ uint64_t mrd_pad_read_krc(uint a_interval, IcsHardSerialClass &a_ics) {
 //----------------------------------------------------------------------
 
 /// @brief Wiiリモコンからの入力データを受信し, 処理する.
+/// @param a_rcvd 新しいデータを受信した場合にtrueを格納する.
 /// @return 更新されたジョイパッドの状態を64ビット整数で返す.
 /// @note ESP32Wiimoteインスタンス wiimote, 定数PAD_GENERALIZE を関数内で使用.
-uint64_t mrd_bt_read_wiimote() {
+uint64_t mrd_bt_read_wiimote(bool &a_rcvd) {
   static uint64_t pre_val_tmp = 0; // 前回の値を保持する静的変数
   static int calib_l1x = 0;
   static int calib_l1y = 0;
@@ -173,8 +209,10 @@ uint64_t mrd_bt_read_wiimote() {
     //  new_val_tmp |= ((uint64_t)new_analog_tmp[3]) << 40;
 
     pre_val_tmp = new_val_tmp;
+    a_rcvd = true;
     return new_val_tmp;
   }
+  a_rcvd = false;
   return pre_val_tmp;
 }
 
@@ -186,15 +224,26 @@ uint64_t mrd_bt_read_wiimote() {
 /// @param a_pad_type ジョイパッドのタイプを示す列挙型(MERIMOTE, BLUERETRO, SBDBT, KRR5FH).
 /// @param a_pad_data 64ビットのボタンデータ
 /// @return 64ビット整数に変換された受信データ
-/// @note WIIMOTEの場合は, スレッドがpad_array.ui64valを自動更新.
+/// @note WIIMOTEの場合は, スレッドがpad_sampleに公開した最新の一式を返す.
 uint64_t mrd_pad_read(PadType a_pad_type, uint64_t a_pad_data) {
 
   if (a_pad_type == KRR5FH) { // KRR5FH
-    return mrd_pad_read_krc(PAD_INTERVAL, ics_R);
+    const uint64_t val = mrd_pad_read_krc(PAD_INTERVAL, mrd_ics_bus(R));
+    PadEvent event;
+    if (mrd_pad_make_event(pad_edge.prev, uint16_t(val), event)) { // 読み取りごとのエッジ
+      mrd_pad_apply_event(pad_edge, event);
+    }
+    pad_edge.prev = uint16_t(val);
+    return val;
   }
 
   if (a_pad_type == WIIMOTE) { // Wiimote
-    return a_pad_data;
+    PadEvent event;
+    while (pad_event_ring.pop(event)) { // 前フレーム以降に受信した全てのエッジ
+      mrd_pad_apply_event(pad_edge, event);
+    }
+    pad_sample.update(); // Bluetoothスレッドが公開した最新の一式に切り替え
+    return pad_sample.front().ui64val;
   }
   return 0;
 }
@@ -212,7 +261,7 @@ bool mrd_bt_settings(int a_mount_pad,
                      int a_timeout,
                      ESP32Wiimote &a_wiimote,
                      int a_led,
-                     HardwareSerial &a_serial) {
+                     Stream &a_serial) {
   // Wiiコントローラの接続開始
   if (a_mount_pad == 5) {
     a_serial.println("Try to connect Wiimote...");
@@ -261,10 +310,22 @@ bool mrd_bt_settings(int a_mount_pad,
 
 /// @brief サブCPU (Core0) で実行されるBluetooth通信用のルーチン.
 /// @param args この関数に渡される引数. 現在は不使用.
-/// @note PadUnion型の pad_array.ui64val, 定数PAD_INTERVAL, WIIMOTE を関数内で使用.
+/// @note 受信値はpad_sampleに公開する. 定数PAD_INTERVALを関数内で使用.
 void Core0_BT_r(void *args) { // サブCPU(Core0)で実行するプログラム
-  while (true) {              // Bluetooth待受用の無限ループ
-    pad_array.ui64val = mrd_bt_read_wiimote();
+  uint16_t prev = 0; // 前回のボタン値
+  while (true) {     // Bluetooth待受用の無限ループ
+    bool rcvd = false;
+    const uint64_t val = mrd_bt_read_wiimote(rcvd);
+    PadEvent event;
+    if (rcvd && mrd_pad_make_event(prev, uint16_t(val), event)) { // 受信ごとのエッジをloop()へ
+      pad_event_ring.push(event);
+      prev = uint16_t(val);
+    }
+    if (rcvd) { // 受信した回だけ一式を揃えて公開する
+      PadSample &sample = pad_sample.back();
+      sample.ui64val = val;
+      pad_sample.publish();
+    }
     vTaskDelay(PAD_INTERVAL); // 他のタスクにCPU時間を譲る
   }
 }
@@ -293,4 +354,12 @@ bool meriput90_pad(Meridim90Union &a_meridim, PadUnion a_pad_array, bool a_marge
   return true;
 }
 
+/// @brief meridim配列にボタンのエッジのラッチと累計を書き込む.
+/// @param a_meridim Meridim配列の共用体. 参照渡し.
+/// @param a_edge loop()側で集計したエッジ.
+void meriput90_pad_edge(Meridim90Union &a_meridim, const PadEdge &a_edge) {
+  a_meridim.usval[MRD_PAD_LATCH] = a_edge.latched;
+  a_meridim.usval[MRD_PAD_EVENTS] = a_edge.count;
+}
+
 #endif // __MERIDIAN_BT_PAD_H__
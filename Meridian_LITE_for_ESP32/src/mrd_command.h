@@ -6,8 +6,12 @@
 #include "main.h"
 
 // ライブラリ導入
+#include "mrd_bt_pad.h"
 #include "mrd_eeprom.h"
+#include "mrd_module/ahrs_filter.h"
+#include "mrd_move.h"
 #include "mrd_servo.h"
+#include "mrd_wire0.h"
 
 //==================================================================================================
 //  コマンド処理
@@ -18,7 +22,7 @@
 /// @param a_flg_exe Meridimの受信成功判定フラグ.
 /// @param a_sv サーボパラメータの構造体.(参照渡し)
 /// @return コマンドを実行した場合はtrue, しなかった場合はfalseを返す.
-bool execute_master_command_1(Meridim90Union &a_meridim, bool a_flg_exe, ServoParam &a_sv, HardwareSerial &a_serial)
+bool execute_master_command_1(Meridim90Union &a_meridim, bool a_flg_exe, ServoParam &a_sv, Stream &a_serial)
 {
   if (!a_flg_exe)
   {
@@ -30,16 +34,17 @@ bool execute_master_command_1(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
   if (a_meridim.sval[MRD_MASTER] == MCMD_ERR_CLEAR_SERVO_ID)
   {
     a_meridim.bval[MRD_ERR_l] = 0;
-    for (int i = 0; i < IXL_MAX; i++)
+    for (int line = 0; line < MRD_SERVO_LINES; line++)
     {
-      a_sv.ixl_err[i] = 0;
-    }
-    for (int i = 0; i < IXR_MAX; i++)
-    {
-      a_sv.ixr_err[i] = 0;
+      a_sv.err[line] = 0;
+      a_sv.stale[line] = 0;
+      for (int i = 0; i < MRD_SERVO_SLOTS; i++)
+      {
+        a_sv.err_cnt[line][i] = 0;
+      }
     }
     String msg_tmp = "cmd: reset servo error id.[" + String(MCMD_ERR_CLEAR_SERVO_ID) + "]";
-    Serial.println(msg_tmp);
+    serial_pc.println(msg_tmp);
     return true;
   }
 
@@ -51,6 +56,14 @@ bool execute_master_command_1(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
     return true;
   }
 
+  // コマンド:MCMD_PAD_LATCH_ACK (10018) PCが受け取ったボタン押下のラッチを解除
+  // [MRD_PAD_LATCH]に解除するビットを指定する. 指定外のビットと未送信の押下は残す
+  if (a_meridim.sval[MRD_MASTER] == MCMD_PAD_LATCH_ACK)
+  {
+    pad_edge.latched &= ~a_meridim.usval[MRD_PAD_LATCH];
+    return true;
+  }
+
   // コマンド:MCMD_EEPROM_ENTER_WRITE (10009) EEPROMの書き込みモードスタート
   if (a_meridim.sval[MRD_MASTER] == MCMD_EEPROM_ENTER_WRITE)
   {
@@ -63,10 +76,10 @@ bool execute_master_command_1(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
   if (a_meridim.sval[MRD_MASTER] == MCMD_EEPROM_SAVE_TRIM)
   {
     String msg_tmp = "cmd: set EEPROM data from current trim.[" + String(MCMD_EEPROM_SAVE_TRIM) + "]";
-    Serial.println(msg_tmp);
+    serial_pc.println(msg_tmp);
 
-    // 空のUnionEEPROM構造体を作成し初期化
-    UnionEEPROM array_tmp = {0};
+    // 現在のEEPROMの内容を元にする(サーボ設定以外のページを保持する)
+    UnionEEPROM array_tmp = mrd_eeprom_read();
 
     // a_serial.println("a_meridim:");
     // for (int i = 0; i < 90; i++) {
@@ -80,8 +93,8 @@ bool execute_master_command_1(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
     {
       array_tmp.saval[1][20 + i * 2] = a_meridim.sval[20 + i * 2];
       array_tmp.saval[1][21 + i * 2] = a_meridim.sval[21 + i * 2];
-      array_tmp.saval[1][50 + i * 2] = a_meridim.sval[50 + i * 2]; // - int(sv.ixl_trim[i] * 100);
-      array_tmp.saval[1][51 + i * 2] = a_meridim.sval[51 + i * 2]; // - int(sv.ixr_trim[i] * 100);
+      array_tmp.saval[1][50 + i * 2] = a_meridim.sval[50 + i * 2]; // - int(sv.trim[L][i] * 100);
+      array_tmp.saval[1][51 + i * 2] = a_meridim.sval[51 + i * 2]; // - int(sv.trim[R][i] * 100);
     }
 
     // a_serial.println("array_tmp:");
@@ -104,25 +117,87 @@ bool execute_master_command_1(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
     return true;
   }
 
+  // コマンド:MCMD_EEPROM_PCTOBOARD_DATA2 (10302) PCから受け取った動作プロファイルをEEPROMの[2][*]に書き込む
+  if (a_meridim.sval[MRD_MASTER] == MCMD_EEPROM_PCTOBOARD_DATA2)
+  {
+    String msg_tmp = "cmd: set EEPROM[2][*] (motion profile) from PC.[" + String(MCMD_EEPROM_PCTOBOARD_DATA2) + "]";
+    serial_pc.println(msg_tmp);
+
+    // サーボのスロット部分のみを書き換える
+    UnionEEPROM array_tmp = mrd_eeprom_read();
+    for (int i = MRD_L_ORIGIDX; i < MRD_R_ORIGIDX + MRD_SERVO_SLOTS * 2; i++)
+    {
+      array_tmp.saval[EEPROM_PROFILE_PAGE][i] = a_meridim.sval[i];
+    }
+    mrd_eeprom_write(array_tmp, EEPROM_PROTECT, a_serial);
+
+    // 書き込んだ内容を反映する
+    mrd_mv_profile_load(a_sv, mrd_eeprom_read().saval[EEPROM_PROFILE_PAGE]);
+    return true;
+  }
+
+  // コマンド:MCMD_SENSOR_FILTER (10017) センサ値のフィルタをチャンネルごとに設定
+  // 指定はセンサ値の欄を使うため, センサ値で上書きされる前の第1群で処理する
+  if (a_meridim.sval[MRD_MASTER] == MCMD_SENSOR_FILTER)
+  {
+    const uint16_t ch_bits = a_meridim.usval[MRD_FILTER_CH];
+    const int mode = a_meridim.sval[MRD_FILTER_MODE];
+    const int param = a_meridim.sval[MRD_FILTER_PARAM];
+    AhrsFilterConfig cfg_tmp = ahrs_filter_edit;
+    bool ok = (mode >= AHRS_FILT_NONE && mode <= AHRS_FILT_LPF);
+    for (int ch = 0; ok && ch < AHRS_FILTER_CH; ch++)
+    {
+      if (!(ch_bits & (1U << ch)))
+      {
+        continue;
+      }
+      mrd_ahrs_filter_set_median(cfg_tmp, ch, a_meridim.sval[MRD_FILTER_MEDIAN] != 0);
+      if (mode == AHRS_FILT_AVE)
+      {
+        ok = mrd_ahrs_filter_set_ave(cfg_tmp, ch, param);
+      }
+      else if (mode == AHRS_FILT_LPF)
+      {
+        ok = mrd_ahrs_filter_set_lpf(cfg_tmp, ch, param * 0.1f, AHRS_FILTER_RATE_HZ);
+      }
+      else
+      {
+        mrd_ahrs_filter_set_none(cfg_tmp, ch);
+      }
+    }
+    if (!ok)
+    {
+      serial_pc.println("cmd: sensor filter setting failed.[" + String(MCMD_SENSOR_FILTER) + "]");
+      return false;
+    }
+    ahrs_filter_edit = cfg_tmp;
+    ahrs_filter_cfg.write(ahrs_filter_edit); // センサ用スレッドへ受け渡す
+    String msg_tmp = "cmd: set sensor filter mode " + String(mode) + " to ch 0x" + String(ch_bits, HEX) + ".[" +
+                     String(MCMD_SENSOR_FILTER) + "]";
+    serial_pc.println(msg_tmp);
+    return true;
+  }
+
   // コマンド:MCMD_EEPROM_LOAD_TRIM (10102) EEPROMからTRIM値を読み込んで設定
   if (a_meridim.sval[MRD_MASTER] == MCMD_EEPROM_LOAD_TRIM)
   {
     // EEPROMのデータを展開する
-    mrd_eeprom_load_servosettings(a_sv, true, Serial);
+    mrd_eeprom_load_servosettings(a_sv, true, serial_pc);
+    mrd_servo_ics_affine_update(a_sv); // トリム値の変更を角度変換係数に反映
 
     // サーボをEEPROMのTRIM値で補正されたHOME(原点)に移動する
     for (int i = 0; i < MRD_SERVO_SLOTS; i++)
     {
       a_meridim.sval[MRD_L_ORIGIDX + 1 + i * 2] = 0; // L系統の目標値を原点に
       a_meridim.sval[MRD_R_ORIGIDX + 1 + i * 2] = 0; // R系統の目標値を原点に
-      a_sv.ixl_tgt[i] = 0;                           //
-      a_sv.ixr_tgt[i] = 0;
+      a_sv.tgt[L][i] = 0;                            //
+      a_sv.tgt[R][i] = 0;
     }
 
     // サーボ動作を実行する
     if (!MODE_ESP32_STANDALONE)
     {
-      mrd_servo_drive_lite(a_meridim, MOUNT_SERVO_TYPE_L, MOUNT_SERVO_TYPE_R, a_sv);
+      mrd_servo_drive_lite(a_meridim, a_sv);
     }
 
     flg.count_frame_reset = true; // フレームの管理時計をリセットフラグをセット
@@ -137,7 +212,7 @@ bool execute_master_command_1(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
 /// @param a_flg_exe Meridimの受信成功判定フラグ.
 /// @param a_sv サーボパラメータの構造体.(参照渡し)
 /// @return コマンドを実行した場合はtrue, しなかった場合はfalseを返す.
-bool execute_master_command_2(Meridim90Union &a_meridim, bool a_flg_exe, ServoParam &a_sv, HardwareSerial &a_serial)
+bool execute_master_command_2(Meridim90Union &a_meridim, bool a_flg_exe, ServoParam &a_sv, Stream &a_serial)
 {
   if (!a_flg_exe)
   {
@@ -159,7 +234,21 @@ bool execute_master_command_2(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
   {
     ahrs.yaw_origin = ahrs.yaw_source;
     String msg_tmp = "cmd: caliblate sensor's yaw.[" + String(MCMD_SENSOR_YAW_CALIB) + "]";
-    Serial.println(msg_tmp);
+    serial_pc.println(msg_tmp);
+    return true;
+  }
+
+  // コマンド:MCMD_SENSOR_ALL_CALIB(10003) BNO055のキャリブレーション値をEEPROMに保存
+  // 読込はセンサ用スレッドが行い, 書き込みはloop()のmrd_wire0_bno055_calib_poll()が行う
+  if (a_meridim.sval[MRD_MASTER] == MCMD_SENSOR_ALL_CALIB)
+  {
+    String msg_tmp = "cmd: save sensor's calibration to EEPROM.[" + String(MCMD_SENSOR_ALL_CALIB) + "]";
+    serial_pc.println(msg_tmp);
+    if (MOUNT_IMUAHRS != BNO055_AHRS || !mrd_wire0_bno055_calib_request())
+    {
+      serial_pc.println("calibration save not available.");
+      return false;
+    }
     return true;
   }
 
@@ -169,7 +258,7 @@ bool execute_master_command_2(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
     flg.udp_board_passive = true; // UDP送信をパッシブモードに
     flg.count_frame_reset = true; // フレームの管理時計をリセットフラグをセット
     String msg_tmp = "cmd: enter passive mode.[" + String(MCMD_BOARD_TRANSMIT_PASSIVE) + "]";
-    Serial.println(msg_tmp);
+    serial_pc.println(msg_tmp);
     return true;
   }
 
@@ -187,7 +276,7 @@ bool execute_master_command_2(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
     // ボードの末端処理をmeridim[2]ミリ秒だけ止める.
 
     String msg_tmp = "cmd: stop ESP32's processing during " + String(int(a_meridim.sval[MRD_STOP_FRAMES])) + " ms.[" + String(MCMD_BOARD_TRANSMIT_PASSIVE) + "]";
-    Serial.println(msg_tmp);
+    serial_pc.println(msg_tmp);
 
     for (int i = 0; i < int(a_meridim.sval[MRD_STOP_FRAMES]); i++)
     {
@@ -201,7 +290,7 @@ bool execute_master_command_2(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
   // コマンド:MCMD_ALL_SERVOS_CENTER (30002) 射的トリガーの動作
   if (a_meridim.sval[MRD_MASTER] == MCMD_VRSHATEKI_TRIGGER)
   {
-    Serial.print("TRIGGERED!");
+    serial_pc.print("TRIGGERED!");
 
     // サーボ動作を実行する
     if (!MODE_ESP32_STANDALONE)
@@ -211,18 +300,18 @@ bool execute_master_command_2(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
         // 一時停止してトリガーサーボを１回動作
         mrd_sv_drive_ics_individual(VRSHATEKI_TRIGGER_SERVO_NUMBER, 0, "L");
         delay(200);
-        mrd_sv_drive_ics_individual(VRSHATEKI_TRIGGER_SERVO_NUMBER, VRSHATEKI_TRIGGER_ANGLE, "L");
+        mrd_sv_drive_ics_individual(VRSHATEKI_TRIGGER_SERVO_NUMBER, VRSHATEKI_TRIGGER_ANGLE * 100, "L");
         delay(500);
         mrd_sv_drive_ics_individual(VRSHATEKI_TRIGGER_SERVO_NUMBER, 0, "L");
         delay(1000);
-        Serial.print(" and servo excuted.");
+        serial_pc.print(" and servo excuted.");
       }
       else
       {
-        Serial.print(" ... but ALL SERVOS OFF.");
+        serial_pc.print(" ... but ALL SERVOS OFF.");
       }
     }
-    Serial.println();
+    serial_pc.println();
 
     flg.count_frame_reset = true; // フレームの管理時計をリセットフラグをセット
     return true;
@@ -236,14 +325,14 @@ bool execute_master_command_2(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
     {
       a_meridim.sval[MRD_L_ORIGIDX + 1 + i * 2] = 0; // L系統の目標値を原点に
       a_meridim.sval[MRD_R_ORIGIDX + 1 + i * 2] = 0; // R系統の目標値を原点に
-      a_sv.ixl_tgt[i] = 0;                           //
-      a_sv.ixr_tgt[i] = 0;
+      a_sv.tgt[L][i] = 0;                            //
+      a_sv.tgt[R][i] = 0;
     }
 
     // // サーボ動作を実行する
     // if (!MODE_ESP32_STANDALONE)
     // {
-    //   mrd_servo_drive_lite(a_meridim, MOUNT_SERVO_TYPE_L, MOUNT_SERVO_TYPE_R, a_sv);
+    //   mrd_servo_drive_lite(a_meridim, a_sv);
     // }
 
     // flg.count_frame_reset = true; // フレームの管理時計をリセットフラグをセット
@@ -258,7 +347,7 @@ bool execute_master_command_2(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
 /// @param a_flg_exe Meridimの受信成功判定フラグ.
 /// @param a_sv サーボパラメータの構造体.(参照渡し)
 /// @return コマンドを実行した場合はtrue, しなかった場合はfalseを返す.
-bool execute_master_command_3(Meridim90Union &a_meridim, bool a_flg_exe, ServoParam &a_sv, HardwareSerial &a_serial)
+bool execute_master_command_3(Meridim90Union &a_meridim, bool a_flg_exe, ServoParam &a_sv, Stream &a_serial)
 {
   if (!a_flg_exe)
   {
@@ -280,55 +369,57 @@ bool execute_master_command_3(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
   {
 
     // EEPROMのデータを展開する
-    mrd_eeprom_load_servosettings(a_sv, true, Serial);
+    mrd_eeprom_load_servosettings(a_sv, true, serial_pc);
+    mrd_servo_ics_affine_update(a_sv); // トリム値の変更を角度変換係数に反映
 
     // サーボをEEPROMのTRIM値で補正されたHOME(原点)に移動する
     for (int i = 0; i < MRD_SERVO_SLOTS; i++)
     {
       a_meridim.sval[MRD_L_ORIGIDX + 1 + i * 2] = 0; // L系統の目標値を原点に
       a_meridim.sval[MRD_R_ORIGIDX + 1 + i * 2] = 0; // R系統の目標値を原点に
-      a_sv.ixl_tgt_past[i] = a_sv.ixl_tgt[i];        // 前回のdegreeをキープ
-      a_sv.ixr_tgt_past[i] = a_sv.ixr_tgt[i];
-      a_sv.ixl_tgt[i] = 0; //
-      a_sv.ixr_tgt[i] = 0;
+      a_sv.tgt_past[L][i] = a_sv.tgt[L][i];          // 前回のdegreeをキープ
+      a_sv.tgt_past[R][i] = a_sv.tgt[R][i];
+      a_sv.tgt[L][i] = 0; //
+      a_sv.tgt[R][i] = 0;
     }
 
     // サーボ動作を実行する
     if (!MODE_ESP32_STANDALONE)
     {
-      mrd_servo_drive_lite(a_meridim, MOUNT_SERVO_TYPE_L, MOUNT_SERVO_TYPE_R, a_sv);
+      mrd_servo_drive_lite(a_meridim, a_sv);
     }
 
     // サーボの目標値として現在のTRIM値をセットする
     for (int i = 0; i < MRD_SERVO_SLOTS; i++)
     {
-      a_meridim.sval[MRD_L_ORIGIDX + 1 + i * 2] = a_sv.ixl_trim[i];
-      a_meridim.sval[MRD_R_ORIGIDX + 1 + i * 2] = a_sv.ixr_trim[i];
+      a_meridim.sval[MRD_L_ORIGIDX + 1 + i * 2] = a_sv.trim[L][i];
+      a_meridim.sval[MRD_R_ORIGIDX + 1 + i * 2] = a_sv.trim[R][i];
     }
 
     // サーボのTRIM値をゼロリセットする
     for (int i = 0; i < MRD_SERVO_SLOTS; i++)
     {
-      a_sv.ixl_trim[i] = 0;
-      a_sv.ixr_trim[i] = 0;
+      a_sv.trim[L][i] = 0;
+      a_sv.trim[R][i] = 0;
     }
+    mrd_servo_ics_affine_update(a_sv); // トリム値の変更を角度変換係数に反映
 
     // サーボ動作を実行する. サーボはTRIM値を0としつつ, tgtとしてこれまでのTRIM値の角度をキープする
     if (!MODE_ESP32_STANDALONE)
     {
-      mrd_servo_drive_lite(a_meridim, MOUNT_SERVO_TYPE_L, MOUNT_SERVO_TYPE_R, a_sv); // サーボ動作を実行する
+      mrd_servo_drive_lite(a_meridim, a_sv); // サーボ動作を実行する
     }
 
     // サーボ設定を格納する ####(おかしそう)
     for (int i = 0; i < MRD_SERVO_SLOTS; i++)
     {
-      a_meridim.sval[MRD_L_ORIGIDX + i * 2] = a_sv.ixl_trim[i];
-      a_meridim.sval[MRD_R_ORIGIDX + i * 2] = a_sv.ixr_trim[i];
+      a_meridim.sval[MRD_L_ORIGIDX + i * 2] = a_sv.trim[L][i];
+      a_meridim.sval[MRD_R_ORIGIDX + i * 2] = a_sv.trim[R][i];
     }
 
     // サーボの設定値とTRIM値をPCに送信する
     UnionEEPROM array_tmp = mrd_eeprom_read();
-    for (int i = 0; i < MRDM_LEN; i++)
+    for (int i = 0; i < EEPROM_PAGE_LEN; i++)
     {
       a_meridim.sval[i] = array_tmp.saval[1][i];
     }
@@ -343,7 +434,7 @@ bool execute_master_command_3(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
     a_serial.println();
 
     String msg_tmp = "cmd: enter trim setting mode and send EEPROM[1][*] to PC.[" + String(MCMD_START_TRIM_SETTING) + "]";
-    Serial.println(msg_tmp);
+    serial_pc.println(msg_tmp);
     return true;
   }
 
@@ -352,14 +443,14 @@ bool execute_master_command_3(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
   {
     // eepromをs_meridimに代入する
     UnionEEPROM array_tmp = mrd_eeprom_read();
-    for (int i = 0; i < MRDM_LEN; i++)
+    for (int i = 0; i < EEPROM_PAGE_LEN; i++)
     {
       a_meridim.sval[i] = array_tmp.saval[0][i];
     }
     a_meridim.sval[MRD_MASTER] = MCMD_EEPROM_BOARDTOPC_DATA0;
 
     String msg_tmp = "cmd: enter trim setting mode and send EEPROM[0][*] to PC.[" + String(MCMD_EEPROM_BOARDTOPC_DATA0) + "]";
-    Serial.println(msg_tmp);
+    serial_pc.println(msg_tmp);
     return true;
   }
 
@@ -368,14 +459,14 @@ bool execute_master_command_3(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
   {
     // eepromをs_meridimに代入する
     UnionEEPROM array_tmp = mrd_eeprom_read();
-    for (int i = 0; i < MRDM_LEN; i++)
+    for (int i = 0; i < EEPROM_PAGE_LEN; i++)
     {
       a_meridim.sval[i] = array_tmp.saval[1][i];
     }
     a_meridim.sval[MRD_MASTER] = MCMD_EEPROM_BOARDTOPC_DATA1;
 
     String msg_tmp = "cmd: enter trim setting mode and send EEPROM[1][*] to PC.[" + String(MCMD_EEPROM_BOARDTOPC_DATA1) + "]";
-    Serial.println(msg_tmp);
+    serial_pc.println(msg_tmp);
     return true;
   }
 
@@ -384,14 +475,14 @@ bool execute_master_command_3(Meridim90Union &a_meridim, bool a_flg_exe, ServoPa
   {
     // eepromをs_meridimに代入する
     UnionEEPROM array_tmp = mrd_eeprom_read();
-    for (int i = 0; i < MRDM_LEN; i++)
+    for (int i = 0; i < EEPROM_PAGE_LEN; i++)
     {
       a_meridim.sval[i] = array_tmp.saval[2][i];
     }
     a_meridim.sval[MRD_MASTER] = MCMD_EEPROM_BOARDTOPC_DATA2;
 
     String msg_tmp = "cmd: enter trim setting mode and send EEPROM[2][*] to PC.[" + String(MCMD_EEPROM_BOARDTOPC_DATA2) + "]";
-    Serial.println(msg_tmp);
+    serial_pc.println(msg_tmp);
     return true;
   }
 
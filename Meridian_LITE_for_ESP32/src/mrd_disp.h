@@ -74,12 +74,12 @@ public:
   /// @brief 指定されたUARTラインのサーボIDを表示する.
   /// @param a_label UARTラインのラベル.
   /// @param a_max サーボの最大数.
-  /// @param a_mount サーボのマウント状態を示す配列.
+  /// @param a_mount サーボのマウント状態を示すビットセット.
   /// @param a_id サーボIDの配列.
-  void print_servo_ids(const char *a_label, int a_max, int *a_mount, const int *a_id) {
+  void print_servo_ids(const char *a_label, int a_max, uint32_t a_mount, const uint8_t *a_id) {
     m_serial.print(a_label);
-    for (int i = 0; i <= a_max; i++) {
-      if (a_mount[i] != 0) {
+    for (int i = 0; i < a_max && i < MRD_SERVO_SLOTS; i++) {
+      if (a_mount & (1UL << i)) {
         if (a_id[i] < 10) {
           m_serial.print(" ");
         }
@@ -94,9 +94,9 @@ public:
 
   /// @brief マウントされているサーボのIDを表示する.
   /// @param a_sv サーボパラメータの構造体.
-  void servo_mounts_2lines(ServoParam a_sv) {
-    print_servo_ids("UART_L Servos mounted: ", a_sv.num_max, a_sv.ixl_mount, a_sv.ixl_id);
-    print_servo_ids("UART_R Servos mounted: ", a_sv.num_max, a_sv.ixr_mount, a_sv.ixr_id);
+  void servo_mounts_2lines(const ServoParam &a_sv) {
+    print_servo_ids("UART_L Servos mounted: ", a_sv.num_max, a_sv.mount[L], a_sv.id[L]);
+    print_servo_ids("UART_R Servos mounted: ", a_sv.num_max, a_sv.mount[R], a_sv.id[R]);
   }
 
   /// @brief wifiの接続開始メッセージを出力する.
@@ -125,16 +125,14 @@ public:
         m_serial.println(" - Not supported yet.");
         break;
       case 21:
-        m_serial.print("RSxTTL (FUTABA)");
-        m_serial.println(" - Not supported yet.");
+        m_serial.println("RSxTTL (FUTABA)");
         break;
       case 31:
         m_serial.print("DYNAMIXEL Protocol 1.0");
         m_serial.println(" - Not supported yet.");
         break;
       case 32:
-        m_serial.print("DYNAMIXEL Protocol 2.0");
-        m_serial.println(" - Not supported yet.");
+        m_serial.println("DYNAMIXEL Protocol 2.0");
         break;
       case 43:
         m_serial.println("ICS3.5/3.6(KONDO,KRS)");
@@ -9,11 +9,21 @@
 // ライブラリ導入
 #include <EEPROM.h>
 
+#define EEPROM_PAGE_LEN 90 // EEPROMの1ページ(Meridim90と同じ並び)の長さ
+
+// ページ0: BNO055のキャリブレーション値. [0]に有効の印, [1]~[11]にオフセットレジスタ0x55~0x6Aの22バイト
+#define EEPROM_BNO055_PAGE 0       // 格納するページ
+#define EEPROM_BNO055_MAGIC 0x0B55 // 保存済みの値が有効であることを示す[0]の値
+#define BNO055_OFFSETS_LEN 22      // BNO055のキャリブレーション値のバイト数
+
+// ページ2: 動作プロファイル(MCMD_EEPROM_PCTOBOARD_DATA2で書込み, mv_profiler.hで読込)
+#define EEPROM_PROFILE_PAGE 2 // 格納するページ
+
 // EEPROM読み書き用共用体
 typedef union {
-  uint8_t bval[EEPROM_SIZE]; // 1バイト単位で540個のデータを持つ
-  int16_t saval[3][90];      // short型で3*90個の配列データを持つ
-  uint16_t usaval[3][90];    // unsigned short型で3*90個の配列データを持つ
+  uint8_t bval[EEPROM_SIZE];              // 1バイト単位で540個のデータを持つ
+  int16_t saval[3][EEPROM_PAGE_LEN];      // short型で3*90個の配列データを持つ
+  uint16_t usaval[3][EEPROM_PAGE_LEN];    // unsigned short型で3*90個の配列データを持つ
   int16_t sval[270];         // short型で270個のデータを持つ
   uint16_t usval[270];       // unsigned short型で270個のデータを持つ
 } UnionEEPROM;
@@ -41,34 +51,38 @@ bool mrd_eeprom_init(int a_eeprom_size) {
 UnionEEPROM mrd_eeprom_make_data_from_config(const ServoParam &a_sv) {
   UnionEEPROM array_tmp = {0};
 
-  for (int i = 0; i < 15; i++) {
-    // 各サーボのマウント有無と方向(正転・逆転)
-    uint16_t l_tmp = 0;
-    uint16_t r_tmp = 0;
-
-    // bit0 : マウント
-    if (sv.ixl_mount[i])
-      l_tmp |= 0x0001;
-    if (sv.ixr_mount[i])
-      r_tmp |= 0x0001;
-
-    // bit1-7 : サーボ ID
-    l_tmp |= static_cast<uint16_t>(sv.ixl_id[i] & 0x7F) << 1;
-    r_tmp |= static_cast<uint16_t>(sv.ixr_id[i] & 0x7F) << 1;
-
-    // bit8 : サーボ回転方向
-    if (sv.ixl_cw[i] > 0)
-      l_tmp |= 0x0100;
-    if (sv.ixr_cw[i] > 0)
-      r_tmp |= 0x0100;
-
-    // サーボのマウント有無, ID, 回転方向のデータ格納
-    array_tmp.saval[1][20 + i * 2] = l_tmp;
-    array_tmp.saval[1][50 + i * 2] = r_tmp;
-
-    // 各サーボの直立デフォルト角度(degree → float short*100)の格納
-    array_tmp.saval[1][21 + i * 2] = mrd.float2HfShort(a_sv.ixl_trim[i]);
-    array_tmp.saval[1][51 + i * 2] = mrd.float2HfShort(a_sv.ixr_trim[i]);
+  // センサのキャリブレーション値と動作プロファイルはconfig.hの設定ではないため, EEPROMの現在の内容を保持する
+  const int keep_pages[] = {EEPROM_BNO055_PAGE, EEPROM_PROFILE_PAGE};
+  for (int page : keep_pages) {
+    const int page_top = page * EEPROM_PAGE_LEN * 2;
+    for (int i = 0; i < EEPROM_PAGE_LEN * 2; i++) {
+      array_tmp.bval[page_top + i] = EEPROM.read(page_top + i);
+    }
+  }
+
+  for (int line = 0; line < MRD_SV_EEPROM_LINES; line++) {
+    const int orig_tmp = MRD_SV_ORIGIDX[line];
+    for (int i = 0; i < MRD_SERVO_SLOTS; i++) {
+      // 各サーボのマウント有無と方向(正転・逆転)
+      uint16_t val_tmp = 0;
+
+      // bit0 : マウント
+      if (a_sv.mount[line] & (1UL << i))
+        val_tmp |= 0x0001;
+
+      // bit1-7 : サーボ ID
+      val_tmp |= static_cast<uint16_t>(a_sv.id[line][i] & 0x7F) << 1;
+
+      // bit8 : サーボ回転方向
+      if (a_sv.cw[line][i] > 0)
+        val_tmp |= 0x0100;
+
+      // サーボのマウント有無, ID, 回転方向のデータ格納
+      array_tmp.saval[1][orig_tmp + i * 2] = val_tmp;
+
+      // 各サーボの直立デフォルト角度(degree → float short*100)の格納
+      array_tmp.saval[1][orig_tmp + 1 + i * 2] = mrd.float2HfShort(a_sv.trim[line][i]);
+    }
   }
   return array_tmp;
 }
@@ -89,44 +103,47 @@ UnionEEPROM mrd_eeprom_read() {
 /// @param a_monitor シリアルモニタへのデータ表示.
 /// @param a_serial 出力先シリアルの指定.
 /// @return 終了時にtrueを返す.
-bool mrd_eeprom_load_servosettings(ServoParam &a_sv, bool a_monitor, HardwareSerial &a_serial) {
+bool mrd_eeprom_load_servosettings(ServoParam &a_sv, bool a_monitor, Stream &a_serial) {
   a_serial.println("Load and set servo settings from EEPROM.");
   UnionEEPROM array_tmp = mrd_eeprom_read();
   for (int i = 0; i < a_sv.num_max; i++) {
-    // 各サーボのマウント有無
-    a_sv.ixl_mount[i] = static_cast<bool>(array_tmp.saval[1][20 + i * 2] & 0x0001); // bit0:マウント有無
-    a_sv.ixr_mount[i] = static_cast<bool>(array_tmp.saval[1][50 + i * 2] & 0x0001); // bit0:マウント有無
-    // 各サーボの実サーボ呼び出しID番号
-    a_sv.ixl_id[i] = static_cast<uint8_t>(array_tmp.saval[1][20 + i * 2] >> 1 & 0x007F); // bit1–7:サーボID
-    a_sv.ixr_id[i] = static_cast<uint8_t>(array_tmp.saval[1][50 + i * 2] >> 1 & 0x007F); // bit1–7:サーボID
-    // 各サーボの回転方向(正転・逆転)
-    a_sv.ixl_cw[i] = static_cast<int8_t>((array_tmp.saval[1][20 + i * 2] >> 8) & 0x0001) ? 1 : -1; // bit8:回転方向
-    a_sv.ixr_cw[i] = static_cast<int8_t>((array_tmp.saval[1][50 + i * 2] >> 8) & 0x0001) ? 1 : -1; // bit8:回転方向
-    // 各サーボの直立デフォルト角度,トリム値(degree小数2桁までを100倍した値で格納されているものを展開)
-    a_sv.ixl_trim[i] = array_tmp.saval[1][21 + i * 2] / 100.0f;
-    a_sv.ixr_trim[i] = array_tmp.saval[1][51 + i * 2] / 100.0f;
+    for (int line = 0; line < MRD_SV_EEPROM_LINES; line++) {
+      const uint16_t val_tmp = array_tmp.saval[1][MRD_SV_ORIGIDX[line] + i * 2];
+      // 各サーボのマウント有無
+      if (val_tmp & 0x0001) { // bit0:マウント有無
+        a_sv.mount[line] |= (1UL << i);
+      } else {
+        a_sv.mount[line] &= ~(1UL << i);
+      }
+      // 各サーボの実サーボ呼び出しID番号
+      a_sv.id[line][i] = static_cast<uint8_t>(val_tmp >> 1 & 0x007F); // bit1–7:サーボID
+      // 各サーボの回転方向(正転・逆転)
+      a_sv.cw[line][i] = ((val_tmp >> 8) & 0x0001) ? 1 : -1; // bit8:回転方向
+      // 各サーボの直立デフォルト角度,トリム値(degree小数2桁までを100倍した値で格納されているものを展開)
+      a_sv.trim[line][i] = array_tmp.saval[1][MRD_SV_ORIGIDX[line] + 1 + i * 2] / 100.0f;
+    }
 
     if (a_monitor) {
       a_serial.print("L-idx:");
       a_serial.print(mrd_pddstr(i, 2, 0, false));
       a_serial.print(", id:");
-      a_serial.print(mrd_pddstr(sv.ixl_id[i], 2, 0, false));
+      a_serial.print(mrd_pddstr(a_sv.id[L][i], 2, 0, false));
       a_serial.print(", mt:");
-      a_serial.print(mrd_pddstr(sv.ixl_mount[i], 1, 0, false));
+      a_serial.print(mrd_pddstr((a_sv.mount[L] >> i) & 1, 1, 0, false));
       a_serial.print(", cw:");
-      a_serial.print(mrd_pddstr(sv.ixl_cw[i], 1, 0, true));
+      a_serial.print(mrd_pddstr(a_sv.cw[L][i], 1, 0, true));
       a_serial.print(", trm:");
-      a_serial.print(mrd_pddstr(sv.ixl_trim[i], 7, 2, true));
+      a_serial.print(mrd_pddstr(a_sv.trim[L][i], 7, 2, true));
       a_serial.print("  R-idx: ");
       a_serial.print(mrd_pddstr(i, 2, 0, false));
       a_serial.print(", id:");
-      a_serial.print(mrd_pddstr(sv.ixr_id[i], 2, 0, false));
+      a_serial.print(mrd_pddstr(a_sv.id[R][i], 2, 0, false));
       a_serial.print(", mt:");
-      a_serial.print(mrd_pddstr(sv.ixr_mount[i], 1, 0, false));
+      a_serial.print(mrd_pddstr((a_sv.mount[R] >> i) & 1, 1, 0, false));
       a_serial.print(", cw:");
-      a_serial.print(mrd_pddstr(sv.ixr_cw[i], 1, 0, true));
+      a_serial.print(mrd_pddstr(a_sv.cw[R][i], 1, 0, true));
       a_serial.print(", trm:");
-      a_serial.println(mrd_pddstr(sv.ixr_trim[i], 7, 2, true));
+      a_serial.println(mrd_pddstr(a_sv.trim[R][i], 7, 2, true));
     }
   }
   return true;
@@ -136,7 +153,7 @@ bool mrd_eeprom_load_servosettings(ServoParam &a_sv, bool a_monitor, HardwareSer
 /// @param a_data EEPROM用の配列データ.
 /// @param a_bhd ダンプリストの表示形式.(0:Bin, 1:Hex, 2:Dec)
 /// @return 終了時にtrueを返す.
-bool mrd_eeprom_dump_to_serial(UnionEEPROM a_data, int a_bhd, HardwareSerial &a_serial) {
+bool mrd_eeprom_dump_to_serial(UnionEEPROM a_data, int a_bhd, Stream &a_serial) {
   int len_tmp = EEPROM.length(); // EEPROMの長さ
   a_serial.print("EEPROM Length ");
   a_serial.print(len_tmp); // EEPROMの長さ表示
@@ -163,7 +180,7 @@ bool mrd_eeprom_dump_to_serial(UnionEEPROM a_data, int a_bhd, HardwareSerial &a_
 // /// @param a_do_dump 実施するか否か.
 // /// @param a_bhd ダンプリストの表示形式.(0:Bin, 1:Hex, 2:Dec)
 // /// @return 終了時にtrueを返す.
-// bool mrd_eeprom_show_at_boot(bool a_do_dump, int a_bhd, HardwareSerial &a_serial) {
+// bool mrd_eeprom_show_at_boot(bool a_do_dump, int a_bhd, Stream &a_serial) {
 //   if (a_do_dump) {
 //     mrd_eeprom_dump_to_serial(mrd_eeprom_read(), a_bhd, a_serial);
 //     return true;
@@ -175,7 +192,7 @@ bool mrd_eeprom_dump_to_serial(UnionEEPROM a_data, int a_bhd, HardwareSerial &a_
 /// @param a_do_dump 実施するか否か.
 /// @param a_bhd ダンプリストの表示形式.(0:Bin, 1:Hex, 2:Dec)
 /// @return 終了時にtrueを返す.
-bool mrd_eeprom_dump_at_boot(bool a_do_dump, int a_bhd, HardwareSerial &a_serial) {
+bool mrd_eeprom_dump_at_boot(bool a_do_dump, int a_bhd, Stream &a_serial) {
   if (a_do_dump) {
     mrd_eeprom_dump_to_serial(mrd_eeprom_read(), a_bhd, a_serial);
     return true;
@@ -187,13 +204,13 @@ bool mrd_eeprom_dump_at_boot(bool a_do_dump, int a_bhd, HardwareSerial &a_serial
 /// @param a_write_data EEPROM書き込み用の配列データ.
 /// @param a_flg_protect EEPROMの書き込み許可があるかどうかのブール値.
 /// @return EEPROMの書き込みと読み込みが成功した場合はtrueを, 書き込まなかった場合はfalseを返す.
-bool mrd_eeprom_write(UnionEEPROM a_write_data, bool a_flg_protect, HardwareSerial &a_serial) {
+bool mrd_eeprom_write(UnionEEPROM a_write_data, bool a_flg_protect, Stream &a_serial) {
   if (a_flg_protect) { // EEPROM書き込み実施フラグをチェック
     return false;
   }
   if (flg.eeprom_protect) // config.hのEEPROM書き込みプロテクトをチェック
   {
-    Serial.println("EEPROM is protected. To unprotect, please set 'EEPROM_PROTECT' to false.");
+    serial_pc.println("EEPROM is protected. To unprotect, please set 'EEPROM_PROTECT' to false.");
     return false;
   }
 
@@ -204,7 +221,7 @@ bool mrd_eeprom_write(UnionEEPROM a_write_data, bool a_flg_protect, HardwareSeri
   {
     if (i >= EEPROM.length()) // EEPROMのサイズを超えないようチェック
     {
-      Serial.println("Error: EEPROM address out of range.");
+      serial_pc.println("Error: EEPROM address out of range.");
       return false;
     }
     old_value_tmp = EEPROM.read(i);
@@ -243,10 +260,10 @@ bool mrd_eeprom_write(UnionEEPROM a_write_data, bool a_flg_protect, HardwareSeri
   if (flg_renew_tmp) // 変更箇所があれば書き込みを実施
   {
     EEPROM.commit(); // 書き込みを確定する
-    Serial.println("Value updated.");
+    serial_pc.println("Value updated.");
     return true;
   } else {
-    Serial.println("Value not changed.(same value)");
+    serial_pc.println("Value not changed.(same value)");
   }
   return false;
 }
@@ -264,25 +281,52 @@ bool mrd_eeprom_write_read_check(UnionEEPROM a_write_data, bool a_do, bool a_pro
   }
 
   // EEPROM書き込みを実行
-  Serial.println("Try to write EEPROM: ");
-  mrd_eeprom_dump_to_serial(a_write_data, a_bhd, Serial); // 書き込み内容をダンプ表示
+  serial_pc.println("Try to write EEPROM: ");
+  mrd_eeprom_dump_to_serial(a_write_data, a_bhd, serial_pc); // 書き込み内容をダンプ表示
 
-  if (mrd_eeprom_write(a_write_data, a_protect, Serial)) {
-    Serial.println("...Write OK.");
+  if (mrd_eeprom_write(a_write_data, a_protect, serial_pc)) {
+    serial_pc.println("...Write OK.");
   } else {
-    Serial.println("...Write failed.");
+    serial_pc.println("...Write failed.");
     return false;
   }
 
   // EEPROM読み込みを実行
-  Serial.println("Read EEPROM: ");
+  serial_pc.println("Read EEPROM: ");
   UnionEEPROM read_data_tmp = mrd_eeprom_read();
-  mrd_eeprom_dump_to_serial(read_data_tmp, a_bhd, Serial); // 読み込み内容をダンプ表示
-  Serial.println("...Read completed.");
+  mrd_eeprom_dump_to_serial(read_data_tmp, a_bhd, serial_pc); // 読み込み内容をダンプ表示
+  serial_pc.println("...Read completed.");
 
   return true;
 }
 
+/// @brief EEPROMに保存したBNO055のキャリブレーション値を読み込む.
+/// @param a_offsets 格納先. BNO055_OFFSETS_LENバイト.
+/// @return 保存済みの値があればtrue, 未保存ならfalseを返す.
+bool mrd_eeprom_load_bno055_offsets(uint8_t *a_offsets) {
+  UnionEEPROM array_tmp = mrd_eeprom_read();
+  if (array_tmp.usaval[EEPROM_BNO055_PAGE][0] != EEPROM_BNO055_MAGIC) {
+    return false;
+  }
+  memcpy(a_offsets, &array_tmp.usaval[EEPROM_BNO055_PAGE][1], BNO055_OFFSETS_LEN);
+  return true;
+}
+
+/// @brief BNO055のキャリブレーション値をEEPROMに書き込む. 他のページの内容は保持する.
+/// @param a_offsets キャリブレーション値. BNO055_OFFSETS_LENバイト.
+/// @param a_serial 出力先シリアルの指定.
+/// @return 書き込んだ場合, または同じ値が保存済みの場合はtrueを返す.
+bool mrd_eeprom_save_bno055_offsets(const uint8_t *a_offsets, Stream &a_serial) {
+  UnionEEPROM array_tmp = mrd_eeprom_read();
+  if (array_tmp.usaval[EEPROM_BNO055_PAGE][0] == EEPROM_BNO055_MAGIC &&
+      memcmp(&array_tmp.usaval[EEPROM_BNO055_PAGE][1], a_offsets, BNO055_OFFSETS_LEN) == 0) {
+    return true;
+  }
+  array_tmp.usaval[EEPROM_BNO055_PAGE][0] = EEPROM_BNO055_MAGIC;
+  memcpy(&array_tmp.usaval[EEPROM_BNO055_PAGE][1], a_offsets, BNO055_OFFSETS_LEN);
+  return mrd_eeprom_write(array_tmp, EEPROM_PROTECT, a_serial);
+}
+
 //------------------------------------------------------------------------------------
 //  各種オペレーション
 //------------------------------------------------------------------------------------
@@ -92,7 +92,7 @@ bool parseMacAddress(const char *macStr, byte *macBytes) {
 /// @param subnet サブネットマスク
 /// @param a_serial エラー出力用シリアル
 /// @return 妥当性チェック結果 (true: OK, false: NG)
-bool mrd_validate_network_config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, HardwareSerial &a_serial) {
+bool mrd_validate_network_config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, Stream &a_serial) {
   // ゼロIPアドレスチェック
   if (local_ip == IPAddress(0, 0, 0, 0)) {
     a_serial.println("ERROR: Local IP is invalid (0.0.0.0)");
@@ -144,7 +144,7 @@ bool mrd_validate_network_config(IPAddress local_ip, IPAddress gateway, IPAddres
 /// @param ip_str IPアドレス文字列 (例: "192.168.1.1")
 /// @param a_serial エラー出力用シリアル
 /// @return 成功時はIPAddressオブジェクト、失敗時は IPAddress(0,0,0,0)
-IPAddress mrd_parse_ip_address(const char *ip_str, HardwareSerial &a_serial) {
+IPAddress mrd_parse_ip_address(const char *ip_str, Stream &a_serial) {
   uint8_t octets[4] = {0, 0, 0, 0};
   int octet_index = 0;
   int current_number = 0;
@@ -219,7 +219,7 @@ IPAddress mrd_parse_ip_address(const char *ip_str, HardwareSerial &a_serial) {
 /// @param a_cs_pin W5500のCSピン番号
 /// @param a_serial 出力先シリアルの指定.
 /// @return 初期化に成功した場合はtrueを, 失敗した場合はfalseを返す.
-bool mrd_ether_init(EthernetUDP &a_udp, int a_cs_pin, byte *mac_address, HardwareSerial &a_serial) {
+bool mrd_ether_init(EthernetUDP &a_udp, int a_cs_pin, byte *mac_address, Stream &a_serial) {
   // MACアドレス表示
   a_serial.print("Wierd LAN MAC Address: ");
   for (int i = 0; i < 6; i++) {
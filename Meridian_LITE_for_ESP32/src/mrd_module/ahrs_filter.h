@@ -0,0 +1,224 @@
+#ifndef __MERIDIAN_AHRS_FILTER_H__
+#define __MERIDIAN_AHRS_FILTER_H__
+
+#include "config.h"
+#include "mrd_sync.h"
+#include <math.h>
+#include <stdint.h>
+
+//==================================================================================================
+//  AHRSの16チャンネルのフィルタバンク  ---------------------------------------------------------
+//==================================================================================================
+// ahrs_sample.readと同じ並びの16チャンネルに, チャンネルごとに設定したフィルタをかける.
+// 処理は 3点メディアン(スパイク除去, 任意) → 移動平均 または 2次ローパス(双2次) の順.
+// 移動平均は累積和の差分で求め, 窓の長さ(最大IMUAHRS_STOCK)によらず1サンプルあたりO(1)で済む.
+// 累積和の丸め誤差は履歴が一巡するたびに合計し直して消す.
+// 状態はチャンネルを最内の添字とする連続配列で持ち, 各段で16チャンネルをまとめて処理する.
+// 設定はloop()側で変更し, ahrs_filter_cfgでセンサ用スレッドへ受け渡す.
+// 角度(ロール, ピッチ, ヨー)の±180度の折り返しは考慮しない.
+
+#define AHRS_FILTER_CH 16 // チャンネル数
+// センサ用スレッドのサンプリング周波数(Hz)
+#define AHRS_FILTER_RATE_HZ \
+  ((MOUNT_IMUAHRS == MPU6050_IMU && MPU6050_RAW_FUSION) ? 1000000.0f / MPU6050_RAW_PERIOD : 1000.0f / IMUAHRS_INTERVAL)
+
+// フィルタの種類
+enum AhrsFilterMode
+{
+  AHRS_FILT_NONE = 0, // なし
+  AHRS_FILT_AVE = 1,  // 移動平均
+  AHRS_FILT_LPF = 2   // 2次ローパス(バターワース)
+};
+
+// チャンネルごとの設定
+struct AhrsFilterConfig
+{
+  uint8_t mode[AHRS_FILTER_CH] = {0};   // AhrsFilterMode
+  uint8_t median[AHRS_FILTER_CH] = {0}; // 3点メディアンでスパイクを除去するか
+  uint8_t window[AHRS_FILTER_CH] = {0}; // 移動平均の窓の長さ(1~IMUAHRS_STOCK)
+  float b0[AHRS_FILTER_CH] = {0};       // ローパスの係数(a0で正規化済み)
+  float b1[AHRS_FILTER_CH] = {0};
+  float b2[AHRS_FILTER_CH] = {0};
+  float a1[AHRS_FILTER_CH] = {0};
+  float a2[AHRS_FILTER_CH] = {0};
+};
+
+// フィルタの状態(センサ用スレッドのみが使う)
+struct AhrsFilterBank
+{
+  AhrsFilterConfig cfg;                           // 適用中の設定
+  float hist[IMUAHRS_STOCK][AHRS_FILTER_CH] = {}; // 移動平均用の入力の履歴(リング)
+  float sum[AHRS_FILTER_CH] = {0};                // 移動平均の窓内の合計
+  float med1[AHRS_FILTER_CH] = {0};               // メディアン用の1つ前の入力
+  float med2[AHRS_FILTER_CH] = {0};               // メディアン用の2つ前の入力
+  float z1[AHRS_FILTER_CH] = {0};                 // ローパスの状態(転置直接形II)
+  float z2[AHRS_FILTER_CH] = {0};
+  int pos = 0;                                    // 履歴の次の書込位置
+  bool primed = false;                            // 最初の入力で状態を初期化済みか
+};
+AhrsFilterBank ahrs_filter;                        // センサ用スレッドが持つフィルタ
+AhrsFilterConfig ahrs_filter_edit;                 // loop()側で編集する設定
+MrdTripleBuffer<AhrsFilterConfig> ahrs_filter_cfg; // loop()からセンサ用スレッドへの設定の受け渡し
+
+/// @brief 移動平均を設定する.
+/// @param a_cfg 設定.
+/// @param a_ch チャンネル(0~15).
+/// @param a_window 窓の長さ(1~IMUAHRS_STOCK).
+/// @return 設定できた場合はtrue.
+bool mrd_ahrs_filter_set_ave(AhrsFilterConfig &a_cfg, int a_ch, int a_window)
+{
+  if (a_ch < 0 || a_ch >= AHRS_FILTER_CH || a_window < 1 || a_window > IMUAHRS_STOCK)
+  {
+    return false;
+  }
+  a_cfg.mode[a_ch] = AHRS_FILT_AVE;
+  a_cfg.window[a_ch] = a_window;
+  return true;
+}
+
+/// @brief 2次ローパス(Q=1/√2)を設定する.
+/// @param a_cfg 設定.
+/// @param a_ch チャンネル(0~15).
+/// @param a_cutoff_hz カットオフ周波数(Hz). サンプリング周波数の1/2未満.
+/// @param a_rate_hz サンプリング周波数(Hz).
+/// @return 設定できた場合はtrue.
+bool mrd_ahrs_filter_set_lpf(AhrsFilterConfig &a_cfg, int a_ch, float a_cutoff_hz, float a_rate_hz)
+{
+  if (a_ch < 0 || a_ch >= AHRS_FILTER_CH || a_cutoff_hz <= 0.0f || a_cutoff_hz >= a_rate_hz * 0.5f)
+  {
+    return false;
+  }
+  const float w0 = 2.0f * float(M_PI) * a_cutoff_hz / a_rate_hz;
+  const float cos_w0 = cosf(w0);
+  const float alpha = sinf(w0) / (2.0f * 0.70710678f);
+  const float a0 = 1.0f + alpha;
+  a_cfg.mode[a_ch] = AHRS_FILT_LPF;
+  a_cfg.b0[a_ch] = (1.0f - cos_w0) * 0.5f / a0;
+  a_cfg.b1[a_ch] = (1.0f - cos_w0) / a0;
+  a_cfg.b2[a_ch] = a_cfg.b0[a_ch];
+  a_cfg.a1[a_ch] = -2.0f * cos_w0 / a0;
+  a_cfg.a2[a_ch] = (1.0f - alpha) / a0;
+  return true;
+}
+
+/// @brief フィルタを外す(メディアンの設定は残す).
+void mrd_ahrs_filter_set_none(AhrsFilterConfig &a_cfg, int a_ch)
+{
+  if (a_ch >= 0 && a_ch < AHRS_FILTER_CH)
+  {
+    a_cfg.mode[a_ch] = AHRS_FILT_NONE;
+  }
+}
+
+/// @brief 3点メディアンによるスパイク除去の有無を設定する.
+void mrd_ahrs_filter_set_median(AhrsFilterConfig &a_cfg, int a_ch, bool a_on)
+{
+  if (a_ch >= 0 && a_ch < AHRS_FILTER_CH)
+  {
+    a_cfg.median[a_ch] = a_on;
+  }
+}
+
+/// @brief 全チャンネルの状態を入力値で埋め, 定常状態から始める.
+void mrd_ahrs_filter_prime(AhrsFilterBank &a_bank, const float a_val[AHRS_FILTER_CH])
+{
+  const AhrsFilterConfig &cfg = a_bank.cfg;
+  for (int k = 0; k < IMUAHRS_STOCK; k++)
+  {
+    for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+    {
+      a_bank.hist[k][ch] = a_val[ch];
+    }
+  }
+  for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+  {
+    const float x = a_val[ch];
+    a_bank.sum[ch] = x * cfg.window[ch];
+    a_bank.med1[ch] = x;
+    a_bank.med2[ch] = x;
+    a_bank.z2[ch] = (cfg.b2[ch] - cfg.a2[ch]) * x;
+    a_bank.z1[ch] = (cfg.b1[ch] - cfg.a1[ch]) * x + a_bank.z2[ch];
+  }
+  a_bank.pos = 0;
+  a_bank.primed = true;
+}
+
+/// @brief 1サンプル分の16チャンネルにフィルタをかける. センサ用スレッドから毎サンプル呼ぶ.
+/// loop()側から新しい設定が届いていれば適用し, 状態を今回の入力で初期化し直す.
+/// @param a_bank フィルタの状態.
+/// @param a_val 入力. 出力で上書きする.
+void mrd_ahrs_filter_run(AhrsFilterBank &a_bank, float a_val[AHRS_FILTER_CH])
+{
+  if (ahrs_filter_cfg.update())
+  {
+    a_bank.cfg = ahrs_filter_cfg.front();
+    a_bank.primed = false;
+  }
+  if (!a_bank.primed)
+  {
+    mrd_ahrs_filter_prime(a_bank, a_val);
+  }
+  const AhrsFilterConfig &cfg = a_bank.cfg;
+
+  // 3点メディアン
+  for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+  {
+    const float x = a_val[ch];
+    const float m1 = a_bank.med1[ch];
+    const float m2 = a_bank.med2[ch];
+    a_bank.med2[ch] = m1;
+    a_bank.med1[ch] = x;
+    if (cfg.median[ch])
+    {
+      a_val[ch] = fmaxf(fminf(x, m1), fminf(fmaxf(x, m1), m2));
+    }
+  }
+
+  // 移動平均. 窓から外れる入力を書き込む前に読む
+  float *row = a_bank.hist[a_bank.pos];
+  for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+  {
+    const float x = a_val[ch];
+    const int win = cfg.window[ch];
+    const float old = a_bank.hist[(a_bank.pos + IMUAHRS_STOCK - win) % IMUAHRS_STOCK][ch];
+    row[ch] = x;
+    if (cfg.mode[ch] == AHRS_FILT_AVE)
+    {
+      a_bank.sum[ch] += x - old;
+      a_val[ch] = a_bank.sum[ch] / win;
+    }
+  }
+  if (++a_bank.pos >= IMUAHRS_STOCK)
+  { // 一巡ごとに合計し直して丸め誤差を消す
+    a_bank.pos = 0;
+    for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+    {
+      if (cfg.mode[ch] != AHRS_FILT_AVE)
+      {
+        continue;
+      }
+      float sum_tmp = 0.0f;
+      for (int k = IMUAHRS_STOCK - cfg.window[ch]; k < IMUAHRS_STOCK; k++)
+      {
+        sum_tmp += a_bank.hist[k][ch];
+      }
+      a_bank.sum[ch] = sum_tmp;
+    }
+  }
+
+  // 2次ローパス
+  for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+  {
+    if (cfg.mode[ch] != AHRS_FILT_LPF)
+    {
+      continue;
+    }
+    const float x = a_val[ch];
+    const float y = cfg.b0[ch] * x + a_bank.z1[ch];
+    a_bank.z1[ch] = cfg.b1[ch] * x - cfg.a1[ch] * y + a_bank.z2[ch];
+    a_bank.z2[ch] = cfg.b2[ch] * x - cfg.a2[ch] * y;
+    a_val[ch] = y;
+  }
+}
+
+#endif // __MERIDIAN_AHRS_FILTER_H__
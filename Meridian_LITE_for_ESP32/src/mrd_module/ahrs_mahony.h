@@ -0,0 +1,107 @@
+#ifndef __MERIDIAN_AHRS_MAHONY_H__
+#define __MERIDIAN_AHRS_MAHONY_H__
+
+#include "config.h"
+#include <math.h>
+
+//==================================================================================================
+//  ボード上の姿勢推定(Mahonyフィルタ)  --------------------------------------------------------
+//==================================================================================================
+// ジャイロの角速度を積分した姿勢を, 加速度から求めた重力方向との誤差のPI制御で補正する.
+// 地磁気を使わないため, ヨーはジャイロの積分のみで長時間ではドリフトする.
+// ESP32は単精度の浮動小数点演算器を持つため, 全てfloatで計算する.
+// Arduinoに依存しないため, PC上で記録したIMUログの再生にもそのまま使える.
+
+// 姿勢推定の状態
+struct MahonyFilter
+{
+  float q[4] = {1.0f, 0.0f, 0.0f, 0.0f}; // 姿勢のクオータニオン w,x,y,z
+  float integral[3] = {0.0f};            // 誤差の積分項(rad/s)
+};
+
+/// @brief 1サンプル分の角速度と加速度で姿勢を更新する.
+/// @param a_f 姿勢推定の状態.
+/// @param a_gx,a_gy,a_gz 角速度(rad/s).
+/// @param a_ax,a_ay,a_az 加速度(単位は任意. 向きのみ使う). 全て0の場合は補正しない.
+/// @param a_dt 前回のサンプルからの経過時間(s).
+void mrd_mahony_update(MahonyFilter &a_f, float a_gx, float a_gy, float a_gz, float a_ax, float a_ay, float a_az,
+                       float a_dt)
+{
+  float *q = a_f.q;
+  const float norm_sq = a_ax * a_ax + a_ay * a_ay + a_az * a_az;
+  if (norm_sq > 0.0f)
+  {
+    const float recip = 1.0f / sqrtf(norm_sq);
+    a_ax *= recip;
+    a_ay *= recip;
+    a_az *= recip;
+
+    // 推定姿勢での重力方向(の1/2)
+    const float half_vx = q[1] * q[3] - q[0] * q[2];
+    const float half_vy = q[0] * q[1] + q[2] * q[3];
+    const float half_vz = q[0] * q[0] - 0.5f + q[3] * q[3];
+
+    // 計測した重力方向との誤差(外積)
+    const float half_ex = a_ay * half_vz - a_az * half_vy;
+    const float half_ey = a_az * half_vx - a_ax * half_vz;
+    const float half_ez = a_ax * half_vy - a_ay * half_vx;
+
+    if (MAHONY_KI > 0.0f)
+    {
+      a_f.integral[0] += 2.0f * MAHONY_KI * half_ex * a_dt;
+      a_f.integral[1] += 2.0f * MAHONY_KI * half_ey * a_dt;
+      a_f.integral[2] += 2.0f * MAHONY_KI * half_ez * a_dt;
+      a_gx += a_f.integral[0];
+      a_gy += a_f.integral[1];
+      a_gz += a_f.integral[2];
+    }
+    a_gx += 2.0f * MAHONY_KP * half_ex;
+    a_gy += 2.0f * MAHONY_KP * half_ey;
+    a_gz += 2.0f * MAHONY_KP * half_ez;
+  }
+
+  // クオータニオンの微分方程式を1ステップ積分する
+  a_gx *= 0.5f * a_dt;
+  a_gy *= 0.5f * a_dt;
+  a_gz *= 0.5f * a_dt;
+  const float qa = q[0];
+  const float qb = q[1];
+  const float qc = q[2];
+  q[0] += -qb * a_gx - qc * a_gy - q[3] * a_gz;
+  q[1] += qa * a_gx + qc * a_gz - q[3] * a_gy;
+  q[2] += qa * a_gy - qb * a_gz + q[3] * a_gx;
+  q[3] += qa * a_gz + qb * a_gy - qc * a_gx;
+
+  const float recip = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+  for (int i = 0; i < 4; i++)
+  {
+    q[i] *= recip;
+  }
+}
+
+/// @brief 姿勢をロール, ピッチ, ヨー(degree)に変換する.
+/// @param a_f 姿勢推定の状態.
+/// @param a_rpy 格納先. roll, pitch, yawの順.
+void mrd_mahony_euler(const MahonyFilter &a_f, float a_rpy[3])
+{
+  const float *q = a_f.q;
+  const float rad2deg = 180.0f / float(M_PI);
+  float sinp = 2.0f * (q[0] * q[2] - q[3] * q[1]);
+  sinp = (sinp > 1.0f) ? 1.0f : ((sinp < -1.0f) ? -1.0f : sinp);
+  a_rpy[0] = atan2f(2.0f * (q[0] * q[1] + q[2] * q[3]), 1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2])) * rad2deg;
+  a_rpy[1] = asinf(sinp) * rad2deg;
+  a_rpy[2] = atan2f(2.0f * (q[0] * q[3] + q[1] * q[2]), 1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3])) * rad2deg;
+}
+
+/// @brief 姿勢からセンサ座標での重力方向の単位ベクトルを求める.
+/// @param a_f 姿勢推定の状態.
+/// @param a_g 格納先. x, y, zの順.
+void mrd_mahony_gravity(const MahonyFilter &a_f, float a_g[3])
+{
+  const float *q = a_f.q;
+  a_g[0] = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+  a_g[1] = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+  a_g[2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+}
+
+#endif // __MERIDIAN_AHRS_MAHONY_H__
@@ -0,0 +1,205 @@
+#ifndef __MERIDIAN_I2C_BUS_H__
+#define __MERIDIAN_I2C_BUS_H__
+
+#include "config.h"
+#include "main.h"
+#include <Wire.h>
+
+//==================================================================================================
+//  I2Cバスの管理スレッド  -----------------------------------------------------------------------
+//==================================================================================================
+// Wire(I2C0)を管理スレッドだけが使い, 各デバイスの処理は通信(トランザクション)を依頼して結果を待つ.
+// 依頼は優先度ごとのキューに入り, 管理スレッドは優先度の高いキューから順に間を空けずに実行する.
+// 期限を過ぎた依頼は実行せずにI2C_XFER_EXPIREDで返すため, 遅れた低優先度の通信が後の通信を待たせない.
+// 管理スレッドの開始後は, Wireを直接使うライブラリ関数(Adafruit_BNO055::getVector等)を呼ばないこと.
+
+#define I2C_BUS_PRIOS 3  // 優先度の段数
+#define I2C_XFER_WMAX 32 // 1回の通信で書き込める最大バイト数
+#define I2C_BUS_QUEUE 8  // 優先度ごとのキューの長さ
+
+// 通信の優先度
+enum I2cXferPrio
+{
+  I2C_PRIO_HIGH = 0,   // センサの周期読込など
+  I2C_PRIO_NORMAL = 1, // サーボ拡張やリモコンなど
+  I2C_PRIO_LOW = 2     // 設定の読み書きなど
+};
+
+// 通信の結果
+enum I2cXferStatus
+{
+  I2C_XFER_PENDING = 0,  // 実行待ち
+  I2C_XFER_OK = 1,       // 成功
+  I2C_XFER_NACK = -1,    // アドレスまたはデータにNACK, バスエラー
+  I2C_XFER_SHORT = -2,   // 読込のバイト数が足りない
+  I2C_XFER_EXPIRED = -3, // 期限切れで実行しなかった
+  I2C_XFER_FULL = -4     // キューが満杯で受け付けなかった
+};
+
+// 通信の依頼. 完了まで依頼元が保持する
+struct I2cXfer
+{
+  uint8_t addr = 0;                     // 7bitアドレス
+  uint8_t wlen = 0;                     // 書き込むバイト数(レジスタ番号を含む)
+  uint8_t wbuf[I2C_XFER_WMAX] = {0};    // 書き込むデータ
+  uint8_t rlen = 0;                     // 続けて読み込むバイト数(0なら書込のみ)
+  uint8_t *rbuf = nullptr;              // 読込先
+  uint32_t deadline_us = 0;             // 実行開始の期限(micros())
+  volatile int8_t status = I2C_XFER_OK; // I2cXferStatus
+  SemaphoreHandle_t done = NULL;        // 完了の通知
+};
+
+// 管理スレッドの状態
+struct I2cBus
+{
+  QueueHandle_t queue[I2C_BUS_PRIOS] = {NULL}; // 優先度ごとの依頼(I2cXfer*)のキュー
+  bool active = false;                         // 管理スレッドが動作中か
+  uint32_t cnt_ok = 0;                         // 成功した通信の数
+  uint32_t cnt_err = 0;                        // 失敗した通信の数
+  uint32_t cnt_expired = 0;                    // 期限切れで実行しなかった通信の数
+  uint32_t cnt_full = 0;                       // キューが満杯で受け付けなかった通信の数
+};
+I2cBus i2c_bus;
+
+/// @brief 依頼を初期化する. 完了通知のセマフォを作るため, 依頼ごとに一度だけ呼ぶ.
+void mrd_i2c_xfer_init(I2cXfer &a_xfer)
+{
+  if (a_xfer.done == NULL)
+  {
+    a_xfer.done = xSemaphoreCreateBinary();
+  }
+}
+
+/// @brief 1件の通信をWireで実行する. 管理スレッドからのみ呼ぶ.
+int8_t mrd_i2c_execute(I2cXfer &a_xfer)
+{
+  if (a_xfer.wlen > 0)
+  {
+    Wire.beginTransmission(a_xfer.addr);
+    Wire.write(a_xfer.wbuf, a_xfer.wlen);
+    if (Wire.endTransmission(a_xfer.rlen == 0) != 0) // 読込が続く場合はリピーテッドスタート
+    {
+      return I2C_XFER_NACK;
+    }
+  }
+  if (a_xfer.rlen > 0)
+  {
+    if (Wire.requestFrom(a_xfer.addr, a_xfer.rlen) != a_xfer.rlen)
+    {
+      return I2C_XFER_SHORT;
+    }
+    for (int i = 0; i < a_xfer.rlen; i++)
+    {
+      a_xfer.rbuf[i] = Wire.read();
+    }
+  }
+  return I2C_XFER_OK;
+}
+
+/// @brief I2Cバスの管理スレッド用関数. 依頼の通知で起き, キューが空になるまで優先度順に実行する.
+void mrd_i2c_Core0_bus_r(void *args)
+{
+  while (1)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    I2cXfer *xfer = nullptr;
+    int prio = 0;
+    while (prio < I2C_BUS_PRIOS)
+    {
+      if (xQueueReceive(i2c_bus.queue[prio], &xfer, 0) != pdTRUE)
+      {
+        prio++;
+        continue;
+      }
+      if (int32_t(micros() - xfer->deadline_us) > 0)
+      {
+        xfer->status = I2C_XFER_EXPIRED;
+        i2c_bus.cnt_expired++;
+      }
+      else
+      {
+        xfer->status = mrd_i2c_execute(*xfer);
+        if (xfer->status == I2C_XFER_OK)
+        {
+          i2c_bus.cnt_ok++;
+        }
+        else
+        {
+          i2c_bus.cnt_err++;
+        }
+      }
+      xSemaphoreGive(xfer->done);
+      prio = 0; // 実行中に届いた高優先度の依頼を先に処理する
+    }
+  }
+}
+
+/// @brief I2Cバスの管理スレッドを開始する. Wireの初期化とデバイスの初期設定の後に呼ぶ.
+void mrd_i2c_bus_begin()
+{
+  for (int i = 0; i < I2C_BUS_PRIOS; i++)
+  {
+    i2c_bus.queue[i] = xQueueCreate(I2C_BUS_QUEUE, sizeof(I2cXfer *));
+  }
+  xTaskCreatePinnedToCore(mrd_i2c_Core0_bus_r, "Core0_i2c_bus", 4096, NULL, 3, &thp[1], 0);
+  i2c_bus.active = true;
+  serial_pc.println("Core0 thread for I2C bus start.");
+}
+
+/// @brief 通信を依頼する. 待たずに戻り, statusがI2C_XFER_PENDINGでなくなれば完了している.
+/// 受け付けた依頼は, 再利用する前に必ずmrd_i2c_wait()で完了の通知を受け取ること.
+/// @param a_xfer 依頼. addr, wbuf/wlen, rbuf/rlenを設定しておく.
+/// @param a_prio 優先度(I2cXferPrio).
+/// @param a_timeout_us 実行開始の期限(今からのus).
+/// @return 受け付けた場合はtrue. 満杯の場合はstatusをI2C_XFER_FULLにしてfalse.
+bool mrd_i2c_submit(I2cXfer &a_xfer, int a_prio, uint32_t a_timeout_us)
+{
+  I2cXfer *xfer = &a_xfer;
+  a_xfer.deadline_us = micros() + a_timeout_us;
+  a_xfer.status = I2C_XFER_PENDING;
+  if (xQueueSend(i2c_bus.queue[a_prio], &xfer, 0) != pdTRUE)
+  {
+    a_xfer.status = I2C_XFER_FULL;
+    i2c_bus.cnt_full++;
+    return false;
+  }
+  xTaskNotifyGive(thp[1]);
+  return true;
+}
+
+/// @brief 依頼した通信の完了を待ち, 完了の通知を受け取る.
+/// @return 通信の結果(I2cXferStatus).
+int8_t mrd_i2c_wait(I2cXfer &a_xfer)
+{
+  if (a_xfer.status != I2C_XFER_FULL) // 受け付けなかった依頼には通知がない
+  {
+    xSemaphoreTake(a_xfer.done, portMAX_DELAY);
+  }
+  return a_xfer.status;
+}
+
+/// @brief レジスタ番号を書いてから連続して読み込む通信を依頼し, 完了を待つ.
+/// @param a_xfer 依頼に使う構造体(mrd_i2c_xfer_init済み).
+/// @param a_addr 7bitアドレス.
+/// @param a_reg 先頭のレジスタ番号.
+/// @param a_buf 読込先.
+/// @param a_len 読み込むバイト数.
+/// @param a_prio 優先度(I2cXferPrio).
+/// @param a_timeout_us 実行開始の期限(今からのus).
+/// @return 通信の結果(I2cXferStatus).
+int8_t mrd_i2c_read_reg(I2cXfer &a_xfer, uint8_t a_addr, uint8_t a_reg, uint8_t *a_buf, uint8_t a_len, int a_prio,
+                        uint32_t a_timeout_us)
+{
+  a_xfer.addr = a_addr;
+  a_xfer.wbuf[0] = a_reg;
+  a_xfer.wlen = 1;
+  a_xfer.rbuf = a_buf;
+  a_xfer.rlen = a_len;
+  if (!mrd_i2c_submit(a_xfer, a_prio, a_timeout_us))
+  {
+    return a_xfer.status;
+  }
+  return mrd_i2c_wait(a_xfer);
+}
+
+#endif // __MERIDIAN_I2C_BUS_H__
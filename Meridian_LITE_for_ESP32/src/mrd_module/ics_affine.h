@@ -0,0 +1,81 @@
+#ifndef __MERIDIAN_ICS_AFFINE_H__
+#define __MERIDIAN_ICS_AFFINE_H__
+
+#include <math.h>
+#include <stdint.h>
+
+//==================================================================================================
+//  ICSサーボの角度変換(固定小数点)  -----------------------------------------------------------
+//==================================================================================================
+// Meridianライブラリの Deg2Krs / Krs2Deg と同じ係数を整数演算で扱う.
+// degree*100 → ICSポジション値 : 7500 + trim * 29.6296 + (deg*100) * 0.296296 * cw
+// ICSポジション値 → degree*100 : (pos - 7500 - trim * 29.6296) * 3.375 * cw (3.375 = 27/8)
+// Arduinoに依存しないため, PC上でfloat版との全数比較にもそのまま使える(test/ics_affine).
+
+#define ICS_AFFINE_Q         24      // 固定小数点の小数部ビット数
+#define ICS_POS_PER_DEG      29.6296 // 1度あたりのICSポジション値
+#define ICS_POS_PER_CDEG_Q24 4971022 // 0.01度あたりのICSポジション値(Q24)
+#define ICS_POS_MIN          3500    // ICSポジション値の下限
+#define ICS_POS_MAX          11500   // ICSポジション値の上限
+
+// ICSサーボの角度変換係数(トリム値と回転方向から事前計算する固定小数点のアフィン変換)
+struct IcsAffine
+{
+  int64_t offset = int64_t(7500) << ICS_AFFINE_Q; // 0度におけるICSポジション値(Q24)
+  int8_t cw = 1;                                  // 回転方向(+1 or -1)
+};
+
+/// @brief トリム値と回転方向からICSサーボの変換係数を作成する.
+/// @param a_trim サーボのトリム値(degree).
+/// @param a_cw サーボの回転方向補正値(+1 or -1).
+/// @return 変換係数.
+inline IcsAffine mrd_servo_ics_affine(float a_trim, int a_cw)
+{
+  IcsAffine aff_tmp;
+  aff_tmp.offset = llround((7500.0 + a_trim * ICS_POS_PER_DEG) * double(int64_t(1) << ICS_AFFINE_Q));
+  aff_tmp.cw = (a_cw < 0) ? -1 : 1;
+  return aff_tmp;
+}
+
+/// @brief degree*100の値をICSサーボのポジション値に変換する.
+/// @param a_cdeg 角度(degree*100).
+/// @param a_aff 変換係数.
+/// @return ICSポジション値(3500-11500).
+inline int mrd_servo_cdeg2ics(int16_t a_cdeg, const IcsAffine &a_aff)
+{
+  int64_t pos_q = a_aff.offset + int64_t(a_cdeg) * a_aff.cw * ICS_POS_PER_CDEG_Q24;
+  int pos_tmp = int(pos_q >> ICS_AFFINE_Q);
+  if (pos_tmp > ICS_POS_MAX)
+  {
+    return ICS_POS_MAX;
+  }
+  if (pos_tmp < ICS_POS_MIN)
+  {
+    return ICS_POS_MIN;
+  }
+  return pos_tmp;
+}
+
+/// @brief ICSサーボのポジション値をdegree*100の値に変換する.
+/// @param a_pos ICSポジション値.
+/// @param a_aff 変換係数.
+/// @return 角度(degree*100). 四捨五入し, -32767から32767に丸める.
+inline int16_t mrd_servo_ics2cdeg(int a_pos, const IcsAffine &a_aff)
+{
+  // (pos - offset) * 27/8 を Q24 から戻す. 2^(Q+3)で割る際に0から遠い方へ丸める
+  int64_t num_tmp = ((int64_t(a_pos) << ICS_AFFINE_Q) - a_aff.offset) * 27 * a_aff.cw;
+  const int64_t half_tmp = int64_t(1) << (ICS_AFFINE_Q + 2);
+  int64_t cdeg_tmp = (num_tmp >= 0) ? ((num_tmp + half_tmp) >> (ICS_AFFINE_Q + 3))
+                                    : -((-num_tmp + half_tmp) >> (ICS_AFFINE_Q + 3));
+  if (cdeg_tmp > 32766)
+  {
+    return 32767;
+  }
+  if (cdeg_tmp < -32766)
+  {
+    return -32767;
+  }
+  return int16_t(cdeg_tmp);
+}
+
+#endif // __MERIDIAN_ICS_AFFINE_H__
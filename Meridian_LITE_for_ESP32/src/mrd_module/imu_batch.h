@@ -0,0 +1,94 @@
+#ifndef __MERIDIAN_IMU_BATCH_H__
+#define __MERIDIAN_IMU_BATCH_H__
+
+#include "config.h"
+#include "main.h"
+#include "mrd_sync.h"
+
+//==================================================================================================
+//  IMUの全サンプルの一括送信  ------------------------------------------------------------------
+//==================================================================================================
+// Meridimにはフレームごとに最新の1サンプルしか載らないため, 間のサンプルはPCに届かない.
+// センサ用スレッドは計測の都度, 計測時刻付きの1サンプルをimu_ringに積み, loop()は毎フレーム
+// 前フレーム以降のサンプルを全て取り出して1つのデータグラムに詰め, Meridimとは別のポートに送る.
+//
+// データグラムの形式(リトルエンディアン)
+//   ヘッダ: 識別子IMU_BATCH_MAGIC, サンプル数, 同じフレームのMeridimのMRD_SEQ, 取りこぼしの累計(各16bit)
+//   サンプル: 計測時刻us(32bit), 加速度xyz(0.01m/s^2), ジャイロxyz(1/16dps), クオータニオンwxyz(1/16384)(各16bit)
+
+#define IMU_BATCH_MAGIC 0x4942 // データグラムの先頭の識別子
+
+// 1サンプル(24バイト)
+struct ImuBatchSample
+{
+  uint32_t t_us;   // 計測時刻(micros())
+  int16_t acc[3];  // 加速度 x,y,z (0.01m/s^2)
+  int16_t gyro[3]; // 角速度 x,y,z (1/16dps)
+  int16_t quat[4]; // 姿勢のクオータニオン w,x,y,z (1/16384)
+};
+static_assert(sizeof(ImuBatchSample) == 24, "ImuBatchSample must be packed to 24 bytes");
+
+// 送信するデータグラム
+struct ImuBatchPacket
+{
+  uint16_t magic = IMU_BATCH_MAGIC;          // 識別子
+  uint16_t count = 0;                        // サンプル数
+  uint16_t seq = 0;                          // 同じフレームのMeridimのMRD_SEQ
+  uint16_t dropped = 0;                      // リングが満杯で捨てたサンプルの累計(下位16bit)
+  ImuBatchSample sample[IMU_BATCH_MAX] = {}; // 計測順のサンプル
+};
+
+MrdSpscRing<ImuBatchSample, IMU_RING_LEN> imu_ring; // センサ用スレッドからloop()へのサンプルの受け渡し
+ImuBatchPacket imu_batch;                           // 次のフレームで送るデータグラム
+
+/// @brief 値を固定小数点の16bitに換算する. 範囲外は飽和させる.
+inline int16_t mrd_imu_batch_s16(float a_val, float a_lsb)
+{
+  const float v = a_val * a_lsb;
+  return (v >= 32767.0f) ? 32767 : ((v <= -32768.0f) ? -32768 : int16_t(lrintf(v)));
+}
+
+/// @brief 計測値一式から1サンプルを作ってリングに積む. センサ用スレッドから計測の都度, フィルタの前に呼ぶ.
+/// @param a_sample 計測値一式.
+void mrd_imu_batch_push(const AhrsSample &a_sample)
+{
+  ImuBatchSample s;
+  s.t_us = a_sample.t_us;
+  for (int k = 0; k < 3; k++)
+  {
+    s.acc[k] = mrd_imu_batch_s16(a_sample.read[k], 100.0f);
+    s.gyro[k] = mrd_imu_batch_s16(a_sample.read[3 + k], 16.0f);
+  }
+  for (int k = 0; k < 4; k++)
+  {
+    s.quat[k] = mrd_imu_batch_s16(a_sample.quat[k], 16384.0f);
+  }
+  imu_ring.push(s);
+}
+
+/// @brief リングのサンプルをデータグラムに詰め, サンプル数をMeridimに格納する.
+/// IMU_BATCH_MAXを超えた分はリングに残し, 次のフレームで送る.
+/// @param a_meridim Meridim配列. MRD_SEQを格納した後に呼ぶ.
+/// @param a_packet 詰める先のデータグラム.
+/// @return 詰めたサンプル数.
+int mrd_imu_batch_build(Meridim90Union &a_meridim, ImuBatchPacket &a_packet)
+{
+  int count = 0;
+  while (count < IMU_BATCH_MAX && imu_ring.pop(a_packet.sample[count]))
+  {
+    count++;
+  }
+  a_packet.count = count;
+  a_packet.seq = a_meridim.usval[MRD_SEQ];
+  a_packet.dropped = uint16_t(imu_ring.dropped());
+  a_meridim.usval[MRD_IMU_BATCH] = count;
+  return count;
+}
+
+/// @brief データグラムの送信するバイト数.
+inline int mrd_imu_batch_len(const ImuBatchPacket &a_packet)
+{
+  return offsetof(ImuBatchPacket, sample) + a_packet.count * sizeof(ImuBatchSample);
+}
+
+#endif // __MERIDIAN_IMU_BATCH_H__
@@ -0,0 +1,124 @@
+#ifndef __MERIDIAN_MOVEMENT_KEYFRAME_H__
+#define __MERIDIAN_MOVEMENT_KEYFRAME_H__
+
+#include "config.h"
+#include "main.h"
+
+//==================================================================================================
+//  キーフレーム補間関連の処理  ----------------------------------------------------------------------
+//==================================================================================================
+// PCはサーボ目標値とあわせて[MRD_MOTION_FRAMES]に到達までのフレーム数を送る.
+// ボードは新しいキーフレームを受信するたびに現在位置から目標値までの区間を作り,
+// 毎フレームその区間を補間した値をサーボの目標値とする.
+// キーフレームを取りこぼしても進行中の区間は最後まで補間され, 終点で停止する.
+// フレーム数が0以下のデータは従来通り目標値をそのまま使う.
+
+// キーフレーム補間の状態
+struct KeyframeState
+{
+  float start[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}}; // 区間の始点(degree*100)
+  float goal[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};  // 区間の終点(degree*100)
+  float vel[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};   // 区間開始時の速度(degree*100/frame)
+  float out[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};   // 前回の補間値(degree*100)
+  float step[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};  // 前回の1フレームあたりの変化量
+  int frames = 0;                                        // 区間のフレーム数
+  int count = 0;                                         // 区間内の経過フレーム数
+  bool active = false;                                   // 補間中の区間があるか
+};
+KeyframeState keyframe;
+
+/// @brief 区間の進行度から補間値を求める.
+/// @param a_start 始点.
+/// @param a_goal 終点.
+/// @param a_vel 始点での速度(1フレームあたり).
+/// @param a_frames 区間のフレーム数.
+/// @param a_s 進行度(0.0-1.0).
+/// @return 補間値.
+inline float mrd_mv_keyframe_curve(float a_start, float a_goal, float a_vel, int a_frames, float a_s)
+{
+  const float s2 = a_s * a_s;
+  const float s3 = s2 * a_s;
+#if KEYFRAME_CURVE == 1
+  // 5次エルミート曲線(始点の速度を引き継ぎ, 始点の加速度と終点の速度, 加速度が0). 速度0で始まれば最小躍度曲線
+  const float s4 = s3 * a_s;
+  const float s5 = s4 * a_s;
+  const float h00 = 1.0f - 10.0f * s3 + 15.0f * s4 - 6.0f * s5;
+  const float h10 = a_s - 6.0f * s3 + 8.0f * s4 - 3.0f * s5;
+  const float h01 = 10.0f * s3 - 15.0f * s4 + 6.0f * s5;
+  return h00 * a_start + h10 * a_vel * a_frames + h01 * a_goal;
+#else
+  // 3次エルミート曲線(始点の速度を引き継ぎ, 終点で速度0)
+  const float h00 = 2.0f * s3 - 3.0f * s2 + 1.0f;
+  const float h10 = s3 - 2.0f * s2 + a_s;
+  const float h01 = -2.0f * s3 + 3.0f * s2;
+  return h00 * a_start + h10 * a_vel * a_frames + h01 * a_goal;
+#endif
+}
+
+/// @brief 新しいキーフレームを受け取り, 現在位置から始まる補間区間を作る.
+/// @param a_meridim 受信したMeridim配列.
+/// @param a_sv サーボパラメータの構造体. tgt_pastを区間の始点とする.
+/// @param a_frames 目標値に到達するまでのフレーム数.
+void mrd_mv_keyframe_set(const Meridim90Union &a_meridim, const ServoParam &a_sv, int a_frames)
+{
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
+  {
+    for (int i = 0; i < MRD_SERVO_SLOTS; i++)
+    {
+      // 補間中であれば前回の補間値と速度を引き継ぎ, そうでなければ前回の値から静止状態で始める
+      const float start_tmp = keyframe.active ? keyframe.out[line][i] : float(a_sv.tgt_past[line][i]);
+      keyframe.vel[line][i] = keyframe.active ? keyframe.step[line][i] : 0.0f;
+      keyframe.start[line][i] = start_tmp;
+      keyframe.out[line][i] = start_tmp;
+      keyframe.goal[line][i] = a_meridim.sval[MRD_SV_ORIGIDX[line] + 1 + i * 2];
+    }
+  }
+  keyframe.frames = a_frames;
+  keyframe.count = 0;
+  keyframe.active = true;
+}
+
+/// @brief キーフレーム補間を1フレーム進め, サーボの目標値に書き込む.
+/// @param a_meridim Meridim配列.
+/// @param a_rcvd 今回のフレームで新しいMeridimを受信したか.
+/// @param a_sv サーボパラメータの構造体.
+/// @return 補間した値を書き込んだ場合はtrue, 目標値をそのまま使う場合はfalse.
+bool mrd_mv_keyframe_update(const Meridim90Union &a_meridim, bool a_rcvd, ServoParam &a_sv)
+{
+  if (a_rcvd)
+  {
+    const int frames_tmp = a_meridim.sval[MRD_MOTION_FRAMES];
+    if (frames_tmp > 0)
+    {
+      mrd_mv_keyframe_set(a_meridim, a_sv, frames_tmp);
+    }
+    else
+    {
+      keyframe.active = false; // フレーム数0以下は目標値をそのまま使う
+    }
+  }
+  if (!keyframe.active)
+  {
+    return false;
+  }
+
+  if (keyframe.count < keyframe.frames)
+  {
+    keyframe.count++;
+  }
+  const float s_tmp = float(keyframe.count) / float(keyframe.frames);
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
+  {
+    for (int i = 0; i < MRD_SERVO_SLOTS; i++)
+    {
+      const float out_tmp = mrd_mv_keyframe_curve(keyframe.start[line][i], keyframe.goal[line][i],
+                                                  keyframe.vel[line][i], keyframe.frames, s_tmp);
+      keyframe.step[line][i] = out_tmp - keyframe.out[line][i];
+      keyframe.out[line][i] = out_tmp;
+      a_sv.tgt[line][i] = int16_t(lroundf(out_tmp));
+    }
+  }
+  return true;
+}
+
+#endif // __MERIDIAN_MOVEMENT_KEYFRAME_H__
@@ -0,0 +1,111 @@
+#ifndef __MERIDIAN_MOVEMENT_PROFILER_H__
+#define __MERIDIAN_MOVEMENT_PROFILER_H__
+
+#include "config.h"
+#include "main.h"
+
+//==================================================================================================
+//  動作プロファイル関連の処理  ----------------------------------------------------------------------
+//==================================================================================================
+// 各サーボの目標値に対し, 関節ごとの最大速度・最大加速度・最大躍度を守りながら追従する.
+// 目標までの残り距離から停止可能な速度を求めるため, 重い関節でも目標を行き過ぎない.
+// 単位はすべてdegree*100とフレームで, L系統とR系統の全スロットを連続した配列として一括で処理する.
+//
+// EEPROMの[2][*]はサーボ設定の[1][*]と同じ並びで, 各サーボについて
+//   [系統の最初のインデックス + i*2]     : 最大速度(degree*100/frame)
+//   [系統の最初のインデックス + i*2 + 1] : 下位8bit 最大加速度(degree*100/frame^2), 上位8bit 最大躍度(degree*100/frame^3)
+// を持つ. 値が0の項目はconfig.hの既定値を使う.
+
+#define PROFILE_UNLIMITED 1.0e9f // 制限なしを表す上限値
+#define PROFILE_NUM (MRD_SERVO_LINES * MRD_SERVO_SLOTS)
+
+// 動作プロファイルの状態
+struct ProfileState
+{
+  float pos[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}}; // 出力位置(degree*100)
+  float vel[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}}; // 速度(degree*100/frame)
+  float acc[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}}; // 加速度(degree*100/frame^2)
+};
+ProfileState profile;
+
+/// @brief 設定値を動作プロファイルの上限値に変換する.
+/// @param a_val 設定値(0ならa_defaultを使う).
+/// @param a_default 既定値(0なら制限なし).
+/// @return 上限値.
+inline float mrd_mv_profile_limit(int a_val, int a_default)
+{
+  if (a_val > 0)
+  {
+    return float(a_val);
+  }
+  return (a_default > 0) ? float(a_default) : PROFILE_UNLIMITED;
+}
+
+/// @brief EEPROMの[2][*]の内容から各サーボの動作プロファイルの上限値を設定する.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_page EEPROMの[2][*]の内容. nullptrの場合はすべてconfig.hの既定値とする.
+void mrd_mv_profile_load(ServoParam &a_sv, const int16_t *a_page)
+{
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
+  {
+    for (int i = 0; i < MRD_SERVO_SLOTS; i++)
+    {
+      const bool saved = (a_page != nullptr && line < MRD_SV_EEPROM_LINES); // C系統はEEPROMに保存しない
+      const int vel_tmp = saved ? a_page[MRD_SV_ORIGIDX[line] + i * 2] : 0;
+      const uint16_t aj_tmp = saved ? uint16_t(a_page[MRD_SV_ORIGIDX[line] + i * 2 + 1]) : 0;
+      a_sv.vel_max[line][i] = mrd_mv_profile_limit(vel_tmp, SERVO_MOVE_LIMIT * 100);
+      a_sv.acc_max[line][i] = mrd_mv_profile_limit(aj_tmp & 0xFF, SERVO_PROFILE_ACC);
+      a_sv.jerk_max[line][i] = mrd_mv_profile_limit(aj_tmp >> 8, SERVO_PROFILE_JERK);
+    }
+  }
+}
+
+/// @brief 動作プロファイルを1フレーム進め, サーボの目標値を上限値の範囲内に置き換える.
+///        トルクオン(コマンド1)でないサーボは前回の現在位置に同期し, 静止状態から再開する.
+/// @param a_meridim サーボのコマンドを含むMeridim配列.
+/// @param a_sv サーボパラメータの構造体. tgtを目標値として受け取り, 制限後の値で上書きする.
+void mrd_mv_profile_update(const Meridim90Union &a_meridim, ServoParam &a_sv)
+{
+  float *pos = &profile.pos[0][0];
+  float *vel = &profile.vel[0][0];
+  float *acc = &profile.acc[0][0];
+  const float *vmax = &a_sv.vel_max[0][0];
+  const float *amax = &a_sv.acc_max[0][0];
+  const float *jmax = &a_sv.jerk_max[0][0];
+  int16_t *tgt = &a_sv.tgt[0][0];
+  const int16_t *past = &a_sv.tgt_past[0][0];
+
+  for (int k = 0; k < PROFILE_NUM; k++)
+  {
+    // トルクオンのサーボは1.0, それ以外は0.0として状態を前回の現在位置に同期する
+    const float on = float(a_meridim.sval[MRD_SV_ORIGIDX[k / MRD_SERVO_SLOTS] + (k % MRD_SERVO_SLOTS) * 2] == 1);
+    const float p = on * pos[k] + (1.0f - on) * float(past[k]);
+    const float v = on * vel[k];
+    const float a = on * acc[k];
+
+    // 残り距離から停止可能な速度の上限を求める.
+    // 躍度の制限で加速度の立ち上がりに遅れが出るため, 減速に使う加速度はsqrt(躍度*速度)以下とし,
+    // 立ち上がり時間(A/J)分の距離を見込む. 桁落ちを避けるため有理化した式で計算する.
+    const float e = float(tgt[k]) - p;
+    const float dist = fabsf(e);
+    const float a_brk = fminf(amax[k], sqrtf(jmax[k] * vmax[k]));
+    const float b = 0.5f * (a_brk / jmax[k] + 1.0f);
+    const float v_stop = 2.0f * dist / (b + sqrtf(b * b + 2.0f * dist / a_brk));
+    const float v_cap = fminf(fminf(vmax[k], v_stop), dist); // 1フレームで目標を越えない
+    const float v_des = copysignf(v_cap, e);
+
+    // 加速度を0に戻すまでに進む速度を見込んで加速度の目標を決め, 躍度と加速度を制限する
+    const float v_pred = v + a * fabsf(a) / (2.0f * jmax[k]);
+    const float a_des = fminf(fmaxf(v_des - v_pred, -a_brk), a_brk);
+    const float a_jrk = fminf(fmaxf(a + fminf(fmaxf(a_des - a, -jmax[k]), jmax[k]), -a_brk), a_brk);
+
+    // 目標を越えないことを優先し, 速度は停止可能な上限で抑える(減速開始時は躍度の制限を超えることがある)
+    const float v_new = fminf(fmaxf(v + a_jrk, -v_cap), v_cap);
+    acc[k] = v_new - v;
+    vel[k] = v_new;
+    pos[k] = p + v_new;
+    tgt[k] = int16_t(lroundf(pos[k]));
+  }
+}
+
+#endif // __MERIDIAN_MOVEMENT_PROFILER_H__
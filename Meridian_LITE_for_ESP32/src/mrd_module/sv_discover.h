@@ -0,0 +1,197 @@
+#ifndef __MERIDIAN_SERVO_DISCOVER_H__
+#define __MERIDIAN_SERVO_DISCOVER_H__
+
+#include "config.h"
+#include "main.h"
+#include "mrd_util.h"
+#include "sv_ics.h"
+
+//==================================================================================================
+//  通信不能サーボの切り離しと再接続  --------------------------------------------------------------
+//==================================================================================================
+// ICSの系統で, 通信不能(err)になったサーボを駆動対象(mount)から切り離し, 毎フレームのタイムアウト待ちをなくす.
+// フレームの残り時間に余裕がある場合のみ, SERVO_DISCOVER_INTERVALフレームに1回, 切り離したサーボの1台に
+// ストレッチ値の読込で問い合わせ, 返信があればマウントに戻す. 同じ系統でマウント中のサーボとIDが重なる
+// スロットは, 返信がそのサーボのものと区別できないため問い合わせない. 起動時にマウントしていないスロットは
+// 対象外とする. マウントの変化はMeridimの巡回テレメトリ欄で
+// 項目番号 種類*1000 + 系統(L:100, R:200, C:300) + インデックス, 値はサーボIDとしてPCへ送る.
+
+// 探索結果の種類(巡回テレメトリの項目番号の千の位. 健康状態の種類と重ならない値)
+enum ServoDiscoverKind
+{
+  SV_DISCOVER_FOUND = 7, // マウントに戻した
+  SV_DISCOVER_LOST = 8   // 切り離した
+};
+#define SV_DISCOVER_EVENTS 8 // 未送信の変化を保持する数
+
+// 探索の状態
+struct ServoDiscovery
+{
+  uint32_t lost[MRD_SERVO_LINES] = {0};     // 通信不能で切り離したサーボのビットセット
+  int probe_pos = 0;                        // 次に問い合わせる通し番号([系統][インデックス]の順)
+  int wait = 0;                             // 次の問い合わせまでのフレーム数
+  uint16_t ev_key[SV_DISCOVER_EVENTS] = {0}; // 未送信の変化の項目番号
+  uint8_t ev_id[SV_DISCOVER_EVENTS] = {0};   // 未送信の変化のサーボID
+  uint8_t ev_head = 0;                      // 次に書き込む位置
+  uint8_t ev_tail = 0;                      // 次に送る位置
+};
+ServoDiscovery sv_discover;
+
+/// @brief マウントの変化を送信待ちに追加する. 満杯の場合は捨てる.
+void mrd_sv_discover_event(int a_kind, int a_line, int a_idx, uint8_t a_id)
+{
+  const uint8_t next = (sv_discover.ev_head + 1) % SV_DISCOVER_EVENTS;
+  if (next == sv_discover.ev_tail)
+  {
+    return;
+  }
+  sv_discover.ev_key[sv_discover.ev_head] = a_kind * 1000 + (a_line + 1) * 100 + a_idx;
+  sv_discover.ev_id[sv_discover.ev_head] = a_id;
+  sv_discover.ev_head = next;
+  serial_pc.println(String("Servo ") + mrd_get_line_name(UartLine(a_line)) + String(a_idx) + " id:" + String(a_id) +
+                    ((a_kind == SV_DISCOVER_FOUND) ? " mounted." : " lost."));
+}
+
+/// @brief ICSサーボの系統かどうか(いずれかのスロットの種類がKOICS3).
+inline bool mrd_sv_discover_ics_line(const ServoParam &a_sv, int a_line)
+{
+  for (int i = 0; i < MRD_SERVO_SLOTS; i++)
+  {
+    if (a_sv.type[a_line][i] == KOICS3)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// @brief 系統のマウント中のスロットに指定のIDのサーボがあるか.
+inline bool mrd_sv_discover_id_mounted(const ServoParam &a_sv, int a_line, uint8_t a_id)
+{
+  uint32_t bits_tmp = a_sv.mount[a_line];
+  while (bits_tmp)
+  {
+    const int i = __builtin_ctz(bits_tmp);
+    bits_tmp &= bits_tmp - 1;
+    if (a_sv.id[a_line][i] == a_id)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// @brief 通し番号のスロットが問い合わせの対象か(切り離したサーボで, IDがマウント中のサーボと重ならない).
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_pos 通し番号.
+inline bool mrd_sv_discover_candidate(const ServoParam &a_sv, int a_pos)
+{
+  const int line = a_pos / MRD_SERVO_SLOTS;
+  const int idx = a_pos % MRD_SERVO_SLOTS;
+  if (!(sv_discover.lost[line] & (1UL << idx)))
+  {
+    return false;
+  }
+  return !mrd_sv_discover_id_mounted(a_sv, line, a_sv.id[line][idx]);
+}
+
+/// @brief 通信不能になったサーボを切り離し, フレームの残り時間に余裕があれば切り離したサーボに1件問い合わせる.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_frame_start_us 今回のフレームの開始時刻(us).
+/// @return マウントのビットセットが変化した場合はtrue. グループを作り直すこと.
+bool mrd_sv_discover_step(ServoParam &a_sv, unsigned long a_frame_start_us)
+{
+  bool changed = false;
+  uint32_t lost_any = 0;
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
+  {
+    if (!mrd_sv_discover_ics_line(a_sv, line))
+    {
+      continue;
+    }
+
+    // 通信不能になったICSサーボを駆動対象から切り離す
+    uint32_t bits_tmp = a_sv.err[line] & a_sv.mount[line];
+    while (bits_tmp)
+    {
+      const int i = __builtin_ctz(bits_tmp);
+      bits_tmp &= bits_tmp - 1;
+      if (a_sv.type[line][i] != KOICS3)
+      {
+        continue;
+      }
+      a_sv.mount[line] &= ~(1UL << i);
+      sv_discover.lost[line] |= (1UL << i);
+      mrd_sv_discover_event(SV_DISCOVER_LOST, line, i, a_sv.id[line][i]);
+      changed = true;
+    }
+    lost_any |= sv_discover.lost[line];
+  }
+
+  // 問い合わせの間隔とフレームの残り時間の確認
+  if (!lost_any)
+  {
+    return changed;
+  }
+  if (sv_discover.wait > 0)
+  {
+    sv_discover.wait--;
+    return changed;
+  }
+  if (micros() - a_frame_start_us + SERVO_DISCOVER_MARGIN_US > (unsigned long)(FRAME_DURATION * 1000))
+  {
+    return changed;
+  }
+
+  // 次の問い合わせ対象を探す
+  const int total = MRD_SERVO_LINES * MRD_SERVO_SLOTS;
+  int pos = sv_discover.probe_pos;
+  int n = 0;
+  for (; n < total && !mrd_sv_discover_candidate(a_sv, pos); n++)
+  {
+    pos = (pos + 1) % total;
+  }
+  if (n == total)
+  {
+    return changed;
+  }
+  sv_discover.probe_pos = (pos + 1) % total;
+  sv_discover.wait = SERVO_DISCOVER_INTERVAL;
+
+  const UartLine line = UartLine(pos / MRD_SERVO_SLOTS);
+  const int idx = pos % MRD_SERVO_SLOTS;
+  if (mrd_ics_bus(line).getStrc(a_sv.id[line][idx]) == -1) // mrd_ics_busがUARTをICS用に開く
+  {
+    return changed; // 返信なし
+  }
+
+  // 返信があったスロットをマウントに戻す
+  const uint32_t bit_tmp = 1UL << idx;
+  a_sv.mount[line] |= bit_tmp;
+  a_sv.err[line] &= ~bit_tmp;
+  a_sv.stale[line] &= ~bit_tmp;
+  a_sv.synced[line] &= ~bit_tmp;
+  a_sv.err_cnt[line][idx] = 0;
+  a_sv.idle_cnt[line][idx] = 0;
+  a_sv.num_max = max(a_sv.num_max, idx + 1);
+  sv_discover.lost[line] &= ~bit_tmp;
+  mrd_sv_discover_event(SV_DISCOVER_FOUND, line, idx, a_sv.id[line][idx]);
+  return true;
+}
+
+/// @brief 未送信のマウントの変化があれば1件をMeridimの巡回テレメトリ欄に格納する.
+/// @param a_meridim 格納先のMeridim配列.
+/// @return 格納した場合はtrue.
+bool mrd_sv_discover_put(Meridim90Union &a_meridim)
+{
+  if (sv_discover.ev_tail == sv_discover.ev_head)
+  {
+    return false;
+  }
+  a_meridim.sval[MRD_TELEM_KEY] = sv_discover.ev_key[sv_discover.ev_tail];
+  a_meridim.sval[MRD_TELEM_VAL] = sv_discover.ev_id[sv_discover.ev_tail];
+  sv_discover.ev_tail = (sv_discover.ev_tail + 1) % SV_DISCOVER_EVENTS;
+  return true;
+}
+
+#endif // __MERIDIAN_SERVO_DISCOVER_H__
@@ -3,15 +3,33 @@
 
 #include "config.h"
 #include "main.h"
+#include "sv_gs2d.h"
+
+#include "gs2d_robotis.h"
 
 //==================================================================================================
 //  DYNAMIXELサーボ関連の処理  ----------------------------------------------------------------------
 //==================================================================================================
+// DYNAMIXEL Protocol 2.0 のSync Writeで目標値を, Sync Readで現在値を1系統まとめて送受信する.
+
+typedef MrdGs2dBus<gs2d::RobotisP20<MrdGs2dSerial, 2, MRD_GS2D_CMD_SIZE>> MrdDxl2Bus;
+MrdDxl2Bus dxl2_bus[MRD_SERVO_LINES]; // 系統ごとのドライバ
+
+/// @brief DYNAMIXEL Protocol 2.0 の系統の通信を開始する.
+/// @param a_line サーボの系統.
+/// @return 常にtrueを返す.
+bool mrd_sv_dxl2_begin(UartLine a_line) {
+  dxl2_bus[a_line].begin(a_line);
+  return true;
+}
 
-/// @brief スタブ関数.
-/// @return 常にfalseを返す.
-bool mrd_servo_dxl20_x() {
-  return false;
+/// @brief DYNAMIXEL Protocol 2.0 の系統のサーボを駆動する.
+/// @param a_meridim Meridimデータの参照.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_line サーボの系統.
+/// @param a_mask 駆動するサーボのビットセット.
+void mrd_sv_drive_dxl2(Meridim90Union &a_meridim, ServoParam &a_sv, UartLine a_line, uint32_t a_mask) {
+  mrd_sv_drive_gs2d(a_meridim, a_sv, a_line, a_mask, dxl2_bus[a_line], true);
 }
 
 #endif // __MERIDIAN_SERVO_DYNAMIXEL_H__
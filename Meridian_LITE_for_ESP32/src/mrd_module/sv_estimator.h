@@ -0,0 +1,111 @@
+#ifndef __MERIDIAN_SERVO_ESTIMATOR_H__
+#define __MERIDIAN_SERVO_ESTIMATOR_H__
+
+#include "config.h"
+#include "main.h"
+
+//==================================================================================================
+//  サーボの位置と速度の推定  --------------------------------------------------------------------
+//==================================================================================================
+// サーボごとにalpha-betaフィルタで位置と速度を推定する. 返信の受信時刻(ServoParam::rx_us)を観測時刻とし,
+// 前回の観測からの経過時間で予測してから返信の値で補正する. 今回のフレームで返信がないサーボ(タイムアウト,
+// 送信省略, 巡回読込みの対象外)は補正せず, 外挿フラグを立てる. 出力は送信直前の時刻まで速度で外挿した位置で,
+// 外挿はSERVO_EST_HOLD_MSまでとする.
+
+#define SV_EST_RESET_US 200000 // 観測の間隔がこれ以上空いた場合は推定をやり直す(us)
+
+// 推定値
+struct ServoEstimator
+{
+  float pos[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};     // 推定位置(degree*100)
+  float vel[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};     // 推定速度(degree*100/s)
+  uint32_t t_us[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}}; // 推定値の時刻(最後に取り込んだ返信の受信時刻)
+  uint32_t init[MRD_SERVO_LINES] = {0};                   // 推定を開始済みのサーボのビットセット
+  uint32_t extrap[MRD_SERVO_LINES] = {0};                 // 今回の出力が外挿のサーボのビットセット
+};
+ServoEstimator sv_est;
+
+/// @brief 今回のフレームの返信を推定値に取り込む. サーボの駆動後に毎フレーム呼ぶ.
+/// @param a_sv サーボパラメータの構造体. 返信があったサーボはtgtに現在位置を持つ.
+void mrd_sv_est_update(const ServoParam &a_sv)
+{
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
+  {
+    sv_est.init[line] &= a_sv.mount[line]; // 切り離したサーボは再マウント時に推定をやり直す
+    uint32_t bits_tmp = a_sv.mount[line];
+    while (bits_tmp)
+    {
+      const int i = __builtin_ctz(bits_tmp);
+      bits_tmp &= bits_tmp - 1;
+      const uint32_t bit_tmp = 1UL << i;
+      const uint32_t rx = a_sv.rx_us[line][i];
+      float &pos = sv_est.pos[line][i];
+      float &vel = sv_est.vel[line][i];
+      uint32_t &t_us = sv_est.t_us[line][i];
+
+      if (rx == t_us && (sv_est.init[line] & bit_tmp))
+      { // 新しい返信なし
+        sv_est.extrap[line] |= bit_tmp;
+        continue;
+      }
+      sv_est.extrap[line] &= ~bit_tmp;
+      if (rx == 0)
+      { // まだ一度も返信がない
+        sv_est.extrap[line] |= bit_tmp;
+        continue;
+      }
+
+      const uint32_t dt_us = rx - t_us;
+      if (!(sv_est.init[line] & bit_tmp) || dt_us >= SV_EST_RESET_US)
+      { // 最初の返信, または間隔が空いた場合は返信の値から始める
+        pos = a_sv.tgt[line][i];
+        vel = 0.0f;
+        sv_est.init[line] |= bit_tmp;
+      }
+      else if (dt_us > 0)
+      {
+        const float dt = dt_us * 1e-6f;
+        const float pred = pos + vel * dt;
+        const float resid = a_sv.tgt[line][i] - pred;
+        pos = pred + SERVO_EST_ALPHA * resid;
+        vel += SERVO_EST_BETA * resid / dt;
+      }
+      t_us = rx;
+    }
+  }
+}
+
+/// @brief 推定位置と推定速度, 外挿フラグをMeridimの拡張領域に格納する.
+/// @param a_meridim 格納先のMeridim配列.
+/// @param a_sv サーボパラメータの構造体.
+void mrd_sv_est_put(Meridim90Union &a_meridim, const ServoParam &a_sv)
+{
+  const uint32_t now = micros();
+  const uint32_t hold_us = SERVO_EST_HOLD_MS * 1000UL;
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
+  {
+    const int orig = MRD_EST_ORIGIDX + line * MRD_SERVO_SLOTS * 2;
+    for (int i = 0; i < MRD_SERVO_SLOTS; i++)
+    {
+      if (!(sv_est.init[line] & (1UL << i)))
+      {
+        a_meridim.sval[orig + i * 2] = a_sv.tgt[line][i];
+        a_meridim.sval[orig + i * 2 + 1] = 0;
+        continue;
+      }
+      uint32_t ahead_us = now - sv_est.t_us[line][i];
+      if (ahead_us > hold_us)
+      {
+        ahead_us = hold_us;
+      }
+      const float pos_tmp = sv_est.pos[line][i] + sv_est.vel[line][i] * (ahead_us * 1e-6f);
+      const float vel_tmp = sv_est.vel[line][i] * 0.1f; // degree*100/s -> degree/s*10
+      a_meridim.sval[orig + i * 2] = int16_t(constrain(pos_tmp, -32767.0f, 32767.0f));
+      a_meridim.sval[orig + i * 2 + 1] = int16_t(constrain(vel_tmp, -32767.0f, 32767.0f));
+    }
+    a_meridim.usval[MRD_EST_ORIGIDX + MRD_SERVO_LINES * MRD_SERVO_SLOTS * 2 + line] =
+        uint16_t(sv_est.extrap[line] & a_sv.mount[line]);
+  }
+}
+
+#endif // __MERIDIAN_SERVO_ESTIMATOR_H__
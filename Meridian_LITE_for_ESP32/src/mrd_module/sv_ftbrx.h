@@ -3,15 +3,34 @@
 
 #include "config.h"
 #include "main.h"
+#include "sv_gs2d.h"
+
+#include "gs2d_futaba.h"
 
 //==================================================================================================
 //  FUTABA RSxTTLサーボ関連の処理  ------------------------------------------------------------------
 //==================================================================================================
+// ロングパケットで目標値を1系統まとめて送る. RSxTTLには同期読込みがないため,
+// 現在値は1フレームにつき1サーボずつ巡回して読む.
+
+typedef MrdGs2dBus<gs2d::Futaba<MrdGs2dSerial, 2, MRD_GS2D_CMD_SIZE>> MrdFtbrxBus;
+MrdFtbrxBus ftbrx_bus[MRD_SERVO_LINES]; // 系統ごとのドライバ
+
+/// @brief FUTABA RSxTTL の系統の通信を開始する.
+/// @param a_line サーボの系統.
+/// @return 常にtrueを返す.
+bool mrd_sv_ftbrx_begin(UartLine a_line) {
+  ftbrx_bus[a_line].begin(a_line);
+  return true;
+}
 
-/// @brief スタブ関数.
-/// @return 常にfalseを返す.
-bool mrd_servo_ftbrs_x() {
-  return false;
+/// @brief FUTABA RSxTTL の系統のサーボを駆動する.
+/// @param a_meridim Meridimデータの参照.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_line サーボの系統.
+/// @param a_mask 駆動するサーボのビットセット.
+void mrd_sv_drive_ftbrx(Meridim90Union &a_meridim, ServoParam &a_sv, UartLine a_line, uint32_t a_mask) {
+  mrd_sv_drive_gs2d(a_meridim, a_sv, a_line, a_mask, ftbrx_bus[a_line], false);
 }
 
 #endif // __MERIDIAN_SERVO_FUTABA_RSxTTL_H__
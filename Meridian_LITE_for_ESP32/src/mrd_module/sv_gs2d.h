@@ -0,0 +1,308 @@
+#ifndef __MERIDIAN_SERVO_GS2D_H__
+#define __MERIDIAN_SERVO_GS2D_H__
+
+#include "config.h"
+#include "main.h"
+
+#include "gs2d_command.h"
+#include "gs2d_driver.h"
+
+//==================================================================================================
+//  gs2d によるシリアルサーボの共通処理
+//  https://github.com/karakuri-products/gs2d
+//==================================================================================================
+// 1系統につき, 目標値は全サーボ分を1パケットの同期書込み(burstWriteTargetPositions)で送り,
+// 現在値は同期読込み(burstReadPositions)に対応するプロトコルでは1回の要求で全サーボ分を受け取る.
+// 同期読込みに対応しないプロトコルでは1フレームにつき1サーボずつ巡回して読む.
+
+#define MRD_GS2D_CMD_SIZE 100 // gs2dの1コマンドの最大長(15サーボ分の同期書込みが収まる長さ)
+
+// 各系統のUARTとENピン
+HardwareSerial *const MRD_SV_SERIAL[MRD_SERVO_LINES] = {&Serial1, &Serial2};
+const int MRD_SV_PIN_EN[MRD_SERVO_LINES] = {PIN_EN_L, PIN_EN_R};
+const long MRD_SV_BAUDRATE[MRD_SERVO_LINES] = {SERVO_BAUDRATE_L, SERVO_BAUDRATE_R};
+const int MRD_SV_TIMEOUT[MRD_SERVO_LINES] = {SERVO_GS2D_TIMEOUT_L, SERVO_GS2D_TIMEOUT_R}; // 返信1件あたり
+
+//------------------------------------------------------------------------------------
+//  gs2d用シリアルクラス
+//------------------------------------------------------------------------------------
+
+/// @brief gs2dのSerialClassとして使うHardwareSerialの橋渡しクラス.
+///        gs2dのドライバ生成時にはUARTが未定なので, bind()で後から割り当てる.
+class MrdGs2dSerial
+{
+private:
+  HardwareSerial *m_serial = nullptr; // 割り当てたUART
+  int m_pin_en = -1;                  // 送受信切替用のENピン
+
+public:
+  /// @brief UARTを割り当てて通信を開始する.
+  /// @param a_serial UARTのインスタンス.
+  /// @param a_pin_en 送受信切替用のENピン. HIGHで送信.
+  /// @param a_baudrate 通信速度.
+  void bind(HardwareSerial *a_serial, int a_pin_en, long a_baudrate)
+  {
+    m_serial = a_serial;
+    m_pin_en = a_pin_en;
+    m_serial->begin(a_baudrate, SERIAL_8N1);
+    pinMode(m_pin_en, OUTPUT);
+    digitalWrite(m_pin_en, LOW);
+  }
+
+  int open(void) { return 0; }
+  void close(void) {}
+  int isConnected(void) { return (m_serial != nullptr) ? 1 : 0; }
+
+  int read(void)
+  {
+    if (m_serial == nullptr || m_serial->available() <= 0)
+    {
+      return -1;
+    }
+    return m_serial->read();
+  }
+
+  /// @brief 受信済みのデータを最大a_size個まとめて読む.
+  /// @return 読んだバイト数.
+  int read(uint8_t *a_data, int a_size)
+  {
+    if (m_serial == nullptr)
+    {
+      return 0;
+    }
+    const int avail = m_serial->available();
+    if (avail <= 0)
+    {
+      return 0;
+    }
+    return int(m_serial->readBytes(a_data, (avail < a_size) ? avail : a_size));
+  }
+
+  int write(unsigned char *data, unsigned char size)
+  {
+    if (m_serial == nullptr)
+    {
+      return 0;
+    }
+    digitalWrite(m_pin_en, HIGH); // 送信切替
+    m_serial->write(data, size);
+    m_serial->flush();
+    while (m_serial->available() > 0)
+    { // 自分の送信の折り返しを読み捨てる
+      m_serial->read();
+    }
+    digitalWrite(m_pin_en, LOW); // 受信切替
+    return size;
+  }
+
+  unsigned long long int time(void) { return millis(); }
+};
+
+/// @brief gs2dのドライバにUARTの割り当てと受信待ちの完了処理を追加するクラス.
+/// @tparam Base gs2dのドライバ(gs2d::RobotisP20<MrdGs2dSerial>など).
+template <class Base>
+class MrdGs2dBus : public Base
+{
+public:
+  /// @brief UARTを割り当て, 返信1件あたりのタイムアウト時間を設定する.
+  /// @param a_line サーボの系統.
+  void begin(UartLine a_line)
+  {
+    this->serialPort.bind(MRD_SV_SERIAL[a_line], MRD_SV_PIN_EN[a_line], MRD_SV_BAUDRATE[a_line]);
+    this->receiveTimeout = MRD_SV_TIMEOUT[a_line];
+  }
+
+  /// @brief 送信済みのコマンドの返信をすべて受け取るか, タイムアウトするまで待つ.
+  void drain()
+  {
+    while (!this->isTrafficFree.get())
+    {
+      this->listener();
+    }
+  }
+};
+
+//------------------------------------------------------------------------------------
+//  共通の駆動処理
+//------------------------------------------------------------------------------------
+
+// gs2dで駆動する系統の状態
+struct Gs2dLineState
+{
+  uint32_t torque = 0; // トルクオン中のサーボのビットセット
+  int read_pos = 0;    // 巡回読込みの次のインデックス
+};
+Gs2dLineState gs2d_state[MRD_SERVO_LINES];
+
+// 同期読込みのコールバックから参照する読込み先
+ServoParam *gs2d_rd_sv = nullptr;
+UartLine gs2d_rd_line = L;
+uint32_t gs2d_rd_mask = 0; // 読込み対象のサーボのビットセット
+uint32_t gs2d_rd_ok = 0; // 返信を受け取れたサーボのビットセット
+
+/// @brief Meridianの角度(degree*100)をサーボの角度(degree)に変換する.
+inline float mrd_sv_gs2d_cdeg2deg(const ServoParam &a_sv, UartLine a_line, int a_idx, int16_t a_cdeg)
+{
+  return a_cdeg * 0.01f * a_sv.cw[a_line][a_idx] + a_sv.trim[a_line][a_idx];
+}
+
+/// @brief サーボの角度(degree)をMeridianの角度(degree*100)に変換する.
+inline int16_t mrd_sv_gs2d_deg2cdeg(const ServoParam &a_sv, UartLine a_line, int a_idx, float a_deg)
+{
+  float cdeg_tmp = (a_deg - a_sv.trim[a_line][a_idx]) * a_sv.cw[a_line][a_idx] * 100.0f;
+  cdeg_tmp = constrain(cdeg_tmp, -32767.0f, 32767.0f);
+  return int16_t(lroundf(cdeg_tmp));
+}
+
+/// @brief 同期読込みの返信1件ごとに呼ばれ, IDからインデックスを探して現在値を格納する.
+void mrd_sv_gs2d_read_cb(gs2d::CallbackEventArgs a_e)
+{
+  if (gs2d_rd_sv == nullptr || a_e.status != 0)
+  {
+    return;
+  }
+  uint32_t bits_tmp = gs2d_rd_mask;
+  while (bits_tmp)
+  {
+    const int i = __builtin_ctz(bits_tmp);
+    bits_tmp &= bits_tmp - 1;
+    if (gs2d_rd_sv->id[gs2d_rd_line][i] == a_e.id)
+    {
+      gs2d_rd_sv->tgt[gs2d_rd_line][i] =
+          mrd_sv_gs2d_deg2cdeg(*gs2d_rd_sv, gs2d_rd_line, i, static_cast<gs2d::gFloat>(a_e.data));
+      gs2d_rd_ok |= (1UL << i);
+      return;
+    }
+  }
+}
+
+/// @brief 返信の有無をサーボパラメータのビットセットに反映する.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_line サーボの系統.
+/// @param a_idx サーボのインデックス番号.
+/// @param a_ok 返信を受け取れた場合はtrue.
+void mrd_sv_gs2d_reply(ServoParam &a_sv, UartLine a_line, int a_idx, bool a_ok)
+{
+  const uint32_t bit_tmp = 1UL << a_idx;
+  uint8_t &err_cnt = a_sv.err_cnt[a_line][a_idx];
+  if (a_ok)
+  {
+    err_cnt = 0;
+    a_sv.stale[a_line] &= ~bit_tmp;
+    a_sv.err[a_line] &= ~bit_tmp;
+    a_sv.rx_us[a_line][a_idx] = micros();
+    return;
+  }
+  a_sv.stale[a_line] |= bit_tmp;
+  if (++err_cnt >= SERVO_LOST_ERR_WAIT)
+  { // 一定以上の連続エラーで通信不能とみなす
+    err_cnt = SERVO_LOST_ERR_WAIT;
+    a_sv.err[a_line] |= bit_tmp;
+  }
+}
+
+/// @brief gs2dのドライバで1系統のサーボを駆動する.
+///        目標値は1パケットで同期書込みし, 現在値は同期読込みまたは1サーボずつの巡回読込みで得る.
+///        返信がなかったサーボの値は送信した目標値(脱力中は前回値)のままとする.
+/// @param a_meridim Meridimデータの参照.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_line サーボの系統.
+/// @param a_mask 駆動するサーボのビットセット.
+/// @param a_bus gs2dのドライバ.
+/// @param a_burst_read 同期読込みに対応している場合はtrue.
+template <class Bus>
+void mrd_sv_drive_gs2d(Meridim90Union &a_meridim, ServoParam &a_sv, UartLine a_line, uint32_t a_mask,
+                       Bus &a_bus, bool a_burst_read)
+{
+  Gs2dLineState &st = gs2d_state[a_line];
+  uint8_t ids[MRD_SERVO_SLOTS];
+  gs2d::gFloat pos[MRD_SERVO_SLOTS];
+  uint8_t cnt = 0;
+
+  // 目標値の収集とトルクの切替
+  uint32_t bits_tmp = a_mask;
+  while (bits_tmp)
+  {
+    const int i = __builtin_ctz(bits_tmp);
+    bits_tmp &= bits_tmp - 1;
+    const uint32_t bit_tmp = 1UL << i;
+    const bool on = (a_meridim.sval[MRD_SV_ORIGIDX[a_line] + i * 2] == 1);
+    if (on != bool(st.torque & bit_tmp))
+    { // トルクの切替は変化した時のみ送る
+      a_bus.writeTorqueEnable(a_sv.id[a_line][i], on ? 1 : 0);
+      st.torque ^= bit_tmp;
+    }
+    if (on)
+    {
+      ids[cnt] = a_sv.id[a_line][i];
+      pos[cnt] = mrd_sv_gs2d_cdeg2deg(a_sv, a_line, i, a_sv.tgt[a_line][i]);
+      cnt++;
+    }
+    else
+    {
+      a_sv.tgt[a_line][i] = a_sv.tgt_past[a_line][i];
+    }
+  }
+
+  // 目標値の同期書込み(1パケット)
+  if (cnt > 0)
+  {
+    a_bus.burstWriteTargetPositions(ids, pos, cnt);
+  }
+
+  // 現在値の読込み
+  if (a_burst_read)
+  { // 全サーボ分を1回の要求で読む
+    cnt = 0;
+    bits_tmp = a_mask;
+    while (bits_tmp)
+    {
+      const int i = __builtin_ctz(bits_tmp);
+      bits_tmp &= bits_tmp - 1;
+      ids[cnt++] = a_sv.id[a_line][i];
+    }
+    if (cnt == 0)
+    {
+      return;
+    }
+    gs2d_rd_sv = &a_sv;
+    gs2d_rd_line = a_line;
+    gs2d_rd_mask = a_mask;
+    gs2d_rd_ok = 0;
+    a_bus.burstReadPositions(ids, cnt, mrd_sv_gs2d_read_cb);
+    a_bus.drain();
+    gs2d_rd_sv = nullptr;
+
+    bits_tmp = a_mask;
+    while (bits_tmp)
+    {
+      const int i = __builtin_ctz(bits_tmp);
+      bits_tmp &= bits_tmp - 1;
+      mrd_sv_gs2d_reply(a_sv, a_line, i, gs2d_rd_ok & (1UL << i));
+    }
+  }
+  else
+  { // 1フレームにつき1サーボずつ巡回して読む
+    if (a_mask == 0)
+    {
+      return;
+    }
+    int i = st.read_pos;
+    while (!(a_mask & (1UL << i)))
+    {
+      i = (i + 1) % MRD_SERVO_SLOTS;
+    }
+    st.read_pos = (i + 1) % MRD_SERVO_SLOTS;
+
+    a_bus.clearErrorCode();
+    const gs2d::gFloat deg_tmp = a_bus.readCurrentPosition(a_sv.id[a_line][i]);
+    const bool ok = (a_bus.getErrorCode() == 0);
+    if (ok)
+    {
+      a_sv.tgt[a_line][i] = mrd_sv_gs2d_deg2cdeg(a_sv, a_line, i, deg_tmp);
+    }
+    mrd_sv_gs2d_reply(a_sv, a_line, i, ok);
+  }
+}
+
+#endif // __MERIDIAN_SERVO_GS2D_H__
@@ -0,0 +1,181 @@
+#ifndef __MERIDIAN_SERVO_HEALTH_H__
+#define __MERIDIAN_SERVO_HEALTH_H__
+
+#include "config.h"
+#include "main.h"
+#include "mrd_util.h"
+#include "sv_ics.h"
+
+//==================================================================================================
+//  サーボの健康状態モニタ関連の処理  ----------------------------------------------------------------
+//==================================================================================================
+// フレームの残り時間に余裕がある場合のみ, 1フレームにつき1サーボの1項目(温度, 電流, ストレッチ,
+// スピード)を読み, 一覧表に保持する. 一覧表はMeridimの巡回テレメトリ欄([MRD_TELEM_KEY],
+// [MRD_TELEM_VAL])で1項目ずつ順番にPCへ送る. 項目番号は 種類*1000 + 系統(L:100, R:200) + インデックス.
+// 温度または電流がしきい値を超えたサーボはストレッチを下げてトルクを低減し, 回復したら元に戻す.
+
+// 健康状態の項目の種類
+enum ServoHealthKind
+{
+  SV_HEALTH_TMP = 1,    // 温度値(127:低温 <=> 0:高温)
+  SV_HEALTH_CUR = 2,    // 電流値(0-63)
+  SV_HEALTH_STRC = 3,   // ストレッチ値(1-127)
+  SV_HEALTH_SPD = 4,    // スピード値(1-127)
+  SV_HEALTH_REDUCED = 9 // トルク低減中のサーボのビットマップ(インデックスは0)
+};
+#define SV_HEALTH_KINDS 4 // サーボごとに読む項目数
+
+// 健康状態の一覧表
+struct ServoHealth
+{
+  uint8_t val[MRD_SERVO_LINES][MRD_SERVO_SLOTS][SV_HEALTH_KINDS] = {{{0}}}; // 読み取り値(0は未取得)
+  uint8_t strc_orig[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};             // トルク低減前のストレッチ値
+  uint32_t reduced[MRD_SERVO_LINES] = {0};                                  // トルク低減中のビットセット
+  int read_pos = 0;                                                         // 次に読む項目の通し番号
+  int put_pos = 0;                                                          // 次に送る項目の通し番号
+};
+ServoHealth sv_health;
+
+// 一覧表の項目の通し番号: [系統][インデックス][種類] の順. 末尾に系統ごとのトルク低減ビットマップが続く
+#define SV_HEALTH_ENTRIES (MRD_SERVO_LINES * MRD_SERVO_SLOTS * SV_HEALTH_KINDS)
+
+/// @brief 通し番号の項目が通信可能なICSサーボを指しているか.
+inline bool mrd_sv_health_mounted(const ServoParam &a_sv, int a_pos)
+{
+  const int line = a_pos / (MRD_SERVO_SLOTS * SV_HEALTH_KINDS);
+  const int idx = (a_pos / SV_HEALTH_KINDS) % MRD_SERVO_SLOTS;
+  return ((a_sv.mount[line] & ~a_sv.err[line]) & (1UL << idx)) && a_sv.type[line][idx] == KOICS3;
+}
+
+/// @brief 温度と電流の値からトルク低減の要否を判定し, サーボのストレッチ値を切り替える.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_line サーボの系統.
+/// @param a_idx サーボのインデックス番号.
+/// @param ics サーボクラスのインスタンス.
+void mrd_sv_health_guard(const ServoParam &a_sv, UartLine a_line, int a_idx, IcsBaseClass &ics)
+{
+  const uint8_t *val = sv_health.val[a_line][a_idx];
+  const int tmp = val[SV_HEALTH_TMP - 1];
+  const int cur = val[SV_HEALTH_CUR - 1];
+  const uint32_t bit_tmp = 1UL << a_idx;
+
+  if (!(sv_health.reduced[a_line] & bit_tmp))
+  {
+    const bool hot = (tmp > 0 && tmp <= SERVO_HEALTH_TMP_LIMIT) || cur >= SERVO_HEALTH_CUR_LIMIT;
+    const int strc = val[SV_HEALTH_STRC - 1];
+    if (hot && strc > 0) // 元のストレッチ値を取得済みの場合のみ下げる
+    {
+      if (ics.setStrc(a_sv.id[a_line][a_idx], SERVO_HEALTH_STRC_REDUCED) != -1)
+      {
+        sv_health.strc_orig[a_line][a_idx] = strc;
+        sv_health.reduced[a_line] |= bit_tmp;
+        serial_pc.println("Servo " + String(mrd_get_line_name(a_line)) + String(a_idx) + " torque reduced. tmp:" +
+                          String(tmp) + " cur:" + String(cur));
+      }
+    }
+  }
+  else
+  {
+    const bool cool = (tmp == 0 || tmp > SERVO_HEALTH_TMP_LIMIT + SERVO_HEALTH_HYSTERESIS) &&
+                      cur < SERVO_HEALTH_CUR_LIMIT - SERVO_HEALTH_HYSTERESIS;
+    if (cool && ics.setStrc(a_sv.id[a_line][a_idx], sv_health.strc_orig[a_line][a_idx]) != -1)
+    {
+      sv_health.reduced[a_line] &= ~bit_tmp;
+      sv_health.val[a_line][a_idx][SV_HEALTH_STRC - 1] = sv_health.strc_orig[a_line][a_idx];
+      serial_pc.println("Servo " + String(mrd_get_line_name(a_line)) + String(a_idx) + " torque restored.");
+    }
+  }
+}
+
+/// @brief フレームの残り時間に余裕があれば, 次のサーボの健康状態を1項目だけ読む.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_frame_start_us 今回のフレームの開始時刻(us).
+/// @return 読み取りを行った場合はtrue.
+bool mrd_sv_health_read(const ServoParam &a_sv, unsigned long a_frame_start_us)
+{
+  if (micros() - a_frame_start_us + SERVO_HEALTH_MARGIN_US > (unsigned long)(FRAME_DURATION * 1000))
+  {
+    return false;
+  }
+
+  // 次のマウント中のサーボの項目を探す
+  int pos = sv_health.read_pos;
+  for (int n = 0; n < SV_HEALTH_ENTRIES && !mrd_sv_health_mounted(a_sv, pos); n++)
+  {
+    pos = (pos + 1) % SV_HEALTH_ENTRIES;
+  }
+  if (!mrd_sv_health_mounted(a_sv, pos))
+  {
+    return false;
+  }
+  sv_health.read_pos = (pos + 1) % SV_HEALTH_ENTRIES;
+
+  const UartLine line = UartLine(pos / (MRD_SERVO_SLOTS * SV_HEALTH_KINDS));
+  const int idx = (pos / SV_HEALTH_KINDS) % MRD_SERVO_SLOTS;
+  const int kind = pos % SV_HEALTH_KINDS + 1;
+  IcsBaseClass &ics = mrd_ics_bus(line);
+  const byte id = a_sv.id[line][idx];
+
+  int val_tmp = -1;
+  switch (kind)
+  {
+  case SV_HEALTH_TMP:
+    val_tmp = ics.getTmp(id);
+    break;
+  case SV_HEALTH_CUR:
+    val_tmp = ics.getCur(id);
+    if (val_tmp >= 64) // 64以上は逆転方向の電流
+    {
+      val_tmp -= 64;
+    }
+    break;
+  case SV_HEALTH_STRC:
+    val_tmp = ics.getStrc(id);
+    break;
+  case SV_HEALTH_SPD:
+    val_tmp = ics.getSpd(id);
+    break;
+  }
+  if (val_tmp < 0)
+  {
+    return true; // 返信なし. 前回の値を保持する
+  }
+  sv_health.val[line][idx][kind - 1] = uint8_t(val_tmp);
+
+  if (kind == SV_HEALTH_TMP || kind == SV_HEALTH_CUR)
+  {
+    mrd_sv_health_guard(a_sv, line, idx, ics);
+  }
+  return true;
+}
+
+/// @brief 健康状態の一覧表から次の1項目をMeridimの巡回テレメトリ欄に格納する.
+/// @param a_meridim 格納先のMeridim配列.
+/// @param a_sv サーボパラメータの構造体.
+void mrd_sv_health_put(Meridim90Union &a_meridim, const ServoParam &a_sv)
+{
+  const int total = SV_HEALTH_ENTRIES + MRD_SERVO_LINES;
+  for (int n = 0; n < total; n++)
+  {
+    const int pos = sv_health.put_pos;
+    sv_health.put_pos = (sv_health.put_pos + 1) % total;
+    if (pos >= SV_HEALTH_ENTRIES)
+    { // トルク低減中のビットマップ
+      const int line = pos - SV_HEALTH_ENTRIES;
+      a_meridim.sval[MRD_TELEM_KEY] = SV_HEALTH_REDUCED * 1000 + (line + 1) * 100;
+      a_meridim.usval[MRD_TELEM_VAL] = uint16_t(sv_health.reduced[line]);
+      return;
+    }
+    if (mrd_sv_health_mounted(a_sv, pos))
+    {
+      const int line = pos / (MRD_SERVO_SLOTS * SV_HEALTH_KINDS);
+      const int idx = (pos / SV_HEALTH_KINDS) % MRD_SERVO_SLOTS;
+      const int kind = pos % SV_HEALTH_KINDS;
+      a_meridim.sval[MRD_TELEM_KEY] = (kind + 1) * 1000 + (line + 1) * 100 + idx;
+      a_meridim.sval[MRD_TELEM_VAL] = sv_health.val[line][idx][kind];
+      return;
+    }
+  }
+}
+
+#endif // __MERIDIAN_SERVO_HEALTH_H__
@@ -4,6 +4,9 @@
 #include "config.h"
 #include "main.h"
 #include "mrd_disp.h"
+#include "ics_affine.h"
+#include "sv_ics_drive.h"
+#include "sv_ics_sim.h"
 
 #include "gs2d_krs.h"
 
@@ -11,88 +14,114 @@
 //  KONDO ICSサーボ関連の処理
 //==================================================================================================
 
-/// @brief ICSサーボの実行処理を行う関数
-/// @param a_servo_id サーボのインデックス番号
-/// @param a_cmd サーボのコマンド
-/// @param a_tgt サーボの目標位置
-/// @param a_tgt_past 前回のサーボの目標位置
-/// @param a_tgt_trim サーボの補正値
-/// @param a_cw サーボの回転方向補正値
-/// @param a_err_cnt サーボのエラーカウント
-/// @param a_stat サーボのステータス
-/// @param ics サーボクラスのインスタンス
-float mrd_servo_process_ics(int a_servo_id, int a_cmd, float a_tgt, float a_tgt_past, int a_trim,
-                            int a_cw, int &a_err_cnt, uint16_t &a_stat, IcsHardSerialClass &ics)
+//------------------------------------------------------------------------------------
+//  角度変換(固定小数点)
+//------------------------------------------------------------------------------------
+// 変換式と係数はics_affine.hにある.
+
+/// @brief サーボパラメータのトリム値と回転方向から全サーボの変換係数を再計算する.
+///        トリム値や回転方向を変更した場合は必ず呼び出すこと.
+/// @param a_sv サーボパラメータの構造体.
+void mrd_servo_ics_affine_update(ServoParam &a_sv)
 {
-  int val_tmp = 0;
-  if (a_cmd == 1)
-  { // コマンドが1ならPos指定
-    val_tmp = ics.setPos(a_servo_id, mrd.Deg2Krs(a_tgt, a_trim, a_cw));
-  }
-  else
-  { // コマンドが0等なら脱力して値を取得
-    val_tmp = ics.setFree(a_servo_id);
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
+  {
+    for (int i = 0; i < MRD_SERVO_SLOTS; i++)
+    {
+      a_sv.ics[line][i] = mrd_servo_ics_affine(a_sv.trim[line][i], a_sv.cw[line][i]);
+    }
   }
+}
 
-  if (val_tmp == -1)
-  { // サーボからの返信信号を受け取れなかった場合
-    val_tmp = mrd.Deg2Krs(a_tgt_past, a_trim, a_cw);
-    a_err_cnt++;
-    if (a_err_cnt >= SERVO_LOST_ERR_WAIT)
-    { // 一定以上の連続エラーで通信不能とみなす
-      a_err_cnt = SERVO_LOST_ERR_WAIT;
-      a_stat = 1;
-    }
+//------------------------------------------------------------------------------------
+//  通信バスの選択
+//------------------------------------------------------------------------------------
+
+// MODE_SERVO_SIM用の仮想バス
+IcsSimBusClass ics_sim_L(SERVO_BAUDRATE_L, SERVO_TIMEOUT_L);
+IcsSimBusClass ics_sim_R(SERVO_BAUDRATE_R, SERVO_TIMEOUT_R);
+#if MOUNT_SERVO_LINE_C
+IcsSimBusClass ics_sim_C(SERVO_BAUDRATE_C, SERVO_TIMEOUT_C);
+#endif
+
+// 系統のUARTを指定した種類のサーボ用に開く. 定義はmrd_servo.h
+bool mrd_servo_group_select(UartLine a_line, int a_type);
+
+/// @brief 系統に対応するICSの通信バスを返す. MODE_SERVO_SIMが1の場合は仮想バスを返す.
+///        UARTの設定は切り替えないため, 呼び出し側でICS用に開いてあること. 通常はmrd_ics_busを使う.
+/// @param a_line サーボの系統.
+/// @return ICS通信クラスの参照.
+inline IcsBaseClass &mrd_ics_port(UartLine a_line)
+{
+#if MOUNT_SERVO_LINE_C
+  if (a_line == C)
+  {
+    return MODE_SERVO_SIM ? static_cast<IcsBaseClass &>(ics_sim_C) : static_cast<IcsBaseClass &>(ics_C);
   }
-  else
+#endif
+  if (MODE_SERVO_SIM)
   {
-    a_err_cnt = 0;
-    a_stat = 0;
+    return (a_line == R) ? ics_sim_R : ics_sim_L;
   }
+  return (a_line == R) ? static_cast<IcsBaseClass &>(ics_R) : static_cast<IcsBaseClass &>(ics_L);
+}
 
-  return mrd.Krs2Deg(val_tmp, a_trim, a_cw);
+/// @brief 系統のUARTをICS用に開いた上で, 対応するICSの通信バスを返す.
+///        1系統に複数の種類のサーボがある場合にgs2dの設定のまま送受信しないよう, ICSの処理は全てこれを通す.
+/// @param a_line サーボの系統.
+/// @return ICS通信クラスの参照.
+inline IcsBaseClass &mrd_ics_bus(UartLine a_line)
+{
+  mrd_servo_group_select(a_line, KOICS3);
+  return mrd_ics_port(a_line);
 }
 
-/// @brief ICSサーボを駆動する関数
-/// @param a_meridim Meridimデータの参照
-/// @param a_sv サーボパラメータの配列
-void mrd_sv_drive_ics_double(Meridim90Union &a_meridim, ServoParam &a_sv)
+/// @brief 仮想バスにマウント設定どおりのサーボを取り付ける.
+/// @param a_sv サーボパラメータの構造体.
+void mrd_ics_sim_begin(const ServoParam &a_sv)
 {
-  for (int i = 0; i < a_sv.num_max; i++)
+#if MOUNT_SERVO_LINE_C
+  IcsSimBusClass *bus_tmp[MRD_SERVO_LINES] = {&ics_sim_L, &ics_sim_R, &ics_sim_C};
+#else
+  IcsSimBusClass *bus_tmp[MRD_SERVO_LINES] = {&ics_sim_L, &ics_sim_R};
+#endif
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
   {
-    // L系統サーボの処理
-    if (a_sv.ixl_mount[i])
-    { // 43は近藤科学のICSサーボ
-      a_sv.ixl_tgt[i] = mrd_servo_process_ics(
-          a_sv.ixl_id[i], a_meridim.sval[(i * 2) + 20], a_sv.ixl_tgt[i], a_sv.ixl_tgt_past[i],
-          a_sv.ixl_trim[i], a_sv.ixl_cw[i], a_sv.ixl_err[i], a_sv.ixl_stat[i], ics_L);
-    }
-    // R系統サーボの処理
-    if (a_sv.ixr_mount[i])
-    { // 43は近藤科学のICSサーボ
-      a_sv.ixr_tgt[i] = mrd_servo_process_ics(
-          a_sv.ixr_id[i], a_meridim.sval[(i * 2) + 50], a_sv.ixr_tgt[i], a_sv.ixr_tgt_past[i],
-          a_sv.ixr_trim[i], a_sv.ixr_cw[i], a_sv.ixr_err[i], a_sv.ixr_stat[i], ics_R);
+    bus_tmp[line]->set_realtime(true);
+    for (int i = 0; i < MRD_SERVO_SLOTS; i++)
+    {
+      if ((a_sv.mount[line] & (1UL << i)) && a_sv.type[line][i] == KOICS3)
+      {
+        bus_tmp[line]->mount(a_sv.id[line][i], SERVO_SIM_LATENCY_US);
+      }
     }
-    delayMicroseconds(2); // Teensyの場合には必要かも
   }
 }
 
+//------------------------------------------------------------------------------------
+//  サーボ駆動
+//------------------------------------------------------------------------------------
+// 全サーボを巡回する処理(mrd_sv_drive_ics_double/line)はsv_ics_drive.hにある.
+
 /// @brief ICSサーボを1個のみ駆動する関数
-/// @param a_id サーボID
-/// @param a_pos 目標位置
-void mrd_sv_drive_ics_individual(int a_idx, float a_pos, String a_LRC)
+/// @param a_idx サーボのインデックス番号
+/// @param a_pos 目標位置(degree*100)
+void mrd_sv_drive_ics_individual(int a_idx, int16_t a_pos, String a_LRC)
 {
   if (a_LRC == "L")
   {
-    mrd_servo_process_ics(a_idx, s_udp_meridim.sval[a_idx * 2 + 20], a_pos, a_pos, sv.ixl_trim[a_idx],
-                          sv.ixl_cw[a_idx], sv.ixl_err[a_idx], sv.ixl_stat[a_idx], ics_L);
+    mrd_servo_process_ics(sv, L, a_idx, s_udp_meridim.sval[MRD_L_ORIGIDX + a_idx * 2], a_pos, a_pos, mrd_ics_bus(L));
   }
   else if (a_LRC == "R")
   {
-    mrd_servo_process_ics(a_idx, s_udp_meridim.sval[a_idx * 2 + 50], a_pos, a_pos, sv.ixr_trim[a_idx],
-                          sv.ixr_cw[a_idx], sv.ixr_err[a_idx], sv.ixr_stat[a_idx], ics_R);
+    mrd_servo_process_ics(sv, R, a_idx, s_udp_meridim.sval[MRD_R_ORIGIDX + a_idx * 2], a_pos, a_pos, mrd_ics_bus(R));
+  }
+#if MOUNT_SERVO_LINE_C
+  else if (a_LRC == "C")
+  {
+    mrd_servo_process_ics(sv, C, a_idx, s_udp_meridim.sval[MRD_C_ORIGIDX + a_idx * 2], a_pos, a_pos, mrd_ics_bus(C));
   }
+#endif
   delayMicroseconds(2); // Teensyの場合には必要かも
 }
 
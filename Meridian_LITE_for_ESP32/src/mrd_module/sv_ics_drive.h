@@ -0,0 +1,160 @@
+#ifndef __MERIDIAN_SERVO_KONDO_ICS_DRIVE_H__
+#define __MERIDIAN_SERVO_KONDO_ICS_DRIVE_H__
+
+#include "config.h"
+#include "mrd_servo_param.h"
+#include "ics_affine.h"
+
+#include <IcsBaseClass.h>
+#include <stdlib.h>
+
+//==================================================================================================
+//  ICSサーボの駆動
+//==================================================================================================
+// Meridim配列の目標値をICSサーボに送り, 返信をサーボパラメータに反映する.
+// Arduinoの機能はIcsBaseClassの他にmicros()とdelayMicroseconds()のみ使うため,
+// 仮想バス(sv_ics_sim.h)と組み合わせてPC上でも試験できる(test/ics_sim).
+
+//------------------------------------------------------------------------------------
+//  サーボ駆動
+//------------------------------------------------------------------------------------
+
+/// @brief ICSサーボの実行処理を行い, 返信の有無をサーボパラメータのビットセットに反映する.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_line サーボの系統.
+/// @param a_idx サーボのインデックス番号.
+/// @param a_cmd サーボのコマンド.
+/// @param a_tgt サーボの目標位置(degree*100).
+/// @param a_tgt_past 前回のサーボの目標位置(degree*100). 返信がない場合の代用値.
+/// @param ics ICS通信クラスのインスタンス(実機または仮想バス).
+/// @return サーボの現在位置(degree*100).
+int16_t mrd_servo_process_ics(ServoParam &a_sv, UartLine a_line, int a_idx, int a_cmd, int16_t a_tgt,
+                              int16_t a_tgt_past, IcsBaseClass &ics)
+{
+  const IcsAffine &aff = a_sv.ics[a_line][a_idx];
+  const uint32_t bit_tmp = 1UL << a_idx;
+  int val_tmp = 0;
+  if (a_cmd == 1)
+  { // コマンドが1ならPos指定
+    val_tmp = ics.setPos(a_sv.id[a_line][a_idx], mrd_servo_cdeg2ics(a_tgt, aff));
+  }
+  else
+  { // コマンドが0等なら脱力して値を取得
+    val_tmp = ics.setFree(a_sv.id[a_line][a_idx]);
+  }
+
+  uint8_t &err_cnt = a_sv.err_cnt[a_line][a_idx];
+  a_sv.idle_cnt[a_line][a_idx] = 0;
+  if (val_tmp == -1)
+  { // サーボからの返信信号を受け取れなかった場合
+    val_tmp = mrd_servo_cdeg2ics(a_tgt_past, aff);
+    a_sv.stale[a_line] |= bit_tmp;
+    a_sv.synced[a_line] &= ~bit_tmp;
+    if (++err_cnt >= SERVO_LOST_ERR_WAIT)
+    { // 一定以上の連続エラーで通信不能とみなす
+      err_cnt = SERVO_LOST_ERR_WAIT;
+      a_sv.err[a_line] |= bit_tmp;
+    }
+  }
+  else
+  {
+    err_cnt = 0;
+    a_sv.stale[a_line] &= ~bit_tmp;
+    a_sv.err[a_line] &= ~bit_tmp;
+    a_sv.rx_us[a_line][a_idx] = micros();
+    if (a_cmd == 1)
+    { // 受理された目標値を記録する
+      a_sv.sent[a_line][a_idx] = a_tgt;
+      a_sv.synced[a_line] |= bit_tmp;
+    }
+    else
+    {
+      a_sv.synced[a_line] &= ~bit_tmp;
+    }
+  }
+
+  return mrd_servo_ics2cdeg(val_tmp, aff);
+}
+
+/// @brief 目標値が前回受理された値から不感帯以内で変化していないサーボの送信を省略するか判定する.
+///        省略が続いたサーボはSERVO_FEEDBACK_INTERVALフレームごとに送信し, 現在位置を読み直す.
+/// @param a_sv サーボパラメータの構造体.
+/// @param a_line サーボの系統.
+/// @param a_idx サーボのインデックス番号.
+/// @param a_cmd サーボのコマンド.
+/// @return 送信を省略する場合はtrue. この場合, 目標値は前回の現在位置で置き換える.
+bool mrd_servo_ics_skip(ServoParam &a_sv, UartLine a_line, int a_idx, int a_cmd)
+{
+  if (!SERVO_DIRTY_SKIP || a_cmd != 1 || !(a_sv.synced[a_line] & (1UL << a_idx)))
+  {
+    return false;
+  }
+  if (abs(a_sv.tgt[a_line][a_idx] - a_sv.sent[a_line][a_idx]) > a_sv.deadband[a_line][a_idx])
+  {
+    return false;
+  }
+  if (++a_sv.idle_cnt[a_line][a_idx] >= SERVO_FEEDBACK_INTERVAL)
+  { // 現在位置の読み直し
+    return false;
+  }
+  a_sv.tgt[a_line][a_idx] = a_sv.tgt_past[a_line][a_idx];
+  return true;
+}
+
+/// @brief ICSサーボを駆動する関数. 指定したビットセットのインデックスのみをLR交互に巡回する.
+/// @param a_meridim Meridimデータの参照
+/// @param a_sv サーボパラメータの構造体
+/// @param a_mask_l L系統で駆動するICSサーボのビットセット
+/// @param a_mask_r R系統で駆動するICSサーボのビットセット
+/// @param a_ics_l L系統のICS通信クラス
+/// @param a_ics_r R系統のICS通信クラス
+void mrd_sv_drive_ics_double(Meridim90Union &a_meridim, ServoParam &a_sv, uint32_t a_mask_l, uint32_t a_mask_r,
+                             IcsBaseClass &a_ics_l, IcsBaseClass &a_ics_r)
+{
+  uint32_t bits_tmp = a_mask_l | a_mask_r;
+  while (bits_tmp)
+  {
+    const int i = __builtin_ctz(bits_tmp);
+    bits_tmp &= bits_tmp - 1;
+
+    // L系統サーボの処理
+    if ((a_mask_l & (1UL << i)) && !mrd_servo_ics_skip(a_sv, L, i, a_meridim.sval[MRD_L_ORIGIDX + i * 2]))
+    { // 43は近藤科学のICSサーボ
+      a_sv.tgt[L][i] = mrd_servo_process_ics(a_sv, L, i, a_meridim.sval[MRD_L_ORIGIDX + i * 2],
+                                             a_sv.tgt[L][i], a_sv.tgt_past[L][i], a_ics_l);
+    }
+    // R系統サーボの処理
+    if ((a_mask_r & (1UL << i)) && !mrd_servo_ics_skip(a_sv, R, i, a_meridim.sval[MRD_R_ORIGIDX + i * 2]))
+    { // 43は近藤科学のICSサーボ
+      a_sv.tgt[R][i] = mrd_servo_process_ics(a_sv, R, i, a_meridim.sval[MRD_R_ORIGIDX + i * 2],
+                                             a_sv.tgt[R][i], a_sv.tgt_past[R][i], a_ics_r);
+    }
+    delayMicroseconds(2); // Teensyの場合には必要かも
+  }
+}
+
+/// @brief 1系統のICSサーボを駆動する関数. 指定したビットセットのインデックスのみを順に巡回する.
+/// @param a_meridim Meridimデータの参照
+/// @param a_sv サーボパラメータの構造体
+/// @param a_line サーボの系統
+/// @param a_mask 駆動するICSサーボのビットセット
+/// @param a_ics ICS通信クラス
+void mrd_sv_drive_ics_line(Meridim90Union &a_meridim, ServoParam &a_sv, UartLine a_line, uint32_t a_mask,
+                           IcsBaseClass &a_ics)
+{
+  const int orig = MRD_SV_ORIGIDX[a_line];
+  uint32_t bits_tmp = a_mask;
+  while (bits_tmp)
+  {
+    const int i = __builtin_ctz(bits_tmp);
+    bits_tmp &= bits_tmp - 1;
+    if (!mrd_servo_ics_skip(a_sv, a_line, i, a_meridim.sval[orig + i * 2]))
+    {
+      a_sv.tgt[a_line][i] = mrd_servo_process_ics(a_sv, a_line, i, a_meridim.sval[orig + i * 2],
+                                                  a_sv.tgt[a_line][i], a_sv.tgt_past[a_line][i], a_ics);
+    }
+    delayMicroseconds(2);
+  }
+}
+
+#endif // __MERIDIAN_SERVO_KONDO_ICS_DRIVE_H__
@@ -0,0 +1,246 @@
+#ifndef __MERIDIAN_SERVO_KONDO_ICS_SIM_H__
+#define __MERIDIAN_SERVO_KONDO_ICS_SIM_H__
+
+#include <IcsBaseClass.h>
+
+//==================================================================================================
+//  ICSサーボの仮想バス
+//==================================================================================================
+// IcsBaseClassのsynchronize()を置き換え, 実機のICS3.5/3.6のフレーム(0x80+id:ポジション/脱力,
+// 0xA0+id:パラメータ読込, 0xC0+id:パラメータ書込)を解釈して返信を作る.
+// 通信時間は 11bit(8E1) * バイト数 / ボーレート + サーボごとの返信遅延 で見積もり, bus_us()に積算する.
+// タイムアウトや化けた返信を指定回数または確率で注入でき, 乱数は種を固定すれば毎回同じ順に再現する.
+// Arduinoの機能はrealtime指定時のdelayMicroseconds()のみ使うため, ホスト上のベンチマークにも使える.
+
+class IcsSimBusClass : public IcsBaseClass
+{
+public:
+  // 仮想サーボ1個分の状態
+  struct SimServo
+  {
+    bool mounted = false;     // 返信するか
+    bool ics35 = false;       // ICS3.5(現在位置読込に返信しない)
+    bool free = true;         // 脱力中か
+    uint16_t pos = 7500;      // 現在位置(ICSポジション値)
+    uint16_t tgt = 7500;      // 目標位置(ICSポジション値)
+    uint16_t slew = 200;      // 1回の通信あたりの移動量(ICSポジション値)
+    uint8_t strc = 60;        // ストレッチ値
+    uint8_t spd = 127;        // スピード値
+    uint8_t cur = 0;          // 電流値
+    uint8_t tmp = 80;         // 温度値(127:低温 <=> 0:高温)
+    uint16_t latency_us = 100; // 受信完了から返信開始までの時間(us)
+    uint16_t timeout_cnt = 0;  // 残りの強制タイムアウト回数
+    uint16_t corrupt_cnt = 0;  // 残りの返信化け回数
+  };
+
+  static constexpr int BITS_PER_BYTE = 11; // スタート + 8bit + 偶数パリティ + ストップ
+
+private:
+  SimServo m_servo[MAX_ID + 1];
+  long m_baudrate;
+  int m_timeout_ms;
+  bool m_realtime = false;
+  uint16_t m_timeout_permil = 0; // 1000回あたりのタイムアウト発生数
+  uint16_t m_corrupt_permil = 0; // 1000回あたりの返信化け発生数
+  uint32_t m_seed = 1;
+  uint64_t m_bus_us = 0;
+  uint32_t m_tx_count = 0;
+  uint32_t m_timeout_count = 0;
+  uint32_t m_corrupt_count = 0;
+
+  /// @brief xorshift32による疑似乱数. 種が同じなら同じ系列を返す.
+  uint32_t rand_next()
+  {
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+  }
+
+  /// @brief バイト数分の通信時間(us)を返す.
+  uint32_t wire_us(int a_bytes) const
+  {
+    return uint32_t((int64_t(a_bytes) * BITS_PER_BYTE * 1000000 + m_baudrate - 1) / m_baudrate);
+  }
+
+  /// @brief 通信時間を積算し, realtime指定時は実際に待つ.
+  void spend_us(uint32_t a_us)
+  {
+    m_bus_us += a_us;
+    if (m_realtime)
+    {
+      delayMicroseconds(a_us);
+    }
+  }
+
+  /// @brief 送信のみ行い返信が来なかった場合の処理.
+  bool timeout(byte a_tx_len)
+  {
+    spend_us(wire_us(a_tx_len) + uint32_t(m_timeout_ms) * 1000);
+    m_timeout_count++;
+    return false;
+  }
+
+  /// @brief フレームを解釈して返信を作る.
+  /// @return 正しい返信を作れた場合はtrue. 未対応のコマンドや返信長の不一致はfalse.
+  bool respond(SimServo &a_sv, const byte *a_tx, byte a_tx_len, byte *a_rx, byte a_rx_len)
+  {
+    const byte cmd = a_tx[0] & 0xE0;
+    a_rx[0] = a_tx[0] & 0x7F;
+    if (cmd == 0x80 && a_tx_len == 3 && a_rx_len == 3)
+    { // ポジション指定(0で脱力). 返信は移動前の現在位置
+      const uint16_t pos_tmp = (uint16_t(a_tx[1]) << 7) | a_tx[2];
+      a_rx[1] = (a_sv.pos >> 7) & 0x7F;
+      a_rx[2] = a_sv.pos & 0x7F;
+      a_sv.free = (pos_tmp == 0);
+      if (!a_sv.free)
+      {
+        a_sv.tgt = pos_tmp;
+        const int diff = int(a_sv.tgt) - int(a_sv.pos);
+        a_sv.pos += (diff > a_sv.slew) ? a_sv.slew : (diff < -a_sv.slew) ? -a_sv.slew : diff;
+      }
+      return true;
+    }
+    if (cmd == 0xA0 && a_tx_len == 2)
+    { // パラメータ読込
+      const byte sc = a_tx[1];
+      a_rx[1] = sc;
+      if (sc == 0x05 && a_rx_len == 4 && !a_sv.ics35)
+      {
+        a_rx[2] = (a_sv.pos >> 7) & 0x7F;
+        a_rx[3] = a_sv.pos & 0x7F;
+        return true;
+      }
+      if (sc >= 0x01 && sc <= 0x04 && a_rx_len == 3)
+      {
+        const uint8_t vals[4] = {a_sv.strc, a_sv.spd, a_sv.cur, a_sv.tmp};
+        a_rx[2] = vals[sc - 1];
+        return true;
+      }
+      return false;
+    }
+    if (cmd == 0xC0 && a_tx_len == 3 && a_rx_len == 3)
+    { // パラメータ書込
+      const byte sc = a_tx[1];
+      uint8_t *vals[4] = {&a_sv.strc, &a_sv.spd, &a_sv.cur, &a_sv.tmp};
+      if (sc < 0x01 || sc > 0x04)
+      {
+        return false;
+      }
+      *vals[sc - 1] = a_tx[2];
+      a_rx[1] = sc;
+      a_rx[2] = a_tx[2];
+      return true;
+    }
+    return false;
+  }
+
+public:
+  /// @brief コンストラクタ.
+  /// @param a_baudrate 仮想バスの通信速度(bps).
+  /// @param a_timeout_ms 返信待ちのタイムアウト時間(ms).
+  IcsSimBusClass(long a_baudrate, int a_timeout_ms) : m_baudrate(a_baudrate), m_timeout_ms(a_timeout_ms) {}
+
+  /// @brief 実機と同じ時間だけ待つかどうかを設定する. falseなら通信時間はbus_us()に積算するのみ.
+  void set_realtime(bool a_realtime) { m_realtime = a_realtime; }
+
+  /// @brief 仮想サーボを取り付ける.
+  /// @param a_id サーボID.
+  /// @param a_latency_us 返信遅延(us).
+  /// @param a_ics35 ICS3.5として振る舞うか.
+  void mount(byte a_id, uint16_t a_latency_us = 100, bool a_ics35 = false)
+  {
+    if (a_id <= MAX_ID)
+    {
+      m_servo[a_id] = SimServo();
+      m_servo[a_id].mounted = true;
+      m_servo[a_id].latency_us = a_latency_us;
+      m_servo[a_id].ics35 = a_ics35;
+    }
+  }
+
+  /// @brief 仮想サーボの状態を参照する. 温度や電流の値を直接書き換えて試験に使う.
+  SimServo &servo(byte a_id) { return m_servo[a_id & MAX_ID]; }
+
+  /// @brief 指定したサーボの次のa_count回の通信をタイムアウトさせる.
+  void inject_timeout(byte a_id, uint16_t a_count) { servo(a_id).timeout_cnt = a_count; }
+
+  /// @brief 指定したサーボの次のa_count回の返信を化けさせる.
+  void inject_corrupt(byte a_id, uint16_t a_count) { servo(a_id).corrupt_cnt = a_count; }
+
+  /// @brief タイムアウトと返信化けを確率で発生させる.
+  /// @param a_timeout_permil 1000回あたりのタイムアウト数.
+  /// @param a_corrupt_permil 1000回あたりの返信化け数.
+  /// @param a_seed 乱数の種(0以外). 同じ種なら同じ順に発生する.
+  void set_fault_rate(uint16_t a_timeout_permil, uint16_t a_corrupt_permil, uint32_t a_seed)
+  {
+    m_timeout_permil = a_timeout_permil;
+    m_corrupt_permil = a_corrupt_permil;
+    m_seed = a_seed ? a_seed : 1;
+  }
+
+  /// @brief 積算した通信時間と統計をリセットする.
+  void reset_stats()
+  {
+    m_bus_us = 0;
+    m_tx_count = 0;
+    m_timeout_count = 0;
+    m_corrupt_count = 0;
+  }
+
+  uint64_t bus_us() const { return m_bus_us; }              // 積算通信時間(us)
+  uint32_t tx_count() const { return m_tx_count; }          // 送信フレーム数
+  uint32_t timeout_count() const { return m_timeout_count; } // タイムアウト数
+  uint32_t corrupt_count() const { return m_corrupt_count; } // 返信化け数
+
+  /// @brief ICS通信の送受信を仮想サーボで置き換える.
+  /// @return 指定数の返信を受け取れた場合はtrue. 化けた返信もtrueを返す(実機の通信クラスと同じ).
+  virtual bool synchronize(byte *txBuf, byte txLen, byte *rxBuf, byte rxLen) override
+  {
+    m_tx_count++;
+    if (txLen == 0 || rxLen == 0)
+    {
+      return timeout(txLen);
+    }
+    SimServo &sv_tmp = m_servo[txBuf[0] & MAX_ID];
+    if (!sv_tmp.mounted || (sv_tmp.ics35 && (txBuf[0] & 0xE0) == 0xA0 && txLen > 1 && txBuf[1] == 0x05))
+    {
+      return timeout(txLen);
+    }
+    if (sv_tmp.timeout_cnt > 0)
+    {
+      sv_tmp.timeout_cnt--;
+      return timeout(txLen);
+    }
+    if (m_timeout_permil && rand_next() % 1000 < m_timeout_permil)
+    {
+      return timeout(txLen);
+    }
+    if (!respond(sv_tmp, txBuf, txLen, rxBuf, rxLen))
+    {
+      return timeout(txLen);
+    }
+
+    bool corrupt = false;
+    if (sv_tmp.corrupt_cnt > 0)
+    {
+      sv_tmp.corrupt_cnt--;
+      corrupt = true;
+    }
+    else if (m_corrupt_permil && rand_next() % 1000 < m_corrupt_permil)
+    {
+      corrupt = true;
+    }
+    if (corrupt)
+    { // データ部の1bitを反転する
+      const uint32_t r = rand_next();
+      rxBuf[1 + r % (rxLen - 1)] ^= byte(1 << ((r >> 8) % 7));
+      m_corrupt_count++;
+    }
+
+    spend_us(wire_us(txLen) + sv_tmp.latency_us + wire_us(rxLen));
+    return true;
+  }
+};
+
+#endif // __MERIDIAN_SERVO_KONDO_ICS_SIM_H__
@@ -4,6 +4,8 @@
 // ヘッダファイルの読み込み
 #include "config.h"
 #include "main.h"
+#include "mrd_module/mv_keyframe.h"
+#include "mrd_module/mv_profiler.h"
 
 //==================================================================================================
 //  動作計算関連の処理
@@ -24,19 +24,19 @@
 ///         失敗またはSDカードがマウントされていない場合はfalseを返す.
 bool mrd_sd_init(bool a_sd_mount, int a_sd_chipselect_pin) {
   if (a_sd_mount) {
-    Serial.print("Initializing SD card... ");
+    serial_pc.print("Initializing SD card... ");
     // delay(100);
     if (!SD.begin(a_sd_chipselect_pin)) {
-      Serial.println("Card failed, or not present.");
+      serial_pc.println("Card failed, or not present.");
       // delay(100);
       return false;
     } else {
-      Serial.println("OK.");
+      serial_pc.println("OK.");
       // delay(100);
       return true;
     }
   }
-  Serial.println("SD not mounted.");
+  serial_pc.println("SD not mounted.");
   // delay(100);
   return false;
 }
@@ -58,13 +58,13 @@ bool mrd_sd_check(bool a_sd_mount, int a_sd_chipselect_pin, bool a_sd_check_rw)
     delay(1); // SPI安定化検証用
 
     if (sd_file) {
-      Serial.print("Checking SD card r/w... ");
+      serial_pc.print("Checking SD card r/w... ");
       // SD書き込みテスト用のランダムな4桁の数字を生成
       randomSeed(long(analogRead(A0))); // 未接続ピンのノイズを利用
       int rand_number_tmp = random(1000, 9999);
 
-      Serial.print("write code ");
-      Serial.print(rand_number_tmp);
+      serial_pc.print("write code ");
+      serial_pc.print(rand_number_tmp);
       // ファイルへの書き込みを実行
       sd_file.println(rand_number_tmp);
       delayMicroseconds(1); // SPI安定化検証用
@@ -73,9 +73,9 @@ bool mrd_sd_check(bool a_sd_mount, int a_sd_chipselect_pin, bool a_sd_check_rw)
       // ファイルからの読み込みを実行
       sd_file = SD.open("/test.txt");
       if (sd_file) {
-        Serial.print(" and read code ");
+        serial_pc.print(" and read code ");
         while (sd_file.available()) {
-          Serial.write(sd_file.read());
+          serial_pc.write(sd_file.read());
         }
         sd_file.close();
       }
@@ -83,7 +83,7 @@ bool mrd_sd_check(bool a_sd_mount, int a_sd_chipselect_pin, bool a_sd_check_rw)
       delay(10);
       return true;
     } else {
-      Serial.println("Could not open SD test.txt file.");
+      serial_pc.println("Could not open SD test.txt file.");
       return false;
     }
   } else {
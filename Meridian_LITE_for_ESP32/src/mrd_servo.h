@@ -4,7 +4,11 @@
 // ヘッダファイルの読み込み
 #include "config.h"
 #include "main.h"
+#include "mrd_module/sv_discover.h"
+#include "mrd_module/sv_dxl2.h"
+#include "mrd_module/sv_estimator.h"
 #include "mrd_module/sv_ftbrx.h"
+#include "mrd_module/sv_health.h"
 #include "mrd_module/sv_ics.h"
 
 //==================================================================================================
@@ -21,6 +25,10 @@
 /// @return サーボがサポートされている場合はtrueを, サポートされていない場合はfalseを返す.
 bool mrd_servo_begin(UartLine a_line, int a_servo_type)
 {
+  if (a_line == C && a_servo_type != KOICS3)
+  { // C系統はICSのみ対応
+    return false;
+  }
   switch (a_servo_type)
   {
   case 1:
@@ -30,19 +38,28 @@ bool mrd_servo_begin(UartLine a_line, int a_servo_type)
     // I2C_PCA9685 to PWM [WIP]
     return false;
   case 21:
-    // RSxTTL (FUTABA) [WIP]
-    return false;
+    return mrd_sv_ftbrx_begin(a_line); // RSxTTL (FUTABA)
   case 31:
     // DYNAMIXEL Protocol 1.0 [WIP]
     return false;
   case 32:
-    // DYNAMIXEL Protocol 2.0 [WIP]
-    return false;
+    return mrd_sv_dxl2_begin(a_line); // DYNAMIXEL Protocol 2.0
   case 43:
+    if (MODE_SERVO_SIM)
+      return true; // 仮想バスはmrd_ics_sim_beginで設定する
     if (a_line == L)
       ics_L.begin(); // サーボモータの通信初期設定. Serial2
     else if (a_line == R)
       ics_R.begin(); // サーボモータの通信初期設定. Serial3
+#if MOUNT_SERVO_LINE_C
+    else if (a_line == C)
+    { // UART0のピンを割り当て直して使う
+      SERVO_SERIAL_C.begin(SERVO_BAUDRATE_C, SERIAL_8E1, PIN_RX_C, PIN_TX_C);
+      SERVO_SERIAL_C.setTimeout(SERVO_TIMEOUT_C);
+      pinMode(PIN_EN_C, OUTPUT);
+      digitalWrite(PIN_EN_C, LOW);
+    }
+#endif
     return true;
   case 44:
     // PMX(KONDO) [WIP]
@@ -63,90 +80,289 @@ bool mrd_servo_begin(UartLine a_line, int a_servo_type)
 }
 
 //------------------------------------------------------------------------------------
-//  サーボ通信フォーメーションの分岐
+//  プロトコル別グループ
 //------------------------------------------------------------------------------------
+// 起動時に各系統のマウント済みスロットをサーボの種類(IXL_MT, IXR_MT)ごとにまとめ,
+// 毎フレームそれぞれのグループを最も効率のよい一括処理で駆動する.
+// 1系統に複数の種類がある場合は, グループの切替時にUARTをその種類の設定で開き直す.
 
-/// @brief 指定されたサーボにコマンドを分配する.
-/// @param a_meridim サーボの動作パラメータを含むMeridim配列.
-/// @param a_L_type L系統のサーボタイプ.
-/// @param a_R_type R系統のサーボタイプ.
+#define MRD_SERVO_GROUPS_MAX 8 // グループ数の上限
+
+// 同じ系統・同じ種類のサーボのグループ
+struct ServoGroup
+{
+  UartLine line = L;  // 系統
+  int type = NOSERVO; // サーボの種類
+  uint32_t mask = 0;  // 含まれるインデックスのビットセット
+};
+
+// グループの一覧
+struct ServoGroupTable
+{
+  ServoGroup grp[MRD_SERVO_GROUPS_MAX];              // グループ
+  int num = 0;                                       // グループ数
+  int active[MRD_SERVO_LINES] = {NOSERVO, NOSERVO}; // 各系統のUARTが現在開いている種類
+};
+ServoGroupTable sv_groups;
+
+/// @brief マウント済みのスロットを系統と種類ごとのグループにまとめる.
 /// @param a_sv サーボパラメータの構造体.
-/// @return サーボの駆動が成功した場合はtrueを, 失敗した場合はfalseを返す.
-bool mrd_servo_drive_lite(Meridim90Union &a_meridim, int a_L_type, int a_R_type, ServoParam &a_sv)
+/// @return グループ数.
+int mrd_servo_group_build(const ServoParam &a_sv)
+{
+  ServoGroupTable tbl_tmp;
+  memcpy(tbl_tmp.active, sv_groups.active, sizeof(tbl_tmp.active)); // 開いているUARTの種類は引き継ぐ
+  sv_groups = tbl_tmp;
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
+  {
+    uint32_t bits_tmp = a_sv.mount[line];
+    while (bits_tmp)
+    {
+      const int i = __builtin_ctz(bits_tmp);
+      bits_tmp &= bits_tmp - 1;
+      const int type = a_sv.type[line][i];
+      int g = 0;
+      while (g < sv_groups.num && !(sv_groups.grp[g].line == line && sv_groups.grp[g].type == type))
+      {
+        g++;
+      }
+      if (g == sv_groups.num)
+      { // 新しいグループ
+        if (sv_groups.num >= MRD_SERVO_GROUPS_MAX)
+        {
+          continue;
+        }
+        sv_groups.grp[g].line = UartLine(line);
+        sv_groups.grp[g].type = type;
+        sv_groups.num++;
+      }
+      sv_groups.grp[g].mask |= (1UL << i);
+    }
+  }
+  return sv_groups.num;
+}
+
+/// @brief 指定した系統と種類のグループのビットセットを返す.
+/// @param a_line サーボの系統.
+/// @param a_type サーボの種類.
+/// @return グループのビットセット. グループがない場合は0.
+uint32_t mrd_servo_group_mask(UartLine a_line, int a_type)
+{
+  for (int g = 0; g < sv_groups.num; g++)
+  {
+    if (sv_groups.grp[g].line == a_line && sv_groups.grp[g].type == a_type)
+    {
+      return sv_groups.grp[g].mask;
+    }
+  }
+  return 0;
+}
+
+/// @brief 系統のUARTを指定した種類のサーボ用に開く. すでに開いている場合は何もしない.
+/// @param a_line サーボの系統.
+/// @param a_type サーボの種類.
+/// @return サーボがサポートされている場合はtrueを, サポートされていない場合はfalseを返す.
+bool mrd_servo_group_select(UartLine a_line, int a_type)
 {
-  if (a_L_type == 43 && a_R_type == 43) // ICSサーボがL系R系に設定されていた場合はLR均等送信を実行
+  if (sv_groups.active[a_line] == a_type)
   {
-    mrd_sv_drive_ics_double(a_meridim, a_sv);
     return true;
   }
-  else
+  if (!mrd_servo_begin(a_line, a_type))
   {
     return false;
   }
+  sv_groups.active[a_line] = a_type;
+  return true;
 }
 
 //------------------------------------------------------------------------------------
-//  各種オペレーション
+//  C系統のバスタスク
 //------------------------------------------------------------------------------------
+// C系統はCore0のタスクで駆動し, Core1でのL,R系統の送受信と同時に進める.
+// 各系統が書き込むのはServoParamの自系統の要素のみなので, 受け渡しは開始の通知と完了のセマフォで足りる.
 
-/// @brief 第一引数のMeridim配列のすべてのサーボモーターをオフ(フリー状態)に設定する.
-/// @param a_meridim サーボの動作パラメータを含むMeridim配列.
-/// @return 設定完了時にtrueを返す.
-bool mrd_servo_all_off(Meridim90Union &a_meridim)
+#if MOUNT_SERVO_LINE_C
+// C系統のタスクとの受け渡し
+struct ServoLineCTask
+{
+  Meridim90Union *meridim = nullptr; // 駆動するMeridim配列
+  ServoParam *sv = nullptr;          // サーボパラメータ
+  uint32_t mask = 0;                 // 駆動するICSサーボのビットセット
+  SemaphoreHandle_t done = nullptr;  // 1フレーム分の駆動完了
+};
+ServoLineCTask sv_task_c;
+
+/// @brief C系統のICSサーボを駆動するタスク. mrd_servo_line_c_kickの通知ごとに1フレーム分を処理する.
+void Core0_servo_c_r(void *args)
+{
+  while (true)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    mrd_sv_drive_ics_line(*sv_task_c.meridim, *sv_task_c.sv, C, sv_task_c.mask, mrd_ics_bus(C));
+    xSemaphoreGive(sv_task_c.done);
+  }
+}
+
+/// @brief C系統にICSサーボがマウントされていればCore0にバスタスクを作成する.
+/// @return タスクを作成した場合はtrue.
+bool mrd_servo_line_c_task_begin()
 {
-  for (int i = 0; i < 15; i++)
-  {                                 // 15はサーボ数
-    a_meridim.sval[i * 2 + 20] = 0; // サーボのコマンドをオフに設定
-    a_meridim.sval[i * 2 + 50] = 0; //
+  sv_task_c.mask = mrd_servo_group_mask(C, KOICS3);
+  if (sv_task_c.mask == 0)
+  {
+    return false;
   }
-  Serial.println("All servos torque off.");
+  sv_task_c.done = xSemaphoreCreateBinary();
+  xTaskCreatePinnedToCore(Core0_servo_c_r, "Core0_servo_c_r", 4096, NULL, 4, &thp[3], 0);
   return true;
 }
 
-/// @brief サーボパラメータからエラーのあるサーボのインデックス番号を作る.
+/// @brief C系統のバスタスクに1フレーム分の駆動を開始させる.
+/// @return 開始した場合はtrue. この場合は必ずmrd_servo_line_c_waitで完了を待つこと.
+bool mrd_servo_line_c_kick(Meridim90Union &a_meridim, ServoParam &a_sv)
+{
+  if (sv_task_c.done == nullptr)
+  {
+    return false;
+  }
+  sv_task_c.meridim = &a_meridim;
+  sv_task_c.sv = &a_sv;
+  sv_task_c.mask = mrd_servo_group_mask(C, KOICS3);
+  xTaskNotifyGive(thp[3]);
+  return true;
+}
+
+/// @brief C系統のバスタスクの駆動完了を待つ.
+void mrd_servo_line_c_wait()
+{
+  xSemaphoreTake(sv_task_c.done, portMAX_DELAY);
+}
+#endif
+
+//------------------------------------------------------------------------------------
+//  サーボ通信フォーメーションの分岐
+//------------------------------------------------------------------------------------
+
+/// @brief 指定されたサーボにコマンドを分配する.
+///        ICSのグループはLR交互に1サーボずつ送受信し, gs2d対応のグループは1パケットの同期書込みで駆動する.
+/// @param a_meridim サーボの動作パラメータを含むMeridim配列.
 /// @param a_sv サーボパラメータの構造体.
-/// @return uint8_tで番号を返す.
-///         100-149(L系統 0-49),200-249(R系統 0-49)
-uint8_t mrd_servo_make_errcode_lite(ServoParam a_sv)
+/// @return サーボの駆動が成功した場合はtrueを, 未対応のサーボの種類があればfalseを返す.
+bool mrd_servo_drive_lite(Meridim90Union &a_meridim, ServoParam &a_sv)
 {
-  uint8_t servo_ix_tmp = 0;
-  for (int i = 0; i < 15; i++)
+  bool rslt = true;
+
+#if MOUNT_SERVO_LINE_C
+  // C系統はCore0のタスクでL,R系統と並行して駆動する
+  const bool c_kick = mrd_servo_line_c_kick(a_meridim, a_sv);
+#endif
+
+  // ICSのグループはL系R系をまとめて均等送信
+  const uint32_t ics_l = mrd_servo_group_mask(L, KOICS3);
+  const uint32_t ics_r = mrd_servo_group_mask(R, KOICS3);
+  if (ics_l || ics_r)
   {
-    if (a_sv.ixl_stat[i])
+    if (ics_l)
     {
-      servo_ix_tmp = uint8_t(i + 100);
+      mrd_servo_group_select(L, KOICS3);
     }
-    if (a_sv.ixr_stat[i])
+    if (ics_r)
     {
-      servo_ix_tmp = uint8_t(i + 200);
+      mrd_servo_group_select(R, KOICS3);
     }
+    mrd_sv_drive_ics_double(a_meridim, a_sv, ics_l, ics_r, mrd_ics_port(L), mrd_ics_port(R));
   }
-  return servo_ix_tmp;
-}
 
-float mrd_servo_move_limit(float a_previous, float a_current, float a_limit)
-{
-  float diff = a_current - a_previous;
+  // その他のグループは系統ごとに一括処理
+  for (int g = 0; g < sv_groups.num; g++)
+  {
+    const ServoGroup &grp = sv_groups.grp[g];
+    if (grp.type == KOICS3)
+    {
+      continue;
+    }
+    if (grp.line == C)
+    { // C系統はICSのみ対応
+      rslt = false;
+      continue;
+    }
+    if (!mrd_servo_group_select(grp.line, grp.type))
+    {
+      rslt = false;
+      continue;
+    }
+    switch (grp.type)
+    {
+    case DXL2:
+      mrd_sv_drive_dxl2(a_meridim, a_sv, grp.line, grp.mask);
+      break;
+    case FTBRSX:
+      mrd_sv_drive_ftbrx(a_meridim, a_sv, grp.line, grp.mask);
+      break;
+    default:
+      rslt = false;
+      break;
+    }
+  }
 
-  if (fabs(diff) <= a_limit)
+#if MOUNT_SERVO_LINE_C
+  if (c_kick)
   {
-    // 移動量が制限値以下の場合、そのまま目標値を返す
-    return a_current;
+    mrd_servo_line_c_wait();
   }
-  else
+#endif
+  return rslt;
+}
+
+//------------------------------------------------------------------------------------
+//  各種オペレーション
+//------------------------------------------------------------------------------------
+
+/// @brief 第一引数のMeridim配列のすべてのサーボモーターをオフ(フリー状態)に設定する.
+/// @param a_meridim サーボの動作パラメータを含むMeridim配列.
+/// @return 設定完了時にtrueを返す.
+bool mrd_servo_all_off(Meridim90Union &a_meridim)
+{
+  for (int line = 0; line < MRD_SERVO_LINES; line++)
   {
-    // 移動量が制限値を超える場合、制限値分だけ移動
-    if (diff > 0)
-    {
-      // 正方向への移動
-      return a_previous + a_limit;
-    }
-    else
+    for (int i = 0; i < MRD_SERVO_SLOTS; i++)
     {
-      // 負方向への移動
-      return a_previous - a_limit;
+      a_meridim.sval[MRD_SV_ORIGIDX[line] + i * 2] = 0; // サーボのコマンドをオフに設定
     }
   }
+  serial_pc.println("All servos torque off.");
+  return true;
+}
+
+/// @brief サーボパラメータからエラーのあるサーボのインデックス番号を作る.
+///        複数ある場合はインデックスの最も大きいもの(同じインデックスではR系統)を返す.
+///        すべてのエラーサーボはmrd_servo_put_errbitsでビットマップとして出力できる.
+/// @param a_sv サーボパラメータの構造体.
+/// @return uint8_tで番号を返す.
+///         100-149(L系統 0-49),200-249(R系統 0-49)
+uint8_t mrd_servo_make_errcode_lite(const ServoParam &a_sv)
+{
+  const int l_tmp = a_sv.err[L] ? 31 - __builtin_clz(a_sv.err[L]) : -1;
+  const int r_tmp = a_sv.err[R] ? 31 - __builtin_clz(a_sv.err[R]) : -1;
+  if (r_tmp >= 0 && r_tmp >= l_tmp)
+  {
+    return uint8_t(r_tmp + 200);
+  }
+  if (l_tmp >= 0)
+  {
+    return uint8_t(l_tmp + 100);
+  }
+  return 0;
+}
+
+/// @brief 通信不能なサーボのビットマップをMeridim配列に格納する.
+/// @param a_meridim 格納先のMeridim配列.
+/// @param a_sv サーボパラメータの構造体.
+void mrd_servo_put_errbits(Meridim90Union &a_meridim, const ServoParam &a_sv)
+{
+  a_meridim.usval[MRD_SERVO_ERR_L] = uint16_t(a_sv.err[L]);
+  a_meridim.usval[MRD_SERVO_ERR_R] = uint16_t(a_sv.err[R]);
 }
 
 #endif // __MERIDIAN_SERVO_DISTRIBUTOR_H__
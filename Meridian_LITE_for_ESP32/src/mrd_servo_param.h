@@ -0,0 +1,118 @@
+#ifndef __MERIDIAN_SERVO_PARAM_H__
+#define __MERIDIAN_SERVO_PARAM_H__
+
+#include "config.h"
+#include "mrd_module/ics_affine.h"
+
+#include <stdint.h>
+
+//==================================================================================================
+//  Meridim配列とサーボパラメータの型
+//==================================================================================================
+// Arduinoに依存しないため, サーボ駆動の処理(mrd_module/sv_ics_drive.h)と合わせてPC上の試験にも使う.
+// 実体(s_udp_meridim, sv等)はmain.hにある.
+
+//------------------------------------------------------------------------------------
+//  列挙型
+//------------------------------------------------------------------------------------
+
+enum UartLine
+{    // サーボ系統の列挙型(L,R,C)
+  L, // Left
+  R, // Right
+  C  // Center
+};
+
+enum ServoType
+{               // サーボプロトコルのタイプ
+  NOSERVO = 0,  // サーボなし
+  PWM_S = 1,    // Single PWM (WIP)
+  PCA9685 = 11, // I2C_PCA9685 to PWM (WIP)
+  FTBRSX = 21,  // FUTABA_RSxTTL (WIP)
+  DXL1 = 31,    // DYNAMIXEL 1.0 (WIP)
+  DXL2 = 32,    // DYNAMIXEL 2.0 (WIP)
+  KOICS3 = 43,  // KONDO_ICS 3.5 / 3.6
+  KOPMX = 44,   // KONDO_PMX (WIP)
+  JRXBUS = 51,  // JRPROPO_XBUS (WIP)
+  FTCSTS = 61,  // FEETECH_STS (WIP)
+  FTCSCS = 62   // FEETECH_SCS (WIP)
+};
+
+//------------------------------------------------------------------------------------
+//  変数
+//------------------------------------------------------------------------------------
+
+const int MRDM_BYTE = MRDM_LEN * 2; // Meridim配列のバイト型の長さ
+
+// 各サーボ系統のMeridim配列における最初のインデックス
+#if MOUNT_SERVO_LINE_C
+static_assert(MRD_C_ORIGIDX + MRD_SERVO_SLOTS * 2 <= MRDM_LEN - 2, "C系統がMeridim配列に収まらない");
+const int MRD_SV_ORIGIDX[MRD_SERVO_LINES] = {MRD_L_ORIGIDX, MRD_R_ORIGIDX, MRD_C_ORIGIDX};
+#else
+const int MRD_SV_ORIGIDX[MRD_SERVO_LINES] = {MRD_L_ORIGIDX, MRD_R_ORIGIDX};
+#endif
+
+//------------------------------------------------------------------------------------
+//  クラス・構造体・共用体
+//------------------------------------------------------------------------------------
+
+// Meridim配列用の共用体の設定
+typedef union
+{
+  short sval[MRDM_LEN + 4];           // short型で90個の配列データを持つ
+  unsigned short usval[MRDM_LEN + 2]; // 上記のunsigned short型
+  uint8_t bval[+4];                   // byte型で180個の配列データを持つ
+  uint8_t ubval[MRDM_BYTE + 4];       // 上記のunsigned byte型
+} Meridim90Union;
+
+// サーボパラメータ
+// 配列の添字は[系統(UartLine)][サーボのインデックス]. 系統ごとに連続した配列で持つ.
+// マウント, 通信不能, 返信なしの状態は系統ごとに32bitのビットセットで持つ(bit nがインデックスnのサーボ).
+struct ServoParam
+{
+  // サーボの最大接続 (サーボ送受信のループ処理数)
+  int num_max;
+
+  // 各サーボの状態のビットセット
+  uint32_t mount[MRD_SERVO_LINES] = {0}; // マウントあり(config.hまたはEEPROMで設定)
+  uint32_t err[MRD_SERVO_LINES] = {0};   // 通信不能(連続エラーがSERVO_LOST_ERR_WAITに到達)
+  uint32_t stale[MRD_SERVO_LINES] = {0}; // 今回のフレームで返信なし(値は前回の目標値で代用)
+  uint32_t synced[MRD_SERVO_LINES] = {0}; // 最後に送った目標値(sent)がサーボに受理されている
+
+  // 各サーボのベンダーと型番(config.hで設定)
+  uint8_t type[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};
+
+  // 各サーボのコード上のインデックスに対し, 実際に呼び出すハードウェアのID番号(config.hで設定)
+  uint8_t id[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};
+
+  // 各サーボの正逆方向補正用配列(config.hで設定)
+  int8_t cw[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};
+
+  // 各サーボの直立ポーズトリム値(config.hで設定)
+  float trim[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};
+
+  // ICSサーボの角度変換係数(トリム値の変更時にmrd_servo_ics_affine_updateで再計算)
+  IcsAffine ics[MRD_SERVO_LINES][MRD_SERVO_SLOTS];
+
+  // 各サーボのポジション値(degree*100, Meridimと同じ単位)
+  int16_t tgt[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};      // 目標値
+  int16_t tgt_past[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}}; // 前回の値
+
+  // サーボの連続エラーカウンタ配列
+  uint8_t err_cnt[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};
+
+  // 送信省略(SERVO_DIRTY_SKIP)用
+  int16_t deadband[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}}; // 不感帯(degree*100, config.hで設定)
+  int16_t sent[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};     // 最後に受理された目標値(degree*100)
+  uint8_t idle_cnt[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}}; // 送信を省略した連続フレーム数
+
+  // 最後にサーボから現在位置の返信を受け取った時刻(us, SERVO_ESTIMATORで使用)
+  uint32_t rx_us[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};
+
+  // 各サーボの動作プロファイルの上限値(config.hの既定値, またはEEPROMの[2][*]で設定)
+  float vel_max[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};  // 最大速度(degree*100/frame)
+  float acc_max[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}};  // 最大加速度(degree*100/frame^2)
+  float jerk_max[MRD_SERVO_LINES][MRD_SERVO_SLOTS] = {{0}}; // 最大躍度(degree*100/frame^3)
+};
+
+#endif // __MERIDIAN_SERVO_PARAM_H__
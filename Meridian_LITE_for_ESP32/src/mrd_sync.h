@@ -0,0 +1,122 @@
+#ifndef __MERIDIAN_SYNC_H__
+#define __MERIDIAN_SYNC_H__
+
+#include <atomic>
+#include <stdint.h>
+
+//==================================================================================================
+//  コア間のデータ受け渡し  ----------------------------------------------------------------------
+//==================================================================================================
+// 書き込み側1スレッド, 読み込み側1スレッドでデータ一式を受け渡すトリプルバッファ.
+// 書き込み側はback()に一式を書いてからpublish()で公開し, 読み込み側はupdate()で最新の一式に切り替えてから
+// front()を読む. どちらも待ち(ロックやリトライ)がなく, 読み込み側が参照する一式は書き込み途中の値を含まない.
+// 3面のうち書き込み中, 読み込み中, 受け渡し待ちの各1面を1つのアトミック変数で交換する.
+// Arduino/FreeRTOSに依存しないため, PC上のスレッドでもそのまま動作を確認できる.
+
+template <typename T>
+class MrdTripleBuffer
+{
+public:
+  MrdTripleBuffer() : m_middle(1), m_back(2), m_front(0) {}
+
+  /// @brief 書き込み側: 次に公開する一式の書き込み先. 前回の公開以前の内容が残っている.
+  T &back() { return m_buf[m_back]; }
+
+  /// @brief 書き込み側: back()に書いた一式を公開し, 書き込み先を空いた面に切り替える.
+  void publish()
+  {
+    const uint8_t prev = m_middle.exchange(uint8_t(m_back | DIRTY), std::memory_order_acq_rel);
+    m_back = prev & INDEX_MASK;
+  }
+
+  /// @brief 書き込み側: 一式をコピーして公開する.
+  void write(const T &a_val)
+  {
+    back() = a_val;
+    publish();
+  }
+
+  /// @brief 読み込み側: 未読の一式があればfront()をそれに切り替える.
+  /// @return 切り替えた場合はtrue. 新しい一式がなければfalseで, front()は前回のまま.
+  bool update()
+  {
+    if (!(m_middle.load(std::memory_order_relaxed) & DIRTY))
+    {
+      return false;
+    }
+    const uint8_t prev = m_middle.exchange(m_front, std::memory_order_acq_rel);
+    m_front = prev & INDEX_MASK;
+    return true;
+  }
+
+  /// @brief 読み込み側: 最後にupdate()で切り替えた一式. 次のupdate()まで書き換えられない.
+  const T &front() const { return m_buf[m_front]; }
+
+  /// @brief 読み込み側: 最新の一式をコピーする.
+  /// @return 前回の読み込みから新しい一式があった場合はtrue.
+  bool read(T &a_out)
+  {
+    const bool fresh = update();
+    a_out = front();
+    return fresh;
+  }
+
+private:
+  static const uint8_t INDEX_MASK = 0x03;
+  static const uint8_t DIRTY = 0x04; // 受け渡し待ちの面が未読
+
+  T m_buf[3] = {};
+  std::atomic<uint8_t> m_middle; // 受け渡し待ちの面の番号と未読フラグ
+  uint8_t m_back;                // 書き込み側だけが使う面の番号
+  uint8_t m_front;               // 読み込み側だけが使う面の番号
+};
+
+// 書き込み側1スレッド, 読み込み側1スレッドで1件ずつ順に受け渡す固定長のリングバッファ.
+// 書き込み側はpush()で末尾に追加し, 読み込み側はpop()で先頭から取り出す. 位置は通し番号で持ち, 長さNで割った余りを
+// 添字にする. 満杯の場合は古いものを上書きせず新しいものを捨て, 捨てた数を数える.
+template <typename T, uint32_t N>
+class MrdSpscRing
+{
+  static_assert(N > 0 && (N & (N - 1)) == 0, "MrdSpscRing length must be a power of 2");
+
+public:
+  /// @brief 書き込み側: 1件追加する.
+  /// @return 追加した場合はtrue. 満杯の場合は追加せずにfalse.
+  bool push(const T &a_val)
+  {
+    const uint32_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= N)
+    {
+      m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    m_buf[head & (N - 1)] = a_val;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief 読み込み側: 先頭の1件を取り出す.
+  /// @return 取り出した場合はtrue. 空の場合はfalse.
+  bool pop(T &a_out)
+  {
+    const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    a_out = m_buf[tail & (N - 1)];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief 満杯で捨てた件数の累計.
+  uint32_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+  T m_buf[N] = {};
+  std::atomic<uint32_t> m_head{0};    // 次に書き込む通し番号(書き込み側だけが更新)
+  std::atomic<uint32_t> m_tail{0};    // 次に読み込む通し番号(読み込み側だけが更新)
+  std::atomic<uint32_t> m_dropped{0}; // 満杯で捨てた件数(書き込み側だけが更新)
+};
+
+#endif // __MERIDIAN_SYNC_H__
@@ -152,8 +152,8 @@ const char *mrd_get_line_name(UartLine a_line) {
 /// @param a_led ERROR通知用のLEDのピン番号.
 /// @param a_msg エラーメッセージ.
 /// @param a_serial 出力先シリアルの指定.
-void mrd_error_stop(int a_led, String a_msg, HardwareSerial &a_serial) {
-  Serial.println(a_msg);
+void mrd_error_stop(int a_led, String a_msg, Stream &a_serial) {
+  serial_pc.println(a_msg);
   while (1) {
     digitalWrite(a_led, HIGH);
     delay(250);
@@ -21,7 +21,7 @@ WiFiUDP udp; // wifi設定
 /// @param a_serial 出力先シリアルの指定.
 /// @return 初期化に成功した場合はtrueを, 失敗した場合はfalseを返す.
 bool mrd_wifi_init(WiFiUDP &a_udp, const char *a_ssid, const char *a_pass,
-                   HardwareSerial &a_serial) {
+                   Stream &a_serial) {
   WiFi.disconnect(true, true); // 新しい接続のためにWiFi接続をリセット
   delay(100);
   WiFi.begin(a_ssid, a_pass); // Wifiに接続
@@ -60,12 +60,13 @@ bool mrd_wifi_udp_receive(byte *a_meridim_bval, int a_len, WiFiUDP &a_udp) {
 /// @param a_meridim_bval バイト型のMeridim配列
 /// @param a_len バイト型のMeridim配列の長さ
 /// @param a_udp 使用するWiFiUDPのインスタンス
+/// @param a_send_port 送信先ポート番号. 省略時はUDP_SEND_PORT.
 /// @return 送信完了時にtrueを返す.
-/// ※WIFI_SEND_IP, UDP_SEND_PORTを関数内で使用.
-bool mrd_wifi_udp_send(byte *a_meridim_bval, int a_len, WiFiUDP &a_udp) {
-  a_udp.beginPacket(WIFI_SEND_IP, UDP_SEND_PORT); // UDPパケットの開始
-  a_udp.write(a_meridim_bval, a_len);             // データの書き込み
-  a_udp.endPacket();                              // UDPパケットの終了
+/// ※WIFI_SEND_IPを関数内で使用.
+bool mrd_wifi_udp_send(byte *a_meridim_bval, int a_len, WiFiUDP &a_udp, int a_send_port = UDP_SEND_PORT) {
+  a_udp.beginPacket(WIFI_SEND_IP, a_send_port); // UDPパケットの開始
+  a_udp.write(a_meridim_bval, a_len);           // データの書き込み
+  a_udp.endPacket();                            // UDPパケットの終了
   return true;
 }
 
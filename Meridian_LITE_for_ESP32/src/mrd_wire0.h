@@ -4,6 +4,11 @@
 // ヘッダファイルの読み込み
 #include "config.h"
 #include "main.h"
+#include "mrd_eeprom.h"
+#include "mrd_module/ahrs_filter.h"
+#include "mrd_module/ahrs_mahony.h"
+#include "mrd_module/i2c_bus.h"
+#include "mrd_module/imu_batch.h"
 
 // ライブラリ導入
 #include <Wire.h>
@@ -21,7 +26,7 @@
 /// @param a_pinSDA SDAのピン番号. 下記と合わせて省略可.
 /// @param a_pinSCL SCLのピン番号. 上記と合わせて省略可.
 bool mrd_wire0_init_i2c(int a_i2c0_speed, int a_pinSDA = -1, int a_pinSCL = -1) {
-  Serial.print("Initializing wire0 I2C... ");
+  serial_pc.print("Initializing wire0 I2C... ");
   if (a_pinSDA == -1 && a_pinSCL == -1) {
     Wire.begin();
   } else {
@@ -53,26 +58,62 @@ bool mrd_wire0_init_mpu6050_dmp(AhrsValue &a_ahrs) {
     a_ahrs.mpu6050.CalibrateGyro(6);
     a_ahrs.mpu6050.setDMPEnabled(true);
     a_ahrs.packetSize = a_ahrs.mpu6050.dmpGetFIFOPacketSize();
-    Serial.println("MPU6050 OK.");
+    serial_pc.println("MPU6050 OK.");
     return true;
   }
-  Serial.println("IMU/AHRS DMP Initialization FAILED!");
+  serial_pc.println("IMU/AHRS DMP Initialization FAILED!");
   return false;
 }
 
+/// @brief MPU6050センサーをDMPを使わず生値を読む設定で初期化する.
+/// ジャイロ±2000dps, 加速度±8g, デジタルローパス98Hz, サンプリング1kHz.
+/// @param a_ahrs AHRSの値を保持する構造体.
+/// @return 初期化が成功した場合はtrue, 失敗した場合はfalseを返す.
+bool mrd_wire0_init_mpu6050_raw(AhrsValue &a_ahrs) {
+  a_ahrs.mpu6050.initialize();
+  if (!a_ahrs.mpu6050.testConnection()) {
+    serial_pc.println("IMU/AHRS MPU6050 connection FAILED!");
+    return false;
+  }
+  a_ahrs.mpu6050.setXAccelOffset(-1745);
+  a_ahrs.mpu6050.setYAccelOffset(-1034);
+  a_ahrs.mpu6050.setZAccelOffset(966);
+  a_ahrs.mpu6050.setXGyroOffset(176);
+  a_ahrs.mpu6050.setYGyroOffset(-6);
+  a_ahrs.mpu6050.setZGyroOffset(-25);
+  a_ahrs.mpu6050.setFullScaleGyroRange(MPU6050_GYRO_FS_2000);
+  a_ahrs.mpu6050.setFullScaleAccelRange(MPU6050_ACCEL_FS_8);
+  a_ahrs.mpu6050.setDLPFMode(MPU6050_DLPF_BW_98);
+  a_ahrs.mpu6050.setRate(0); // 1kHz / (1 + 0)
+  a_ahrs.mpu6050.CalibrateAccel(6);
+  a_ahrs.mpu6050.CalibrateGyro(6);
+  serial_pc.println("MPU6050 OK (raw mode).");
+  return true;
+}
+
 /// @brief BNO055センサーの初期化を試みます.
 /// @param a_ahrs AHRSの値を保持する構造体.
 /// @return BNO055センサーの初期化が成功した場合はtrue, それ以外の場合はfalseを返す.
 ///         現在, この関数は常にfalseを返すように設定されています.
 bool mrd_wire0_init_bno055(AhrsValue &a_ahrs) {
   if (!a_ahrs.bno.begin()) {
-    Serial.println("No BNO055 detected ... Check your wiring or I2C ADDR!");
+    serial_pc.println("No BNO055 detected ... Check your wiring or I2C ADDR!");
     return false;
   } else {
-    Serial.println("BNO055 mounted.");
+    serial_pc.println("BNO055 mounted.");
     delay(50);
     a_ahrs.bno.setExtCrystalUse(false);
     delay(10);
+#if BNO055_CALIB_LOAD
+    // 保存済みのキャリブレーション値を書き戻し, 起動直後から補正済みの値で推定させる
+    uint8_t offsets[BNO055_OFFSETS_LEN];
+    if (mrd_eeprom_load_bno055_offsets(offsets)) {
+      a_ahrs.bno.setSensorOffsets(offsets);
+      serial_pc.println("BNO055 calibration loaded from EEPROM.");
+    } else {
+      serial_pc.println("BNO055 calibration not saved in EEPROM.");
+    }
+#endif
     return true;
   }
   // データの取得はセンサー用スレッドで実行
@@ -98,7 +139,7 @@ bool mrd_wire0_setup(ImuAhrsType a_imuahrs_type, int a_i2c0_speed, AhrsValue &a_
 
   if (a_imuahrs_type == MPU6050_IMU) // MPU6050
   {
-    return mrd_wire0_init_mpu6050_dmp(a_ahrs);
+    return MPU6050_RAW_FUSION ? mrd_wire0_init_mpu6050_raw(a_ahrs) : mrd_wire0_init_mpu6050_dmp(a_ahrs);
   } else if (a_imuahrs_type == MPU9250_IMU) // MPU9250の場合
   {
     // mrd_wire_init_mpu9250_dmp(a_ahrs)
@@ -108,7 +149,7 @@ bool mrd_wire0_setup(ImuAhrsType a_imuahrs_type, int a_i2c0_speed, AhrsValue &a_
     return mrd_wire0_init_bno055(a_ahrs);
   }
 
-  Serial.println("No IMU/AHRS sensor mounted.");
+  serial_pc.println("No IMU/AHRS sensor mounted.");
   return false;
 }
 
@@ -116,68 +157,292 @@ bool mrd_wire0_setup(ImuAhrsType a_imuahrs_type, int a_i2c0_speed, AhrsValue &a_
 //  センサデータの取得処理
 //------------------------------------------------------------------------------------
 
-/// @brief bno055からI2C経由でデータを読み取るスレッド用関数. IMUAHRS_INTERVALの間隔で実行する.
+// BNO055のデータレジスタ 0x08(ACC_DATA_X_LSB)から0x35(CALIB_STAT)までの連続領域
+#define BNO055_BURST_LEN (Adafruit_BNO055::BNO055_CALIB_STAT_ADDR - Adafruit_BNO055::BNO055_ACCEL_DATA_X_LSB_ADDR + 1)
+
+// ライブラリ経由の読込はWireを直接使うため, I2Cの管理スレッドと併用できない
+static_assert(!(I2C_BUS_MANAGER && MOUNT_IMUAHRS == BNO055_AHRS && !BNO055_BURST_READ),
+              "I2C_BUS_MANAGER requires BNO055_BURST_READ");
+
+/// @brief レジスタ番号を書いてから連続して読み込む. I2Cの管理スレッドが動作中の場合は高優先度で依頼する.
+/// @param a_xfer 管理スレッドへの依頼に使う構造体(mrd_i2c_xfer_init済み).
+/// @param a_addr 7bitアドレス.
+/// @param a_reg 先頭のレジスタ番号.
+/// @param a_buf 読込先.
+/// @param a_len 読み込むバイト数.
+/// @param a_timeout_us 管理スレッドでの実行開始の期限(今からのus).
+/// @return 全バイトを読み込めた場合はtrue.
+bool mrd_wire0_read_reg(I2cXfer &a_xfer, uint8_t a_addr, uint8_t a_reg, uint8_t *a_buf, uint8_t a_len,
+                        uint32_t a_timeout_us) {
+  if (i2c_bus.active) {
+    return mrd_i2c_read_reg(a_xfer, a_addr, a_reg, a_buf, a_len, I2C_PRIO_HIGH, a_timeout_us) == I2C_XFER_OK;
+  }
+  Wire.beginTransmission(a_addr);
+  Wire.write(a_reg);
+  if (Wire.endTransmission(false) != 0) {
+    return false;
+  }
+  if (Wire.requestFrom(a_addr, a_len) != a_len) {
+    return false;
+  }
+  for (int i = 0; i < a_len; i++) {
+    a_buf[i] = Wire.read();
+  }
+  return true;
+}
+
+/// @brief 1バイトのレジスタに書き込む. I2Cの管理スレッドが動作中の場合は高優先度で依頼する.
+/// @param a_xfer 管理スレッドへの依頼に使う構造体(mrd_i2c_xfer_init済み).
+/// @param a_addr 7bitアドレス.
+/// @param a_reg レジスタ番号.
+/// @param a_val 書き込む値.
+/// @param a_timeout_us 管理スレッドでの実行開始の期限(今からのus).
+/// @return 書き込めた場合はtrue.
+bool mrd_wire0_write_reg(I2cXfer &a_xfer, uint8_t a_addr, uint8_t a_reg, uint8_t a_val, uint32_t a_timeout_us) {
+  if (i2c_bus.active) {
+    a_xfer.addr = a_addr;
+    a_xfer.wbuf[0] = a_reg;
+    a_xfer.wbuf[1] = a_val;
+    a_xfer.wlen = 2;
+    a_xfer.rlen = 0;
+    if (!mrd_i2c_submit(a_xfer, I2C_PRIO_HIGH, a_timeout_us)) {
+      return false;
+    }
+    return mrd_i2c_wait(a_xfer) == I2C_XFER_OK;
+  }
+  Wire.beginTransmission(a_addr);
+  Wire.write(a_reg);
+  Wire.write(a_val);
+  return Wire.endTransmission() == 0;
+}
+
+/// @brief BNO055のデータレジスタ(加速度からキャリブレーション状態まで)を1回のI2C通信で読み込む.
+/// I2Cの管理スレッドでは読み取り周期を期限とする.
+/// @param a_xfer 管理スレッドへの依頼に使う構造体(mrd_i2c_xfer_init済み).
+/// @param a_buf 読込先. BNO055_BURST_LENバイト.
+/// @return 全バイトを読み込めた場合はtrue.
+bool mrd_wire0_bno055_burst(I2cXfer &a_xfer, uint8_t *a_buf) {
+  return mrd_wire0_read_reg(a_xfer, BNO055_I2C_ADDR, Adafruit_BNO055::BNO055_ACCEL_DATA_X_LSB_ADDR, a_buf,
+                            BNO055_BURST_LEN, IMUAHRS_INTERVAL * 1000);
+}
+
+/// @brief リトルエンディアンの符号付き16bitレジスタ値を換算する.
+inline float mrd_wire0_bno055_s16(const uint8_t *a_p, float a_scale) {
+  return float(int16_t(a_p[0] | (a_p[1] << 8))) * a_scale;
+}
+
+/// @brief ヨー軸のソースデータを保持し, 補正センターからの角度(-180~180)を返す.
+float mrd_wire0_ahrs_yaw(float a_heading) {
+  ahrs.yaw_source = a_heading; // ヨー軸のソースデータ保持
+  float yaw_tmp = a_heading - ahrs.yaw_origin;
+  if (yaw_tmp >= 180) {
+    yaw_tmp = yaw_tmp - 360;
+  } else if (yaw_tmp < -180) {
+    yaw_tmp = yaw_tmp + 360;
+  }
+  return yaw_tmp;
+}
+
+/// @brief まとめて読んだBNO055のデータレジスタを計測値一式に換算する.
+/// 単位はAdafruit_BNO055::getVector()と同じ(加速度 m/s^2, ジャイロ dps, 磁力 uT, 角度 degree).
+/// @param a_buf mrd_wire0_bno055_burst()で読んだBNO055_BURST_LENバイト.
+/// @param a_sample 格納先の計測値一式.
+void mrd_wire0_bno055_decode(const uint8_t *a_buf, AhrsSample &a_sample) {
+  const uint8_t *acc = a_buf;      // 0x08 ACC_DATA  1m/s^2 = 100LSB
+  const uint8_t *mag = a_buf + 6;  // 0x0E MAG_DATA  1uT = 16LSB
+  const uint8_t *gyr = a_buf + 12; // 0x14 GYR_DATA  1dps = 16LSB
+  const uint8_t *eul = a_buf + 18; // 0x1A EUL_DATA  heading,roll,pitch 1degree = 16LSB
+  const uint8_t *qua = a_buf + 24; // 0x20 QUA_DATA  w,x,y,z 1 = 2^14LSB
+  const uint8_t *lia = a_buf + 32; // 0x28 LIA_DATA  1m/s^2 = 100LSB
+  const uint8_t *grv = a_buf + 38; // 0x2E GRV_DATA  1m/s^2 = 100LSB
+  for (int k = 0; k < 3; k++) {
+    a_sample.read[k] = mrd_wire0_bno055_s16(acc + k * 2, 1.0f / 100);
+    a_sample.read[3 + k] = mrd_wire0_bno055_s16(gyr + k * 2, 1.0f / 16);
+    a_sample.read[6 + k] = mrd_wire0_bno055_s16(mag + k * 2, 1.0f / 16);
+    a_sample.read[9 + k] = mrd_wire0_bno055_s16(grv + k * 2, 1.0f / 100);
+    a_sample.lin_acc[k] = mrd_wire0_bno055_s16(lia + k * 2, 1.0f / 100);
+  }
+  for (int k = 0; k < 4; k++) {
+    a_sample.quat[k] = mrd_wire0_bno055_s16(qua + k * 2, 1.0f / (1 << 14));
+  }
+  a_sample.read[12] = mrd_wire0_bno055_s16(eul + 2, 1.0f / 16);                 // DMP_ROLL推定値
+  a_sample.read[13] = mrd_wire0_bno055_s16(eul + 4, 1.0f / 16);                 // DMP_PITCH推定値
+  a_sample.read[14] = mrd_wire0_ahrs_yaw(mrd_wire0_bno055_s16(eul, 1.0f / 16)); // DMP_YAW推定値
+  a_sample.read[15] = float(int8_t(a_buf[44]));                                 // 0x34 TEMP 1℃ = 1LSB
+  a_sample.calib = a_buf[45];                                                   // 0x35 CALIB_STAT
+}
+
+// BNO055のキャリブレーション値の保存. オフセットレジスタは設定モードでしか読めないため,
+// I2Cを使うセンサ用スレッドがモードを切り替えて読み, loop()側がEEPROMに書き込む.
+#define BNO055_MODE_CONFIG 0x00 // OPR_MODEの設定モード
+#define BNO055_MODE_NDOF 0x0C   // OPR_MODEの9軸フュージョンモード(Adafruit_BNO055::begin()の既定)
+#define BNO055_CALIB_FULL 0xFF  // CALIB_STATのシステム, ジャイロ, 加速度, 地磁気が全て3(完了)
+
+// キャリブレーション値の保存依頼の状態
+enum Bno055CalibState {
+  BNO055_CALIB_IDLE = 0, // 依頼なし
+  BNO055_CALIB_REQ = 1,  // loop()からセンサ用スレッドへ読込を依頼中
+  BNO055_CALIB_READ = 2, // 読込済み. loop()でEEPROMに書き込む
+  BNO055_CALIB_NG = 3    // キャリブレーション未完了または通信失敗で読み込めなかった
+};
+
+// キャリブレーション値の保存依頼. stateの更新でoffsetsとstatを受け渡す
+struct Bno055Calib {
+  std::atomic<uint8_t> state{BNO055_CALIB_IDLE}; // Bno055CalibState
+  uint8_t stat = 0;                              // 読込時のCALIB_STAT
+  uint8_t offsets[BNO055_OFFSETS_LEN] = {0};     // オフセットレジスタ0x55~0x6Aの値
+};
+Bno055Calib bno055_calib;
+
+/// @brief キャリブレーション値の保存を依頼する. loop()側から呼ぶ.
+/// @return 依頼を受け付けた場合はtrue. 前の依頼が処理中の場合はfalse.
+bool mrd_wire0_bno055_calib_request() {
+  uint8_t expected = BNO055_CALIB_IDLE;
+  return bno055_calib.state.compare_exchange_strong(expected, BNO055_CALIB_REQ, std::memory_order_relaxed);
+}
+
+/// @brief 保存の依頼があれば, キャリブレーションの完了を確かめてオフセットレジスタを読む.
+/// センサ用スレッドから毎サンプル呼ぶ. 設定モードの間(約40ms)は計測値を公開しない.
+void mrd_wire0_bno055_calib_service(I2cXfer &a_xfer) {
+  if (bno055_calib.state.load(std::memory_order_relaxed) != BNO055_CALIB_REQ) {
+    return;
+  }
+  const uint32_t timeout_us = IMUAHRS_INTERVAL * 1000;
+  bool ok = mrd_wire0_read_reg(a_xfer, BNO055_I2C_ADDR, Adafruit_BNO055::BNO055_CALIB_STAT_ADDR, &bno055_calib.stat,
+                               1, timeout_us) &&
+            bno055_calib.stat == BNO055_CALIB_FULL;
+  if (ok) {
+    ok = mrd_wire0_write_reg(a_xfer, BNO055_I2C_ADDR, Adafruit_BNO055::BNO055_OPR_MODE_ADDR, BNO055_MODE_CONFIG,
+                             timeout_us);
+    vTaskDelay(pdMS_TO_TICKS(25)); // フュージョンモードから設定モードへの切り替え(19ms)
+    ok = ok && mrd_wire0_read_reg(a_xfer, BNO055_I2C_ADDR, Adafruit_BNO055::ACCEL_OFFSET_X_LSB_ADDR,
+                                  bno055_calib.offsets, BNO055_OFFSETS_LEN, timeout_us);
+    mrd_wire0_write_reg(a_xfer, BNO055_I2C_ADDR, Adafruit_BNO055::BNO055_OPR_MODE_ADDR, BNO055_MODE_NDOF,
+                        timeout_us);
+    vTaskDelay(pdMS_TO_TICKS(20)); // 設定モードからフュージョンモードへの切り替え(7ms)
+  }
+  bno055_calib.state.store(ok ? BNO055_CALIB_READ : BNO055_CALIB_NG, std::memory_order_release);
+}
+
+/// @brief センサ用スレッドが読んだキャリブレーション値をEEPROMに書き込む. loop()から毎フレーム呼ぶ.
+/// @param a_serial 出力先シリアルの指定.
+void mrd_wire0_bno055_calib_poll(Stream &a_serial) {
+  const uint8_t state = bno055_calib.state.load(std::memory_order_acquire);
+  if (state == BNO055_CALIB_READ) {
+    if (mrd_eeprom_save_bno055_offsets(bno055_calib.offsets, a_serial)) {
+      a_serial.println("BNO055 calibration saved to EEPROM.");
+    } else {
+      a_serial.println("BNO055 calibration save failed.");
+    }
+  } else if (state == BNO055_CALIB_NG) {
+    a_serial.print("BNO055 not fully calibrated. CALIB_STAT:");
+    a_serial.println(bno055_calib.stat, HEX);
+  } else {
+    return;
+  }
+  bno055_calib.state.store(BNO055_CALIB_IDLE, std::memory_order_relaxed);
+}
+
+hw_timer_t *imuahrs_timer = NULL; // IMU/AHRSの読み取り周期用のハードウェアタイマー
+
+/// @brief IMU/AHRSの読み取り周期ごとにセンサ用スレッド(thp[0])を起こす割り込み関数.
+void IRAM_ATTR mrd_wire0_imuahrs_timer() {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(thp[0], &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+/// @brief センサ用スレッドの読み取り周期をハードウェアタイマーで開始する. スレッドの作成後に呼ぶ.
+/// 周期はI2C通信にかかる時間によらず一定になる.
+/// @param a_period_us 読み取り周期(us).
+void mrd_wire0_timer_begin(uint32_t a_period_us) {
+  imuahrs_timer = timerBegin(IMUAHRS_TIMER, 80, true); // 分周比80で1us単位
+  timerAttachInterrupt(imuahrs_timer, &mrd_wire0_imuahrs_timer, true);
+  timerAlarmWrite(imuahrs_timer, a_period_us, true);
+  timerAlarmEnable(imuahrs_timer);
+}
+
+/// @brief bno055からI2C経由でデータを読み取るスレッド用関数. IMUAHRS_INTERVALごとのタイマー通知で実行する.
+/// 計測値は一式をahrs_sampleの書き込み面に揃えてから公開し, loop()側で値が混ざらないようにする.
+/// BNO055_BURST_READが1の場合はデータレジスタを1回のI2C通信で読み, 読込に失敗した回は公開しない.
 void mrd_wire0_Core0_bno055_r(void *args) {
+  uint32_t seq = 0;
+  I2cXfer xfer;
+  mrd_i2c_xfer_init(xfer);
+#if BNO055_BURST_READ
+  uint8_t buf[BNO055_BURST_LEN];
+#endif
   while (1) {
+    // タイマーの通知を待つ(通知が途絶えた場合もIMUAHRS_INTERVALの2倍で読み取りを続ける)
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IMUAHRS_INTERVAL * 2));
+    mrd_wire0_bno055_calib_service(xfer); // キャリブレーション値の保存依頼
+    AhrsSample &sample = ahrs_sample.back();
+    sample.t_us = micros(); // 計測時刻
+#if BNO055_BURST_READ
+    if (!mrd_wire0_bno055_burst(xfer, buf)) {
+      continue;
+    }
+    mrd_wire0_bno055_decode(buf, sample);
+#else
     // 加速度センサ値の取得と表示 - VECTOR_ACCELEROMETER - m/s^2
     imu::Vector<3> accelerometer = ahrs.bno.getVector(Adafruit_BNO055::VECTOR_ACCELEROMETER);
-    ahrs.read[0] = (float)accelerometer.x();
-    ahrs.read[1] = (float)accelerometer.y();
-    ahrs.read[2] = (float)accelerometer.z();
+    sample.read[0] = (float)accelerometer.x();
+    sample.read[1] = (float)accelerometer.y();
+    sample.read[2] = (float)accelerometer.z();
 
-    // ジャイロセンサ値の取得 - VECTOR_GYROSCOPE - rad/s
+    // ジャイロセンサ値の取得 - VECTOR_GYROSCOPE - dps
     imu::Vector<3> gyroscope = ahrs.bno.getVector(Adafruit_BNO055::VECTOR_GYROSCOPE);
-    ahrs.read[3] = gyroscope.x();
-    ahrs.read[4] = gyroscope.y();
-    ahrs.read[5] = gyroscope.z();
+    sample.read[3] = gyroscope.x();
+    sample.read[4] = gyroscope.y();
+    sample.read[5] = gyroscope.z();
 
     // 磁力センサ値の取得と表示  - VECTOR_MAGNETOMETER - uT
     imu::Vector<3> magnetometer = ahrs.bno.getVector(Adafruit_BNO055::VECTOR_MAGNETOMETER);
-    ahrs.read[6] = magnetometer.x();
-    ahrs.read[7] = magnetometer.y();
-    ahrs.read[8] = magnetometer.z();
+    sample.read[6] = magnetometer.x();
+    sample.read[7] = magnetometer.y();
+    sample.read[8] = magnetometer.z();
 
     // センサフュージョンによる方向推定値の取得と表示 - VECTOR_EULER - degrees
     imu::Vector<3> euler = ahrs.bno.getVector(Adafruit_BNO055::VECTOR_EULER);
-    ahrs.read[12] = euler.y();                   // DMP_ROLL推定値
-    ahrs.read[13] = euler.z();                   // DMP_PITCH推定値
-    ahrs.yaw_source = euler.x();                 // ヨー軸のソースデータ保持
-    float yaw_tmp = euler.x() - ahrs.yaw_origin; // DMP_YAW推定値
-    if (yaw_tmp >= 180) {
-      yaw_tmp = yaw_tmp - 360;
-    } else if (yaw_tmp < -180) {
-      yaw_tmp = yaw_tmp + 360;
+    sample.read[12] = euler.y();                     // DMP_ROLL推定値
+    sample.read[13] = euler.z();                     // DMP_PITCH推定値
+    sample.read[14] = mrd_wire0_ahrs_yaw(euler.x()); // DMP_YAW推定値
+#endif
+    ahrs.ypr[0] = sample.read[14];
+    ahrs.ypr[1] = sample.read[13];
+    ahrs.ypr[2] = sample.read[12];
+    if (IMU_BATCH_SEND) {
+      mrd_imu_batch_push(sample); // 一括送信用のリング
     }
-    ahrs.read[14] = yaw_tmp; // DMP_YAW推定値
-    ahrs.ypr[0] = ahrs.read[14];
-    ahrs.ypr[1] = ahrs.read[13];
-    ahrs.ypr[2] = ahrs.read[12];
+    mrd_ahrs_filter_run(ahrs_filter, sample.read); // フィルタバンク
+    sample.seq = ++seq;
+    ahrs_sample.publish();
 
     // センサフュージョンの方向推定値のクオータニオン
     // imu::Quaternion quat = bno.getQuat();
 
-    // Serial.print("qW: ");
-    // Serial.print(quat.w(), 4);
-    // Serial.print(" qX: ");
-    // Serial.print(quat.x(), 4);
-    // Serial.print(" qY: ");
-    // Serial.print(quat.y(), 4);
-    // Serial.print(" qZ: ");
-    // Serial.println(quat.z(), 4);
+    // serial_pc.print("qW: ");
+    // serial_pc.print(quat.w(), 4);
+    // serial_pc.print(" qX: ");
+    // serial_pc.print(quat.x(), 4);
+    // serial_pc.print(" qY: ");
+    // serial_pc.print(quat.y(), 4);
+    // serial_pc.print(" qZ: ");
+    // serial_pc.println(quat.z(), 4);
 
     // キャリブレーションのステータスの取得と表示
     // uint8_t system, gyro, accel, mag = 0;
     // bno.getCalibration(&system, &gyro, &accel, &mag);
-    // Serial.print("CALIB Sys:");
-    // Serial.print(system, DEC);
-    // Serial.print(", Gy");
-    // Serial.print(gyro, DEC);
-    // Serial.print(", Ac");
-    // Serial.print(accel, DEC);
-    // Serial.print(", Mg");
-    // Serial.println(mag, DEC);
-
-    delay(IMUAHRS_INTERVAL);
+    // serial_pc.print("CALIB Sys:");
+    // serial_pc.print(system, DEC);
+    // serial_pc.print(", Gy");
+    // serial_pc.print(gyro, DEC);
+    // serial_pc.print(", Ac");
+    // serial_pc.print(accel, DEC);
+    // serial_pc.print(", Mg");
+    // serial_pc.println(mag, DEC);
   }
 }
 
@@ -236,16 +501,105 @@ bool mrd_wire0_read_ahrs_i2c(AhrsValue &a_ahrs) { // ※wireTimer0.beginの引
   }
 }
 
+/// @brief MPU6050の加速度, 温度, ジャイロの生値をACCEL_XOUT_H(0x3B)から14バイトまとめて読む.
+/// @param a_xfer 管理スレッドへの依頼に使う構造体(mrd_i2c_xfer_init済み).
+/// @param a_raw 格納先. acc_x,y,z, gyro_x,y,z, tempの順.
+/// @return 読み込めた場合はtrue.
+bool mrd_wire0_mpu6050_motion(I2cXfer &a_xfer, int16_t a_raw[7]) {
+  uint8_t buf[14];
+  if (!mrd_wire0_read_reg(a_xfer, MPU6050_I2C_ADDR, 0x3B, buf, 14, MPU6050_RAW_PERIOD)) {
+    return false;
+  }
+  const int order[7] = {0, 1, 2, 4, 5, 6, 3}; // レジスタ順(acc, temp, gyro)から格納順へ
+  for (int k = 0; k < 7; k++) {
+    a_raw[k] = int16_t((buf[order[k] * 2] << 8) | buf[order[k] * 2 + 1]); // ビッグエンディアン
+  }
+  return true;
+}
+
+/// @brief MPU6050の生値をI2C経由で読み, Mahonyフィルタで姿勢を推定するスレッド用関数.
+/// MPU6050_RAW_PERIODごとのタイマー通知で実行し, 毎回の推定結果をahrs_sampleに公開する.
+/// 加速度はm/s^2, ジャイロはdps, 角度はdegreeでBNO055と同じ並び. 地磁気は0.
+void mrd_wire0_Core0_mpu6050_r(void *args) {
+  const float acc_scale = 9.80665f / 4096.0f; // ±8g: 4096LSB/g
+  const float gyro_scale = 1.0f / 16.4f;      // ±2000dps: 16.4LSB/dps
+  MahonyFilter filter;
+  uint32_t seq = 0;
+  uint32_t t_prev = micros();
+  int16_t raw[7];
+  float rpy[3];
+  float grav[3];
+  I2cXfer xfer;
+  mrd_i2c_xfer_init(xfer);
+  while (1) {
+    // タイマーの通知を待つ(通知が途絶えた場合も読み取りを続ける)
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MPU6050_RAW_PERIOD / 500 + 1));
+    AhrsSample &sample = ahrs_sample.back();
+    sample.t_us = micros(); // 計測時刻
+    if (!mrd_wire0_mpu6050_motion(xfer, raw)) {
+      continue;
+    }
+    const float dt = (sample.t_us - t_prev) * 1e-6f;
+    t_prev = sample.t_us;
+
+    for (int k = 0; k < 3; k++) {
+      sample.read[k] = raw[k] * acc_scale;
+      sample.read[3 + k] = raw[3 + k] * gyro_scale;
+      sample.read[6 + k] = 0;
+    }
+    mrd_mahony_update(filter, sample.read[3] * DEG_TO_RAD, sample.read[4] * DEG_TO_RAD, sample.read[5] * DEG_TO_RAD,
+                      sample.read[0], sample.read[1], sample.read[2], dt);
+
+    mrd_mahony_euler(filter, rpy);
+    mrd_mahony_gravity(filter, grav);
+    for (int k = 0; k < 3; k++) {
+      sample.read[9 + k] = grav[k] * 9.80665f;
+      sample.lin_acc[k] = sample.read[k] - sample.read[9 + k];
+    }
+    for (int k = 0; k < 4; k++) {
+      sample.quat[k] = filter.q[k];
+    }
+    sample.read[12] = rpy[0];                      // ROLL推定値
+    sample.read[13] = rpy[1];                      // PITCH推定値
+    sample.read[14] = mrd_wire0_ahrs_yaw(rpy[2]);  // YAW推定値
+    sample.read[15] = raw[6] / 340.0f + 36.53f;    // 温度(℃)
+    if (IMU_BATCH_SEND) {
+      mrd_imu_batch_push(sample); // 一括送信用のリング
+    }
+    mrd_ahrs_filter_run(ahrs_filter, sample.read); // フィルタバンク
+    sample.seq = ++seq;
+    ahrs_sample.publish();
+  }
+}
+
+/// @brief センサ用スレッドがahrs_sampleに計測値を公開するセンサか.
+inline bool mrd_wire0_ahrs_threaded(int a_type) {
+  return a_type == BNO055_AHRS || (a_type == MPU6050_IMU && MPU6050_RAW_FUSION);
+}
+
 //------------------------------------------------------------------------------------
 //  meriput
 //------------------------------------------------------------------------------------
 
+/// @brief 送信するAHRSの計測値の計測からの経過時間をMeridimに格納する. Meridimの確定直前に呼ぶ.
+/// PC側でセンサの遅れを補正するための値で, 単位は0.1ms. 計測値がない場合は65535.
+/// @param a_meridim 格納先のMeridim配列.
+/// @param a_sample meriput90_ahrsで格納した計測値一式.
+/// @param a_type 使用するセンサのタイプ.
+void meriput90_ahrs_age(Meridim90Union &a_meridim, const AhrsSample &a_sample, int a_type) {
+  if (!mrd_wire0_ahrs_threaded(a_type)) {
+    return;
+  }
+  const uint32_t age = (micros() - a_sample.t_us) / 100;
+  a_meridim.usval[MRD_IMU_AGE] = (a_sample.seq == 0 || age > 65535) ? 65535 : uint16_t(age);
+}
+
 /// @brief 指定されたIMU/AHRSタイプに基づいて, 計測したAHRSデータを読み込む.
 /// @param a_type 使用するセンサのタイプを示す列挙(MPU6050, MPU9250, BNO055).
 /// @param a_ahrs_result AHRSから読み取った結果を格納した配列.
 /// @return データの書き込みが成功した場合はtrue, それ以外の場合はfalseを返す.
-bool meriput90_ahrs(Meridim90Union &a_meridim, float a_ahrs_result[], int a_type) {
-  if (a_type == BNO055_AHRS) {
+bool meriput90_ahrs(Meridim90Union &a_meridim, const float a_ahrs_result[], int a_type) {
+  if (mrd_wire0_ahrs_threaded(a_type)) {
     flg.imuahrs_available = false;
     a_meridim.sval[2] = mrd.float2HfShort(a_ahrs_result[0]);   // IMU/AHRS_acc_x
     a_meridim.sval[3] = mrd.float2HfShort(a_ahrs_result[1]);   // IMU/AHRS_acc_y
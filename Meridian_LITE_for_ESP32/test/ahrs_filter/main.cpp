@@ -0,0 +1,225 @@
+// AHRSのフィルタバンク(ahrs_filter.h)の確認
+//
+// チャンネルごとに なし / 3点メディアン / 移動平均(窓8, IMUAHRS_STOCK) / メディアン+移動平均 / 2次ローパス を設定し,
+// 1000を中心とするノイズ(メディアンを設定したチャンネルには単発のスパイクを混ぜる)を通して,
+// doubleで素直に計算した基準値と比較する.
+// 続けて, ローパスの直流ゲインが1, カットオフ周波数でのゲインが1/√2であることを正弦波の振幅で確認し,
+// 16チャンネル1サンプルあたりの処理時間を計測する. 許容値を超えた場合は1を返す.
+//
+// ビルドと実行(Meridian_LITE_for_ESP32で):
+//   g++ -std=c++17 -O2 -I src test/ahrs_filter/main.cpp -o ahrs_filter && ./ahrs_filter
+
+#include "config.h"
+#include "mrd_module/ahrs_filter.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define SAMPLE_NUM   200000 // 基準値と比較するサンプル数
+#define TOL_STAGE    1e-3   // 基準値との差の許容値(入力は1000±1)
+#define TOL_LPF      1e-2   // ローパスの基準値との差の許容値(floatの状態変数の丸め誤差が極で増幅される)
+#define TOL_GAIN     0.01   // ローパスのゲインの許容差
+#define LPF_RATE_HZ  1000.0 // ローパスの確認に使うサンプリング周波数(Hz)
+#define LPF_CUTOFF   20.0   // ローパスの確認に使うカットオフ周波数(Hz)
+#define BENCH_NUM    1000000 // 処理時間の計測のサンプル数
+
+// チャンネルの割り当て
+enum TestChannel
+{
+  CH_NONE = 0,    // なし
+  CH_MEDIAN = 1,  // 3点メディアンのみ
+  CH_AVE8 = 2,    // 移動平均(窓8)
+  CH_AVE_MAX = 3, // 移動平均(窓IMUAHRS_STOCK)
+  CH_MED_AVE = 4, // 3点メディアン + 移動平均(窓8)
+  CH_LPF = 5,     // 2次ローパス
+  CH_MED_LPF = 6  // 3点メディアン + 2次ローパス
+};
+
+/// @brief doubleで素直に計算する1チャンネルの基準実装. mrd_ahrs_filter_primeと同じく最初の入力で履歴を埋める.
+struct RefChannel
+{
+  bool median = false;                          // 3点メディアンの有無
+  int window = 0;                               // 移動平均の窓の長さ(0はなし)
+  bool lpf = false;                             // 2次ローパスの有無
+  double b0 = 0, b1 = 0, b2 = 0, a1 = 0, a2 = 0; // ローパスの係数(設定と同じ値)
+  std::vector<double> in;                       // メディアン後の入力の履歴
+  double m1 = 0, m2 = 0;                        // メディアン用の1つ前, 2つ前の入力
+  double x1 = 0, x2 = 0;                        // ローパスの入力の履歴(直接形I)
+  double y1 = 0, y2 = 0;                        // ローパスの出力の履歴
+
+  double run(double a_x)
+  {
+    if (in.empty())
+    { // 定常状態から始める
+      m1 = m2 = a_x;
+      x1 = x2 = y1 = y2 = a_x;
+    }
+    double v = a_x;
+    if (median)
+    {
+      v = std::max(std::min(a_x, m1), std::min(std::max(a_x, m1), m2));
+    }
+    m2 = m1;
+    m1 = a_x;
+    if (in.empty())
+    {
+      in.assign(IMUAHRS_STOCK, v);
+    }
+    in.push_back(v);
+    if (window > 0)
+    {
+      double s = 0;
+      for (int k = 0; k < window; k++)
+      {
+        s += in[in.size() - 1 - k];
+      }
+      v = s / window;
+    }
+    if (lpf)
+    {
+      const double y = b0 * v + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+      x2 = x1;
+      x1 = v;
+      y2 = y1;
+      y1 = y;
+      v = y;
+    }
+    return v;
+  }
+};
+
+/// @brief 各段の出力を基準実装と比較する.
+/// @return 異常がなければtrue.
+bool test_stages()
+{
+  AhrsFilterConfig cfg;
+  mrd_ahrs_filter_set_median(cfg, CH_MEDIAN, true);
+  mrd_ahrs_filter_set_ave(cfg, CH_AVE8, 8);
+  mrd_ahrs_filter_set_ave(cfg, CH_AVE_MAX, IMUAHRS_STOCK);
+  mrd_ahrs_filter_set_median(cfg, CH_MED_AVE, true);
+  mrd_ahrs_filter_set_ave(cfg, CH_MED_AVE, 8);
+  mrd_ahrs_filter_set_lpf(cfg, CH_LPF, LPF_CUTOFF, LPF_RATE_HZ);
+  mrd_ahrs_filter_set_median(cfg, CH_MED_LPF, true);
+  mrd_ahrs_filter_set_lpf(cfg, CH_MED_LPF, LPF_CUTOFF, LPF_RATE_HZ);
+  ahrs_filter_cfg.write(cfg);
+
+  RefChannel ref[AHRS_FILTER_CH];
+  for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+  {
+    ref[ch].median = cfg.median[ch];
+    ref[ch].window = (cfg.mode[ch] == AHRS_FILT_AVE) ? cfg.window[ch] : 0;
+    ref[ch].lpf = (cfg.mode[ch] == AHRS_FILT_LPF);
+    ref[ch].b0 = cfg.b0[ch];
+    ref[ch].b1 = cfg.b1[ch];
+    ref[ch].b2 = cfg.b2[ch];
+    ref[ch].a1 = cfg.a1[ch];
+    ref[ch].a2 = cfg.a2[ch];
+  }
+
+  AhrsFilterBank bank;
+  std::mt19937 rng(44);
+  std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+  double err_max[AHRS_FILTER_CH] = {0};
+  double spike_out = 0;
+  for (int n = 0; n < SAMPLE_NUM; n++)
+  {
+    float v[AHRS_FILTER_CH];
+    for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+    {
+      v[ch] = 1000.0f + noise(rng);
+      if (n % 997 == 500 && cfg.median[ch])
+      { // メディアンを設定したチャンネルに単発のスパイク
+        v[ch] = 1.0e6f;
+      }
+    }
+    double want[AHRS_FILTER_CH];
+    for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+    {
+      want[ch] = ref[ch].run(v[ch]);
+    }
+    mrd_ahrs_filter_run(bank, v);
+    for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+    {
+      const double e = fabs(v[ch] - want[ch]);
+      err_max[ch] = (e > err_max[ch]) ? e : err_max[ch];
+    }
+    spike_out = std::max(spike_out, fabs(v[CH_MEDIAN] - 1000.0));
+  }
+
+  bool ok = true;
+  const char *name[] = {"none", "median", "ave8", "ave_max", "median+ave8", "lpf", "median+lpf"};
+  for (int ch = CH_NONE; ch <= CH_MED_LPF; ch++)
+  {
+    printf("%-12s : max err %.2e\n", name[ch], err_max[ch]);
+    ok &= (err_max[ch] <= ((cfg.mode[ch] == AHRS_FILT_LPF) ? TOL_LPF : TOL_STAGE));
+  }
+  printf("median spike residue %.3f (input 1e6)\n", spike_out);
+  ok &= (spike_out <= 1.0);
+  return ok;
+}
+
+/// @brief 正弦波を入力し, 定常になった後の出力の振幅を返す.
+double lpf_gain(double a_freq_hz)
+{
+  AhrsFilterConfig cfg;
+  mrd_ahrs_filter_set_lpf(cfg, 0, LPF_CUTOFF, LPF_RATE_HZ);
+  ahrs_filter_cfg.write(cfg);
+  AhrsFilterBank bank;
+  double amp = 0;
+  const int num = int(LPF_RATE_HZ * 4);
+  for (int n = 0; n < num; n++)
+  {
+    float v[AHRS_FILTER_CH] = {0};
+    v[0] = (a_freq_hz == 0.0) ? 1.0f : float(sin(2.0 * M_PI * a_freq_hz * n / LPF_RATE_HZ));
+    mrd_ahrs_filter_run(bank, v);
+    if (n >= num / 2)
+    {
+      amp = std::max(amp, double(fabs(v[0])));
+    }
+  }
+  return amp;
+}
+
+int main()
+{
+  bool ok = test_stages();
+
+  const double gain_dc = lpf_gain(0.0);
+  const double gain_fc = lpf_gain(LPF_CUTOFF);
+  printf("lpf gain : dc %.4f, %.0f Hz %.4f (want 1/sqrt2 = 0.7071)\n", gain_dc, LPF_CUTOFF, gain_fc);
+  ok &= (fabs(gain_dc - 1.0) <= TOL_GAIN) && (fabs(gain_fc - M_SQRT1_2) <= TOL_GAIN);
+
+  // 全チャンネルに段を設定した場合の1サンプルあたりの処理時間
+  AhrsFilterConfig cfg;
+  for (int ch = 0; ch < AHRS_FILTER_CH; ch++)
+  {
+    mrd_ahrs_filter_set_median(cfg, ch, true);
+    if (ch % 2)
+    {
+      mrd_ahrs_filter_set_ave(cfg, ch, IMUAHRS_STOCK);
+    }
+    else
+    {
+      mrd_ahrs_filter_set_lpf(cfg, ch, LPF_CUTOFF, LPF_RATE_HZ);
+    }
+  }
+  ahrs_filter_cfg.write(cfg);
+  AhrsFilterBank bank;
+  float v[AHRS_FILTER_CH] = {0};
+  auto t0 = std::chrono::steady_clock::now();
+  for (int n = 0; n < BENCH_NUM; n++)
+  {
+    v[n % AHRS_FILTER_CH] += 1.0f;
+    mrd_ahrs_filter_run(bank, v);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  volatile float sink = v[0];
+  (void)sink;
+  printf("mrd_ahrs_filter_run : %.1f ns/sample (16ch)\n",
+         std::chrono::duration<double, std::nano>(t1 - t0).count() / BENCH_NUM);
+
+  return ok ? 0 : 1;
+}
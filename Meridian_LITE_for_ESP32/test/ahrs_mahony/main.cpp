@@ -0,0 +1,183 @@
+// Mahonyフィルタ(ahrs_mahony.h)のIMUログ再生
+//
+// IMUログをセンサ用スレッド(mrd_wire0.hのmrd_wire0_Core0_mpu6050_r)と同じ換算で1サンプルずつ
+// mrd_mahony_updateに通し, ログの基準姿勢(roll_ref, pitch_ref)との差を, 収束待ちのSETTLE_US以降について表示する.
+// 差の平均がTOL_MEAN_DEG, 最大がTOL_MAX_DEGを超えた場合は1を返す. 続けて1サンプルあたりの処理時間を計測する.
+// ログは引数がなければmake_log()で合成する. MPU6050を1kHz, ±8g, ±2000dpsで読んだ場合の生値(LSB)を,
+// ロールとピッチの正弦波揺動から作り, 始めの1秒は傾けたまま静止し, ジャイロのバイアスと加速度, 角速度の
+// ノイズを加える(乱数の種は固定). 実機で記録したログはCSVのファイル名を引数に渡す.
+// CSVの列: t_us, acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z (mrd_wire0_mpu6050_motionの生値), roll_ref, pitch_ref (degree*100)
+//
+// ビルドと実行(Meridian_LITE_for_ESP32で):
+//   g++ -std=c++17 -O2 -I src test/ahrs_mahony/main.cpp -o ahrs_mahony && ./ahrs_mahony [imu_log.csv]
+
+#include "config.h"
+#include "mrd_module/ahrs_mahony.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define SETTLE_US    2000000 // 評価から除く始めの収束待ち(us)
+#define TOL_MEAN_DEG 1.5     // ロールとピッチの差の平均の許容値(degree)
+#define TOL_MAX_DEG  5.0     // ロールとピッチの差の最大の許容値(degree)
+#define BENCH_REP    50      // 処理時間の計測でログを繰り返す回数
+
+// 合成ログの条件
+#define LOG_RATE_HZ      1000   // サンプリング周波数
+#define LOG_DURATION_S   6.0    // ログの長さ(s)
+#define LOG_ACC_NOISE_G  0.02   // 加速度のノイズ(g)
+#define LOG_GYRO_NOISE   0.3    // 角速度のノイズ(dps)
+#define LOG_SEED         43     // 乱数の種
+
+// ログの1行
+struct ImuLogRow
+{
+  uint32_t t_us; // 計測時刻(us)
+  int raw[6];    // acc_x,y,z, gyro_x,y,z
+  int ref[2];    // roll, pitch (degree*100)
+};
+
+/// @brief CSVのIMUログを読み込む. 1行目は見出しとして読み飛ばす.
+bool load_log(const char *a_path, std::vector<ImuLogRow> &a_log)
+{
+  FILE *fp = fopen(a_path, "r");
+  if (fp == nullptr)
+  {
+    return false;
+  }
+  char line[256];
+  fgets(line, sizeof(line), fp);
+  while (fgets(line, sizeof(line), fp))
+  {
+    ImuLogRow r;
+    if (sscanf(line, "%u,%d,%d,%d,%d,%d,%d,%d,%d", &r.t_us, &r.raw[0], &r.raw[1], &r.raw[2], &r.raw[3], &r.raw[4],
+               &r.raw[5], &r.ref[0], &r.ref[1]) == 9)
+    {
+      a_log.push_back(r);
+    }
+  }
+  fclose(fp);
+  return !a_log.empty();
+}
+
+/// @brief 合成ログの時刻a_tのロール, ピッチ(rad)とその時間微分.
+void log_attitude(double a_t, double a_att[4])
+{
+  const double d2r = M_PI / 180.0;
+  if (a_t < 1.0)
+  {
+    a_att[0] = 10.0 * d2r;
+    a_att[1] = -5.0 * d2r;
+    a_att[2] = 0;
+    a_att[3] = 0;
+    return;
+  }
+  const double u = a_t - 1.0;
+  a_att[0] = (10.0 + 25.0 * sin(2 * M_PI * 0.5 * u)) * d2r;
+  a_att[1] = (-5.0 + 15.0 * sin(2 * M_PI * 0.3 * u)) * d2r;
+  a_att[2] = 25.0 * 2 * M_PI * 0.5 * cos(2 * M_PI * 0.5 * u) * d2r;
+  a_att[3] = 15.0 * 2 * M_PI * 0.3 * cos(2 * M_PI * 0.3 * u) * d2r;
+}
+
+/// @brief MPU6050(±8g: 4096LSB/g, ±2000dps: 16.4LSB/dps)の生値の合成ログを作る.
+void make_log(std::vector<ImuLogRow> &a_log)
+{
+  const double gyro_bias_dps[3] = {0.6, -0.3, 0.2};
+  std::mt19937 rng(LOG_SEED);
+  std::normal_distribution<double> acc_noise(0, LOG_ACC_NOISE_G);
+  std::normal_distribution<double> gyro_noise(0, LOG_GYRO_NOISE);
+  for (int n = 0; n < int(LOG_RATE_HZ * LOG_DURATION_S); n++)
+  {
+    double att[4];
+    log_attitude(double(n) / LOG_RATE_HZ, att);
+    const double roll = att[0], pitch = att[1], droll = att[2], dpitch = att[3];
+
+    // ヨー0のZYXオイラー角から体軸の角速度と重力方向
+    const double gyro[3] = {droll, cos(roll) * dpitch, -sin(roll) * dpitch};
+    const double acc[3] = {-sin(pitch), sin(roll) * cos(pitch), cos(roll) * cos(pitch)};
+    ImuLogRow r;
+    r.t_us = uint32_t(int64_t(n) * 1000000 / LOG_RATE_HZ);
+    for (int k = 0; k < 3; k++)
+    {
+      r.raw[k] = int(lround((acc[k] + acc_noise(rng)) * 4096.0));
+      r.raw[3 + k] = int(lround((gyro[k] * 180.0 / M_PI + gyro_bias_dps[k] + gyro_noise(rng)) * 16.4));
+    }
+    r.ref[0] = int(lround(roll * 180.0 / M_PI * 100));
+    r.ref[1] = int(lround(pitch * 180.0 / M_PI * 100));
+    a_log.push_back(r);
+  }
+}
+
+/// @brief ログを先頭から再生する. センサ用スレッドと同じ換算と経過時間で更新する.
+/// @param a_err_sum, a_err_max, a_err_num 基準姿勢との差の集計. nullptrの場合は集計しない.
+/// @return 最後の姿勢のクオータニオンのw.
+float replay(const std::vector<ImuLogRow> &a_log, double *a_err_sum, double *a_err_max, int *a_err_num)
+{
+  const float acc_scale = 9.80665f / 4096.0f; // ±8g: 4096LSB/g
+  const float gyro_scale = 1.0f / 16.4f;      // ±2000dps: 16.4LSB/dps
+  const float deg_to_rad = float(M_PI / 180.0);
+  MahonyFilter filter;
+  uint32_t t_prev = a_log[0].t_us;
+  for (const ImuLogRow &r : a_log)
+  {
+    const float dt = (r.t_us - t_prev) * 1e-6f;
+    t_prev = r.t_us;
+    mrd_mahony_update(filter, r.raw[3] * gyro_scale * deg_to_rad, r.raw[4] * gyro_scale * deg_to_rad,
+                      r.raw[5] * gyro_scale * deg_to_rad, r.raw[0] * acc_scale, r.raw[1] * acc_scale,
+                      r.raw[2] * acc_scale, dt);
+    if (a_err_sum != nullptr && r.t_us - a_log[0].t_us >= SETTLE_US)
+    {
+      float rpy[3];
+      mrd_mahony_euler(filter, rpy);
+      for (int k = 0; k < 2; k++)
+      {
+        const double e = fabs(rpy[k] - r.ref[k] * 0.01);
+        *a_err_sum += e;
+        *a_err_max = (e > *a_err_max) ? e : *a_err_max;
+        (*a_err_num)++;
+      }
+    }
+  }
+  return filter.q[0];
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<ImuLogRow> log;
+  if (argc > 1)
+  {
+    if (!load_log(argv[1], log))
+    {
+      printf("cannot read %s\n", argv[1]);
+      return 1;
+    }
+  }
+  else
+  {
+    make_log(log);
+  }
+
+  double err_sum = 0;
+  double err_max = 0;
+  int err_num = 0;
+  replay(log, &err_sum, &err_max, &err_num);
+  const double err_mean = (err_num > 0) ? err_sum / err_num : 0;
+  printf("%zu samples (%.1f s) : roll/pitch err mean %.2f deg (tol %.1f), max %.2f deg (tol %.1f)\n", log.size(),
+         (log.back().t_us - log.front().t_us) * 1e-6, err_mean, TOL_MEAN_DEG, err_max, TOL_MAX_DEG);
+
+  // 1サンプルあたりの処理時間
+  volatile float sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int rep = 0; rep < BENCH_REP; rep++)
+  {
+    sink = sink + replay(log, nullptr, nullptr, nullptr);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  printf("mrd_mahony_update : %.1f ns/sample\n",
+         std::chrono::duration<double, std::nano>(t1 - t0).count() / (double(BENCH_REP) * log.size()));
+
+  return (err_num == 0 || err_mean > TOL_MEAN_DEG || err_max > TOL_MAX_DEG) ? 1 : 0;
+}
@@ -0,0 +1,404 @@
+// gs2dのCRC-16と受信フレームの区切り(frameLength)による同期の試験
+//
+// crc16.h:
+//   テーブル  : 256個の値が多項式0x8005のビット単位の計算と一致すること
+//   calculate : 乱数のデータ(長さ0-300)でビット単位の計算と一致し, 既知の値("123456789"と
+//               DYNAMIXEL 2.0のPingの例)を返すこと
+//   update    : データを任意の位置で2つに分けてupdate()をつないだ結果がcalculate()と一致すること
+// RobotisP20 / Futaba / B3Mの受信:
+//   分割       : 返信を1回のlistener()では揃わない任意の大きさに分けて届けても, 最後の断片が
+//                届くまで完了せず, 揃った時点で正しいIDと値で1回だけ完了すること
+//   先頭のゴミ : 返信の前に付いたフレームの開始でないバイトを捨てて同期し直すこと
+//                (B3Mは先頭の長さバイトで同期するため, 捨てられるのは0x00のみ)
+//   長すぎる   : 長さが受信バッファに収まらないフレームはResponseErrorで完了し, 次の返信は正しく受け取ること
+//   破損       : チェックサムまたはCRCの合わない返信はResponseErrorで完了すること
+// を, シリアルクラスが1バイトずつ読む場合とまとめて読む場合の両方で確認する.
+// 異常があれば内容を表示して1を返す.
+//
+// ビルドと実行(Meridian_LITE_for_ESP32で):
+//   g++ -std=c++17 -O2 -Wno-narrowing -I lib/gs2d test/gs2d_parser/main.cpp -o gs2d_parser && ./gs2d_parser
+
+#include "gs2d_b3m.h"
+#include "gs2d_command.h"
+#include "gs2d_futaba.h"
+#include "gs2d_robotis.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+
+#define CRC_TRIALS 2000 // calculateとupdateを比べる乱数データの数
+
+static int g_fail = 0;
+
+#define CHECK(cond, ...)         \
+  do                             \
+  {                              \
+    if (!(cond))                 \
+    {                            \
+      printf("NG %s: ", #cond);  \
+      printf(__VA_ARGS__);       \
+      printf("\n");              \
+      g_fail++;                  \
+    }                            \
+  } while (0)
+
+typedef std::vector<uint8_t> Bytes;
+
+//------------------------------------------------------------------------------------
+//  CRC-16
+//------------------------------------------------------------------------------------
+
+/// @brief 多項式0x8005, 初期値0のCRC-16をビット単位で計算する(比較用).
+uint16_t crc16_bitwise(uint16_t a_crc, const uint8_t *a_data, size_t a_len)
+{
+  for (size_t i = 0; i < a_len; i++)
+  {
+    a_crc ^= uint16_t(a_data[i] << 8);
+    for (int b = 0; b < 8; b++)
+    {
+      a_crc = (a_crc & 0x8000) ? uint16_t((a_crc << 1) ^ 0x8005) : uint16_t(a_crc << 1);
+    }
+  }
+  return a_crc;
+}
+
+void test_crc16()
+{
+  // テーブルの各値は1バイトのデータのCRC
+  int bad_table = 0;
+  for (int i = 0; i < 256; i++)
+  {
+    const uint8_t val = uint8_t(i);
+    if (crc16::table[i] != crc16_bitwise(0, &val, 1))
+    {
+      bad_table++;
+    }
+  }
+  CHECK(bad_table == 0, "%d table entries differ", bad_table);
+
+  // 既知の値
+  uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  CHECK(crc16::calculate(check, 9) == 0xFEE8, "crc(\"123456789\")=0x%04X", crc16::calculate(check, 9));
+  uint8_t ping[] = {0xFF, 0xFF, 0xFD, 0x00, 0x01, 0x03, 0x00, 0x01};
+  CHECK(crc16::calculate(ping, 8) == 0x4E19, "crc(ping)=0x%04X", crc16::calculate(ping, 8));
+
+  // 乱数のデータでcalculateとupdateのつなぎ方を比べる
+  std::mt19937 rng(20260101);
+  int bad_calc = 0, bad_update = 0;
+  uint8_t buf[300];
+  for (int n = 0; n < CRC_TRIALS; n++)
+  {
+    const uint16_t len = uint16_t(rng() % (sizeof(buf) + 1));
+    for (uint16_t i = 0; i < len; i++)
+    {
+      buf[i] = uint8_t(rng());
+    }
+    const uint16_t whole = crc16::calculate(buf, len);
+    if (whole != crc16_bitwise(0, buf, len))
+    {
+      bad_calc++;
+    }
+    const uint16_t split = uint16_t(len ? rng() % (len + 1) : 0);
+    if (crc16::update(crc16::update(0, buf, split), buf + split, uint16_t(len - split)) != whole)
+    {
+      bad_update++;
+    }
+  }
+  CHECK(bad_calc == 0, "%d/%d calculate() results differ", bad_calc, CRC_TRIALS);
+  CHECK(bad_update == 0, "%d/%d split update() results differ", bad_update, CRC_TRIALS);
+  printf("crc16  : table, calculate and update match the bitwise CRC\n");
+}
+
+//------------------------------------------------------------------------------------
+//  仮想のシリアルポート
+//------------------------------------------------------------------------------------
+
+/// @brief 試験側がfeed()で渡したバイトだけを受信済みとして返すgs2d用のシリアルクラス.
+///        1バイトずつ読む read() のみを持つ.
+class ByteSerial
+{
+public:
+  std::deque<uint8_t> rx;
+  int write_cnt = 0;
+
+  int open(void) { return 0; }
+  void close(void) {}
+  int isConnected(void) { return 1; }
+  int write(unsigned char *, unsigned char a_size)
+  {
+    write_cnt++;
+    return a_size;
+  }
+  // 時刻は進めない(試験中にタイムアウトさせない)
+  unsigned long long int time(void) { return 0; }
+
+  int read(void)
+  {
+    if (rx.empty())
+    {
+      return -1;
+    }
+    const uint8_t val = rx.front();
+    rx.pop_front();
+    return val;
+  }
+
+  void feed(const uint8_t *a_data, size_t a_len) { rx.insert(rx.end(), a_data, a_data + a_len); }
+};
+
+/// @brief まとめて読む read(uint8_t*, int) も持つシリアルクラス.
+class BulkSerial : public ByteSerial
+{
+public:
+  using ByteSerial::read;
+  int read(uint8_t *a_data, int a_size)
+  {
+    int count = 0;
+    while (count < a_size && !rx.empty())
+    {
+      a_data[count++] = rx.front();
+      rx.pop_front();
+    }
+    return count;
+  }
+};
+
+/// @brief 試験用に保護メンバを公開するドライバ.
+template <class Base>
+class TestDriver : public Base
+{
+public:
+  auto &port() { return this->serialPort; }
+  bool trafficFree() { return this->isTrafficFree.get(); }
+  void bus() { this->listener(); }
+};
+
+//------------------------------------------------------------------------------------
+//  各プロトコルの返信
+//------------------------------------------------------------------------------------
+
+/// @brief DYNAMIXEL 2.0. 現在位置(4バイト)の返信.
+struct Robotis
+{
+  template <class S>
+  using Driver = TestDriver<gs2d::RobotisP20<S>>;
+  static constexpr const char *name = "robotis";
+
+  static Bytes reply(uint8_t a_id, uint32_t a_raw)
+  {
+    Bytes pkt = {0xFF, 0xFF, 0xFD, 0x00, a_id, 8, 0, 0x55, 0,
+                 uint8_t(a_raw), uint8_t(a_raw >> 8), uint8_t(a_raw >> 16), uint8_t(a_raw >> 24)};
+    const uint16_t crc = crc16::calculate(pkt.data(), uint16_t(pkt.size()));
+    pkt.push_back(crc & 0xFF);
+    pkt.push_back(crc >> 8);
+    return pkt;
+  }
+  static double value(uint32_t a_raw) { return a_raw * 360.0 / 4096.0 - 180.0; }
+  static uint32_t raw(uint8_t a_id) { return 2048 + a_id * 37; }
+  // ヘッダの一部を含むゴミ
+  static Bytes garbage() { return {0x00, 0xFF, 0xFD, 0xFF, 0xFF, 0xFF, 0xFD, 0x01, 0xFF}; }
+  // 長さ0x00C8のフレームの先頭
+  static Bytes oversize() { return {0xFF, 0xFF, 0xFD, 0x00, 1, 0xC8, 0x00, 0x55, 0, 1, 2, 3}; }
+};
+
+/// @brief Futabaコマンド方式. 現在位置(2バイト)の返信.
+struct Futaba
+{
+  template <class S>
+  using Driver = TestDriver<gs2d::Futaba<S>>;
+  static constexpr const char *name = "futaba";
+
+  static Bytes reply(uint8_t a_id, uint32_t a_raw)
+  {
+    Bytes pkt = {0xFD, 0xDF, a_id, 0x00, 0x2A, 2, 1, uint8_t(a_raw), uint8_t(a_raw >> 8)};
+    uint8_t sum = 0;
+    for (size_t i = 2; i < pkt.size(); i++)
+    {
+      sum ^= pkt[i];
+    }
+    pkt.push_back(sum);
+    return pkt;
+  }
+  static double value(uint32_t a_raw) { return -int16_t(a_raw) / 10.0; }
+  static uint32_t raw(uint8_t a_id) { return uint16_t(-300 + a_id * 41); }
+  static Bytes garbage() { return {0x00, 0xDF, 0xFD, 0xFD, 0x12, 0xDF}; }
+  // 長さ0xF0のフレームの先頭
+  static Bytes oversize() { return {0xFD, 0xDF, 1, 0x00, 0x2A, 0xF0, 1, 1, 2, 3}; }
+};
+
+/// @brief B3M. 現在位置(2バイト)の返信.
+struct B3m
+{
+  template <class S>
+  using Driver = TestDriver<gs2d::B3M<S>>;
+  static constexpr const char *name = "b3m";
+
+  static Bytes reply(uint8_t a_id, uint32_t a_raw)
+  {
+    Bytes pkt = {7, 0x83, 0x00, a_id, uint8_t(a_raw), uint8_t(a_raw >> 8)};
+    uint32_t sum = 0;
+    for (uint8_t val : pkt)
+    {
+      sum += val;
+    }
+    pkt.push_back(sum & 0xFF);
+    return pkt;
+  }
+  static double value(uint32_t a_raw) { return -int16_t(a_raw) / 100.0; }
+  static uint32_t raw(uint8_t a_id) { return uint16_t(-9000 + a_id * 523); }
+  // 長さバイトで同期するため, フレームの開始でないと判定できるのは0x00のみ
+  static Bytes garbage() { return {0x00, 0x00, 0x00}; }
+  // 長さ0xFFのフレームの先頭
+  static Bytes oversize() { return {0xFF, 0x83, 0x00, 1, 1, 2, 3}; }
+};
+
+//------------------------------------------------------------------------------------
+//  試験
+//------------------------------------------------------------------------------------
+
+// コールバックで受け取った結果
+struct Result
+{
+  int num = 0;
+  uint8_t id = 0;
+  uint8_t status = 0;
+  double val = 0;
+};
+static Result g_res;
+
+void parser_cb(gs2d::CallbackEventArgs a_e)
+{
+  g_res.num++;
+  g_res.id = a_e.id;
+  g_res.status = a_e.status;
+  g_res.val = static_cast<gs2d::gFloat>(a_e.data);
+}
+
+/// @brief 現在位置の読込みを1つ送り, a_bytesをa_chunksの大きさに分けて届ける.
+///        最後の断片より前に完了した場合はfalseを返す.
+template <class Drv>
+bool exchange(Drv &a_drv, uint8_t a_id, const Bytes &a_bytes, const std::vector<size_t> &a_chunks)
+{
+  g_res = Result();
+  a_drv.readCurrentPosition(a_id, parser_cb);
+  a_drv.bus(); // 送信
+  a_drv.bus(); // 返信はまだ無い
+
+  bool early = (g_res.num != 0);
+  size_t pos = 0;
+  for (size_t n = 0; n < a_chunks.size(); n++)
+  {
+    a_drv.port().feed(a_bytes.data() + pos, a_chunks[n]);
+    pos += a_chunks[n];
+    a_drv.bus();
+    if (n + 1 < a_chunks.size() && g_res.num != 0)
+    {
+      early = true;
+    }
+  }
+  return !early;
+}
+
+/// @brief 正しい返信を受け取ったか確認する.
+template <class P>
+bool reply_ok(const char *a_case, uint8_t a_id, uint32_t a_raw)
+{
+  const bool ok = g_res.num == 1 && g_res.status == 0 && g_res.id == a_id &&
+                  std::fabs(g_res.val - P::value(a_raw)) < 1e-3;
+  CHECK(ok, "%s %s: num=%d status=0x%x id=%d val=%f (expect id=%d val=%f)", P::name, a_case, g_res.num,
+        g_res.status, g_res.id, g_res.val, a_id, P::value(a_raw));
+  return ok;
+}
+
+/// @brief 1つのプロトコルとシリアルクラスの組み合わせを試験する.
+template <class P, class S>
+void test_parser(const char *a_serial)
+{
+  typename P::template Driver<S> drv;
+  drv.setAutoSend(false);
+  drv.changeOperatingMode(true);
+
+  // 分割: 同じ大きさの断片に分ける場合と, 任意の位置で2つに分ける場合
+  int split_cases = 0, split_fail = 0;
+  uint8_t id = 1;
+  const size_t len = P::reply(1, 0).size();
+  std::vector<std::vector<size_t>> plans;
+  for (size_t size = 1; size <= len; size++)
+  {
+    std::vector<size_t> plan;
+    for (size_t pos = 0; pos < len; pos += size)
+    {
+      plan.push_back(std::min(size, len - pos));
+    }
+    plans.push_back(plan);
+  }
+  for (size_t cut = 1; cut < len; cut++)
+  {
+    plans.push_back({cut, len - cut});
+  }
+  for (const auto &plan : plans)
+  {
+    id = uint8_t(1 + split_cases % 100);
+    const bool not_early = exchange(drv, id, P::reply(id, P::raw(id)), plan);
+    CHECK(not_early, "%s/%s split %zu pieces: completed before the last piece", P::name, a_serial, plan.size());
+    if (!not_early || !reply_ok<P>("split", id, P::raw(id)))
+    {
+      split_fail++;
+    }
+    split_cases++;
+  }
+  CHECK(drv.port().write_cnt == split_cases, "%s/%s sent %d commands for %d reads", P::name, a_serial,
+        drv.port().write_cnt, split_cases);
+
+  // 先頭のゴミ. ゴミと返信を1バイトずつ届ける場合とまとめて届ける場合
+  id = 42;
+  Bytes dirty = P::garbage();
+  const Bytes good = P::reply(id, P::raw(id));
+  dirty.insert(dirty.end(), good.begin(), good.end());
+  exchange(drv, id, dirty, std::vector<size_t>(dirty.size(), 1));
+  reply_ok<P>("garbage bytewise", id, P::raw(id));
+  exchange(drv, id, dirty, {dirty.size()});
+  reply_ok<P>("garbage at once", id, P::raw(id));
+
+  // 長すぎるフレームはResponseErrorで完了し, 次の返信は受け取れる
+  const Bytes big = P::oversize();
+  exchange(drv, 1, big, {big.size()});
+  CHECK(g_res.num == 1 && g_res.status == gs2d::ResponseError, "%s/%s oversize: num=%d status=0x%x", P::name,
+        a_serial, g_res.num, g_res.status);
+  CHECK(drv.trafficFree(), "%s/%s oversize: bus still busy", P::name, a_serial);
+  id = 7;
+  exchange(drv, id, P::reply(id, P::raw(id)), {3, P::reply(id, 0).size() - 3});
+  reply_ok<P>("after oversize", id, P::raw(id));
+
+  // 末尾のチェックサム/CRCが合わない返信
+  Bytes bad = P::reply(id, P::raw(id));
+  bad.back() ^= 0x5A;
+  exchange(drv, id, bad, {bad.size()});
+  CHECK(g_res.num == 1 && g_res.status == gs2d::ResponseError, "%s/%s corrupt: num=%d status=0x%x", P::name,
+        a_serial, g_res.num, g_res.status);
+
+  printf("%-7s: %-5s serial, %d split replies (%d failed), garbage, oversize and corrupt frames\n", P::name,
+         a_serial, split_cases, split_fail);
+}
+
+int main()
+{
+  test_crc16();
+  test_parser<Robotis, ByteSerial>("byte");
+  test_parser<Robotis, BulkSerial>("bulk");
+  test_parser<Futaba, ByteSerial>("byte");
+  test_parser<Futaba, BulkSerial>("bulk");
+  test_parser<B3m, ByteSerial>("byte");
+  test_parser<B3m, BulkSerial>("bulk");
+  if (g_fail)
+  {
+    printf("NG: %d failures\n", g_fail);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,345 @@
+// gs2dのコマンドキュー(setAutoSend(false))を制御側とバスタスクの2スレッドで動かす試験
+//
+// 仮想のシリアルポート(送信したコマンドに即座に返信を返す)を使い,
+//   同期読込みの拒否 : 即時送信しない設定で返信を戻り値で待つ呼出しは, バスタスクがlistener()を
+//                      回している間もハングせずにBadInputErrorで戻り, コマンドを送らないこと
+//   2スレッド負荷    : 制御側が同期書込みとコールバック付きの読込みを積み続け, バスタスクが送受信する.
+//                      積めた読込みは全てコールバックが正しいIDと値で返り, 積めた書込みは全て送信され,
+//                      積めなかった呼出しは全てSystemErrorを返すこと
+//   KRSの満杯と同期  : KRSドライバでも満杯時にSystemErrorを返し, コマンドを送るたびに受信リングバッファを
+//                      空にして, 前のコマンドの返信の後ろに付いてきたバイトを次の返信と取り違えないこと
+// を確認する. 異常があれば内容を表示して1を返す. WATCHDOG_MS以内に終わらない場合もハングとして1を返す.
+//
+// ビルドと実行(Meridian_LITE_for_ESP32で). データ競合の検出はThreadSanitizerで行う:
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -Wno-narrowing -I lib/gs2d test/gs2d_queue/main.cpp -o gs2d_queue -lpthread && ./gs2d_queue
+
+#include "gs2d_command.h"
+#include "gs2d_krs.h"
+#include "gs2d_robotis.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+
+#define QUEUE_SIZE   8      // コマンドバッファの要素数
+#define STRESS_OPS   200000 // 2スレッド負荷で制御側が積む呼出しの数
+#define SERVO_NUM    10     // 仮想サーボの数(ID 1-10)
+#define WATCHDOG_MS  20000  // ハングとみなす時間(ms)
+
+static int g_fail = 0;
+
+#define CHECK(cond, ...)         \
+  do                             \
+  {                              \
+    if (!(cond))                 \
+    {                            \
+      printf("NG %s: ", #cond);  \
+      printf(__VA_ARGS__);       \
+      printf("\n");              \
+      g_fail++;                  \
+    }                            \
+  } while (0)
+
+//------------------------------------------------------------------------------------
+//  仮想のシリアルポート
+//------------------------------------------------------------------------------------
+
+/// @brief 送信したコマンドに即座に返信を返すgs2d用のシリアルクラスの基底.
+///        送受信はlistener()を呼ぶスレッドのみが行うため, 内部の状態はロックしない.
+class FakeSerialBase
+{
+protected:
+  std::deque<uint8_t> m_rx;
+
+public:
+  int open(void) { return 0; }
+  void close(void) {}
+  int isConnected(void) { return 1; }
+
+  int read(void)
+  {
+    if (m_rx.empty())
+    {
+      return -1;
+    }
+    const uint8_t val = m_rx.front();
+    m_rx.pop_front();
+    return val;
+  }
+
+  unsigned long long int time(void)
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+};
+
+/// @brief 仮想のサーボが返す現在位置の生の値.
+uint32_t raw_pos(uint8_t a_id) { return 2048 + a_id * 100; }
+
+/// @brief DYNAMIXEL 2.0の仮想バス. Readに現在位置を返し, SyncWriteは数えるのみ.
+class FakeDxl2Serial : public FakeSerialBase
+{
+public:
+  std::atomic<uint32_t> read_cnt{0};       // 受け取ったReadの数
+  std::atomic<uint32_t> sync_write_cnt{0}; // 受け取ったSyncWriteの数
+
+  int write(unsigned char *a_data, unsigned char a_size)
+  {
+    if (a_size < 8)
+    {
+      return a_size;
+    }
+    const uint8_t id = a_data[4];
+    if (a_data[7] == 0x83)
+    {
+      sync_write_cnt++;
+    }
+    else if (a_data[7] == 0x02)
+    {
+      read_cnt++;
+      const uint32_t pos = raw_pos(id);
+      uint8_t pkt[15] = {0xFF, 0xFF, 0xFD, 0x00, id, 8, 0, 0x55, 0, uint8_t(pos), uint8_t(pos >> 8),
+                         uint8_t(pos >> 16), uint8_t(pos >> 24), 0, 0};
+      const uint16_t crc = crc16::calculate(pkt, 13);
+      pkt[13] = crc & 0xFF;
+      pkt[14] = crc >> 8;
+      m_rx.insert(m_rx.end(), pkt, pkt + 15);
+    }
+    return a_size;
+  }
+};
+
+/// @brief ICSの仮想バス(gs2dのKRSドライバ用). 現在位置の読込みに返信し, 指定した場合は返信の後ろに
+///        別のサーボの返信に見えるバイトを付ける.
+class FakeIcsSerial : public FakeSerialBase
+{
+public:
+  bool trailing = false; // 返信の後ろにID 9の返信に見えるバイトを付けるか
+
+  int write(unsigned char *a_data, unsigned char a_size)
+  {
+    if (a_size == 2 && (a_data[0] & 0xE0) == 0xA0 && a_data[1] == 0x05)
+    {
+      const uint8_t id = a_data[0] & 0x1F;
+      const uint32_t pos = 7500 + id * 10;
+      const uint8_t pkt[4] = {uint8_t(0x20 | id), 0x05, uint8_t((pos >> 7) & 0x7F), uint8_t(pos & 0x7F)};
+      m_rx.insert(m_rx.end(), pkt, pkt + 4);
+      if (trailing)
+      {
+        const uint8_t stray[4] = {0x20 | 9, 0x05, 0x3A, 0x4C};
+        m_rx.insert(m_rx.end(), stray, stray + 4);
+      }
+    }
+    return a_size;
+  }
+};
+
+/// @brief 試験用に保護メンバを公開するドライバ.
+template <class Base>
+class TestDriver : public Base
+{
+public:
+  auto &port() { return this->serialPort; }
+  bool trafficFree() { return this->isTrafficFree.get(); }
+  void bus() { this->listener(); }
+};
+
+using Dxl2Driver = TestDriver<gs2d::RobotisP20<FakeDxl2Serial, QUEUE_SIZE>>;
+using KrsDriver = TestDriver<gs2d::KRS<FakeIcsSerial, 2>>;
+
+//------------------------------------------------------------------------------------
+//  試験
+//------------------------------------------------------------------------------------
+
+/// @brief バスタスク. a_runが下りるまでlistener()を回す. 1回ごとに制御側に譲る.
+template <class Drv>
+void bus_task(Drv &a_drv, std::atomic<bool> &a_run)
+{
+  while (a_run.load(std::memory_order_acquire))
+  {
+    a_drv.bus();
+    std::this_thread::yield();
+  }
+}
+
+/// @brief 即時送信しない設定での同期読込みの拒否.
+void test_sync_refused()
+{
+  Dxl2Driver drv;
+  drv.setAutoSend(false);
+  std::atomic<bool> run{true};
+  std::thread bus(bus_task<Dxl2Driver>, std::ref(drv), std::ref(run));
+
+  for (int i = 0; i < 1000; i++)
+  {
+    const gs2d::gFloat val = drv.readCurrentPosition(1 + i % SERVO_NUM);
+    CHECK(val == 0, "sync read returned %f", double(val));
+    CHECK(drv.getErrorCode() & gs2d::BadInputError, "sync read error=0x%x", drv.getErrorCode());
+  }
+  run = false;
+  bus.join();
+  CHECK(drv.port().read_cnt == 0, "sync read sent %u commands", drv.port().read_cnt.load());
+  printf("refused: 1000 sync reads rejected with BadInputError\n");
+}
+
+// 2スレッド負荷のコールバックの集計
+std::atomic<uint32_t> g_cb_ok{0};
+std::atomic<uint32_t> g_cb_bad{0};
+
+/// @brief 2スレッド負荷の読込みのコールバック. IDと値が仮想サーボの返信と一致するか確認する.
+void stress_cb(gs2d::CallbackEventArgs a_e)
+{
+  const double expect = raw_pos(a_e.id) * 360.0 / 4096.0 - 180.0;
+  if (a_e.status != 0 || a_e.id < 1 || a_e.id > SERVO_NUM ||
+      std::fabs(double(static_cast<gs2d::gFloat>(a_e.data)) - expect) > 1e-3)
+  {
+    g_cb_bad++;
+    return;
+  }
+  g_cb_ok++;
+}
+
+/// @brief 制御側とバスタスクの2スレッド負荷.
+void test_two_thread()
+{
+  Dxl2Driver drv;
+  drv.setAutoSend(false);
+  drv.changeOperatingMode(true);
+  std::atomic<bool> run{true};
+  std::thread bus(bus_task<Dxl2Driver>, std::ref(drv), std::ref(run));
+
+  uint8_t ids[SERVO_NUM];
+  gs2d::gFloat pos[SERVO_NUM];
+  for (int i = 0; i < SERVO_NUM; i++)
+  {
+    ids[i] = i + 1;
+    pos[i] = 0;
+  }
+
+  uint32_t write_ok = 0, read_ok = 0, dropped = 0, other_err = 0;
+  for (int n = 0; n < STRESS_OPS; n++)
+  {
+    if (n & 1)
+    {
+      drv.readCurrentPosition(1 + (n / 2) % SERVO_NUM, stress_cb);
+    }
+    else
+    {
+      pos[n % SERVO_NUM] = gs2d::gFloat(n % 90);
+      drv.burstWriteTargetPositions(ids, pos, SERVO_NUM);
+    }
+    const uint8_t err = drv.getErrorCode();
+    if (err == gs2d::SystemError)
+    { // 満杯ならバスタスクに譲る
+      dropped++;
+      std::this_thread::yield();
+    }
+    else if (err != 0)
+    {
+      other_err++;
+    }
+    else
+    {
+      (n & 1) ? read_ok++ : write_ok++;
+    }
+  }
+
+  // 積めたコマンドが全て処理されるまで待つ
+  const auto t0 = std::chrono::steady_clock::now();
+  while (g_cb_ok + g_cb_bad < read_ok || drv.port().sync_write_cnt < write_ok)
+  {
+    if (std::chrono::steady_clock::now() - t0 > std::chrono::seconds(5))
+    {
+      break;
+    }
+    std::this_thread::yield();
+  }
+  run = false;
+  bus.join();
+
+  CHECK(other_err == 0, "unexpected errors=%u", other_err);
+  CHECK(write_ok + read_ok + dropped == STRESS_OPS, "ok=%u+%u dropped=%u", write_ok, read_ok, dropped);
+  CHECK(g_cb_bad == 0, "bad callbacks=%u", g_cb_bad.load());
+  CHECK(g_cb_ok == read_ok, "callbacks=%u queued reads=%u", g_cb_ok.load(), read_ok);
+  CHECK(drv.port().read_cnt == read_ok, "sent reads=%u queued=%u", drv.port().read_cnt.load(), read_ok);
+  CHECK(drv.port().sync_write_cnt == write_ok, "sent writes=%u queued=%u", drv.port().sync_write_cnt.load(),
+        write_ok);
+  printf("stress : %d calls, writes %u, reads %u, dropped (SystemError) %u\n", STRESS_OPS, write_ok, read_ok,
+         dropped);
+}
+
+// KRSの試験のコールバックで受け取ったIDと値
+uint8_t g_krs_id[8];
+double g_krs_val[8];
+int g_krs_num = 0;
+
+void krs_cb(gs2d::CallbackEventArgs a_e)
+{
+  if (g_krs_num < 8)
+  {
+    g_krs_id[g_krs_num] = (a_e.status == 0) ? a_e.id : 0xFF;
+    g_krs_val[g_krs_num] = static_cast<gs2d::gFloat>(a_e.data);
+  }
+  g_krs_num++;
+}
+
+/// @brief KRSドライバの満杯の扱いと, 送信ごとの受信リングバッファのリセット.
+void test_krs()
+{
+  KrsDriver drv;
+  drv.setAutoSend(false);
+  drv.changeOperatingMode(true);
+  drv.port().trailing = true;
+
+  // 容量(2)までは積め, 次は積めずにSystemErrorを返す
+  const int cap = 2;
+  for (int i = 0; i < cap; i++)
+  {
+    drv.readCurrentPosition(1 + i, krs_cb);
+    CHECK(drv.getErrorCode() == 0, "krs read %d error=0x%x", i, drv.getErrorCode());
+  }
+  drv.readCurrentPosition(3, krs_cb);
+  CHECK(drv.getErrorCode() == gs2d::SystemError, "krs full error=0x%x", drv.getErrorCode());
+
+  // 返信の後ろのID 9のバイトを次のコマンドの返信と取り違えないこと
+  for (int n = 0; n < 100 && g_krs_num < cap; n++)
+  {
+    drv.bus();
+  }
+  CHECK(g_krs_num == cap, "krs callbacks=%d", g_krs_num);
+  for (int i = 0; i < cap && i < g_krs_num; i++)
+  {
+    const double expect = (7500.0 - (7500 + (i + 1) * 10)) / 29.629;
+    CHECK(g_krs_id[i] == i + 1 && std::fabs(g_krs_val[i] - expect) < 1e-3, "krs reply %d id=%d val=%f", i,
+          g_krs_id[i], g_krs_val[i]);
+  }
+  CHECK(drv.trafficFree(), "krs not idle after replies");
+  printf("krs    : full queue -> SystemError, trailing bytes discarded on send\n");
+}
+
+int main()
+{
+  // ハングした場合は試験を打ち切る
+  std::thread([] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(WATCHDOG_MS));
+    printf("NG: hung for %d ms\n", WATCHDOG_MS);
+    fflush(stdout);
+    std::_Exit(1);
+  }).detach();
+
+  test_sync_refused();
+  test_two_thread();
+  test_krs();
+  if (g_fail)
+  {
+    printf("NG: %d failures\n", g_fail);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
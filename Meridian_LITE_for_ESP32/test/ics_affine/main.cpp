@@ -0,0 +1,153 @@
+// ICSサーボの角度変換(ics_affine.h)の固定小数点版とMeridianライブラリのfloat版の比較
+//
+// config.hのIXL/IXR/IXC_TRIMにある全てのトリム値と両方の回転方向について,
+//   degree*100 → ICSポジション値 : int16の全ての値
+//   ICSポジション値 → degree*100 : 3500-11500の全ての値
+// を変換し, float版との差の最大値を表示する. 差がTOL_POSまたはTOL_CDEGを超えた場合は1を返す.
+// 続けて両方の変換の1回あたりの時間を計測する(PC上の値なので, ESP32での比は目安).
+//
+// ビルドと実行(Meridian_LITE_for_ESP32で):
+//   g++ -std=c++17 -O2 -I src test/ics_affine/main.cpp -o ics_affine && ./ics_affine
+
+#include "config.h"
+#include "mrd_module/ics_affine.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define TOL_POS  1 // degree*100 → ICSポジション値の許容差
+#define TOL_CDEG 1 // ICSポジション値 → degree*100 の許容差
+
+//------------------------------------------------------------------------------------
+//  Meridianライブラリのfloat版(比較の基準)
+//------------------------------------------------------------------------------------
+
+int ref_deg2krs(float a_deg, float a_trim, int a_cw)
+{
+  float x = 7500 + (a_trim * 29.6296) + (a_deg * 29.6296 * a_cw);
+  if (x > 11500)
+  {
+    x = 11500;
+  }
+  else if (x < 3500)
+  {
+    x = 3500;
+  }
+  return int(x);
+}
+
+float ref_krs2deg(int a_krs, float a_trim, int a_cw)
+{
+  return (a_krs - 7500 - (a_trim * 29.6296)) * 0.03375 * a_cw;
+}
+
+short ref_float2hfshort(float a_val)
+{
+  int x = round(a_val * 100);
+  if (x > 32766)
+  {
+    x = 32767;
+  }
+  else if (x < -32766)
+  {
+    x = -32767;
+  }
+  return short(x);
+}
+
+//------------------------------------------------------------------------------------
+//  比較と計測
+//------------------------------------------------------------------------------------
+
+struct Combo
+{
+  float trim;
+  int cw;
+};
+
+/// @brief 設定表で使われているトリム値と回転方向の組を重複なしで集める. 回転方向は両方とも加える.
+std::vector<Combo> collect_combos()
+{
+  std::vector<Combo> combos;
+  auto add = [&](const float *a_trim, int a_num) {
+    for (int i = 0; i < a_num; i++)
+    {
+      for (int cw = -1; cw <= 1; cw += 2)
+      {
+        bool found = false;
+        for (const Combo &c : combos)
+        {
+          found |= (c.trim == a_trim[i] && c.cw == cw);
+        }
+        if (!found)
+        {
+          combos.push_back({a_trim[i], cw});
+        }
+      }
+    }
+  };
+  add(IXL_TRIM, IXL_MAX);
+  add(IXR_TRIM, IXR_MAX);
+  add(IXC_TRIM, IXC_MAX);
+  return combos;
+}
+
+int main()
+{
+  const std::vector<Combo> combos = collect_combos();
+  int err_pos_max = 0;
+  int err_cdeg_max = 0;
+  for (const Combo &c : combos)
+  {
+    const IcsAffine aff = mrd_servo_ics_affine(c.trim, c.cw);
+    int err_pos = 0;
+    int err_cdeg = 0;
+    for (int cdeg = -32768; cdeg <= 32767; cdeg++)
+    {
+      const int d = abs(mrd_servo_cdeg2ics(int16_t(cdeg), aff) - ref_deg2krs(cdeg * 0.01, c.trim, c.cw));
+      err_pos = (d > err_pos) ? d : err_pos;
+    }
+    for (int pos = ICS_POS_MIN; pos <= ICS_POS_MAX; pos++)
+    {
+      const int d = abs(mrd_servo_ics2cdeg(pos, aff) - ref_float2hfshort(ref_krs2deg(pos, c.trim, c.cw)));
+      err_cdeg = (d > err_cdeg) ? d : err_cdeg;
+    }
+    printf("trim %8.2f cw %2d : pos err %d, cdeg err %d\n", c.trim, c.cw, err_pos, err_cdeg);
+    err_pos_max = (err_pos > err_pos_max) ? err_pos : err_pos_max;
+    err_cdeg_max = (err_cdeg > err_cdeg_max) ? err_cdeg : err_cdeg_max;
+  }
+  printf("%zu combos : max pos err %d (tol %d), max cdeg err %d (tol %d)\n", combos.size(), err_pos_max, TOL_POS,
+         err_cdeg_max, TOL_CDEG);
+
+  // 1回あたりの変換時間
+  const int rep = 200;
+  const IcsAffine aff = mrd_servo_ics_affine(combos[combos.size() / 2].trim, combos[combos.size() / 2].cw);
+  const float trim = combos[combos.size() / 2].trim;
+  const int cw = combos[combos.size() / 2].cw;
+  volatile int sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rep; r++)
+  {
+    for (int cdeg = -32768; cdeg <= 32767; cdeg++)
+    {
+      sink = sink + mrd_servo_cdeg2ics(int16_t(cdeg), aff) + mrd_servo_ics2cdeg(sink & 0x1FFF, aff);
+    }
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rep; r++)
+  {
+    for (int cdeg = -32768; cdeg <= 32767; cdeg++)
+    {
+      sink = sink + ref_deg2krs(cdeg * 0.01, trim, cw) + ref_float2hfshort(ref_krs2deg(sink & 0x1FFF, trim, cw));
+    }
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  const double n = double(rep) * 65536.0;
+  printf("round trip : Q24 %.2f ns, float %.2f ns\n",
+         std::chrono::duration<double, std::nano>(t1 - t0).count() / n,
+         std::chrono::duration<double, std::nano>(t2 - t1).count() / n);
+
+  return (err_pos_max > TOL_POS || err_cdeg_max > TOL_CDEG) ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+// test/ics_simをPC上でビルドするためのArduino.hの代用
+//
+// IcsBaseClassとsv_ics_drive.hが使う型と時間関数のみを用意する.
+// 時刻は実時間ではなく, delay()とdelayMicroseconds()で進む仮想の時計とする.
+
+#ifndef __MERIDIAN_TEST_HOST_ARDUINO_H__
+#define __MERIDIAN_TEST_HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef uint8_t byte;
+
+/// @brief 仮想の時計(us).
+inline uint32_t &host_clock_us()
+{
+  static uint32_t clock_us = 0;
+  return clock_us;
+}
+
+inline unsigned long micros() { return host_clock_us(); }
+inline unsigned long millis() { return host_clock_us() / 1000; }
+inline void delayMicroseconds(unsigned int a_us) { host_clock_us() += a_us; }
+inline void delay(unsigned long a_ms) { host_clock_us() += a_ms * 1000; }
+
+#endif // __MERIDIAN_TEST_HOST_ARDUINO_H__
@@ -0,0 +1,279 @@
+// ICSサーボの駆動処理(sv_ics_drive.h)を仮想バス(sv_ics_sim.h)で動かす試験
+//
+// L,R系統にSV_NUM個ずつの仮想サーボを取り付け, mrd_sv_drive_ics_doubleで毎フレーム駆動し,
+//   返信あり    : stale, errが立たず, syncedが立つこと. 通信時間が 送信+返信遅延+返信 の和であること
+//   強制タイムアウト(inject_timeout) : 返信なしのフレームでstaleが立ち, SERVO_LOST_ERR_WAITフレーム目に
+//                 errが立ち, 返信が戻ったフレームで両方が下りること. 通信時間にタイムアウト時間が入ること
+//   確率タイムアウト(set_fault_rate) : 毎フレームのstaleの数と通信時間がタイムアウト数と一致し,
+//                 errが連続stale数から決まる値と一致すること. 同じ種なら同じ結果を再現すること
+// を確認する. 異常があれば内容を表示して1を返す.
+//
+// ビルドと実行(Meridian_LITE_for_ESP32で). Arduino.hはtest/ics_simにある代用品を使う.
+// IcsBaseClass::synchronize()は派生クラスのみが定義するため, ESP32と同じく-fno-rttiでビルドする:
+//   g++ -std=c++17 -O2 -fno-rtti -I test/ics_sim -I src -I lib/IcsClass_V210/src test/ics_sim/main.cpp lib/IcsClass_V210/src/IcsBaseClass.cpp -o ics_sim && ./ics_sim
+
+#include "config.h"
+#include "mrd_servo_param.h"
+#include "mrd_module/sv_ics_drive.h"
+#include "mrd_module/sv_ics_sim.h"
+
+#include <cstdio>
+#include <cstring>
+
+#define SV_NUM        8    // 1系統あたりの仮想サーボ数
+#define SV_LATENCY_US 100  // 仮想サーボの返信遅延(us)
+#define SV_LOST_IDX   2    // 強制タイムアウトを注入するサーボのインデックス
+#define FAULT_PERMIL  300  // 確率タイムアウトの発生率(1000回あたり)
+#define FAULT_FRAMES  2000 // 確率タイムアウトの試験フレーム数
+#define FAULT_SEED    12345
+
+static int g_fail = 0;
+
+#define CHECK(cond, ...)         \
+  do                             \
+  {                              \
+    if (!(cond))                 \
+    {                            \
+      printf("NG %s: ", #cond);  \
+      printf(__VA_ARGS__);       \
+      printf("\n");              \
+      g_fail++;                  \
+    }                            \
+  } while (0)
+
+//------------------------------------------------------------------------------------
+//  通信時間の期待値(sv_ics_sim.hとは独立に計算する)
+//------------------------------------------------------------------------------------
+
+/// @brief 8E1で3バイト送る時間(us, 切り上げ).
+uint64_t wire3_us(long a_baudrate) { return (3ULL * 11 * 1000000 + a_baudrate - 1) / a_baudrate; }
+
+/// @brief 返信ありの1回の通信時間(us).
+uint64_t ok_us(long a_baudrate) { return wire3_us(a_baudrate) * 2 + SV_LATENCY_US; }
+
+/// @brief タイムアウトした1回の通信時間(us).
+uint64_t to_us(long a_baudrate, int a_timeout_ms) { return wire3_us(a_baudrate) + uint64_t(a_timeout_ms) * 1000; }
+
+//------------------------------------------------------------------------------------
+//  試験の準備と1フレーム分の駆動
+//------------------------------------------------------------------------------------
+
+const uint32_t MASK = (1UL << SV_NUM) - 1;
+
+/// @brief サーボパラメータを初期化し, 仮想バスにサーボを取り付ける. IDはインデックス+1とする.
+void sim_setup(ServoParam &a_sv, IcsSimBusClass &a_bus_l, IcsSimBusClass &a_bus_r)
+{
+  a_sv = ServoParam();
+  a_sv.num_max = SV_NUM;
+  IcsSimBusClass *bus_tmp[2] = {&a_bus_l, &a_bus_r};
+  for (int line = 0; line < 2; line++)
+  {
+    a_sv.mount[line] = MASK;
+    for (int i = 0; i < SV_NUM; i++)
+    {
+      a_sv.type[line][i] = KOICS3;
+      a_sv.id[line][i] = i + 1;
+      a_sv.cw[line][i] = (i & 1) ? -1 : 1;
+      a_sv.ics[line][i] = mrd_servo_ics_affine(0, a_sv.cw[line][i]);
+      bus_tmp[line]->mount(i + 1, SV_LATENCY_US);
+    }
+  }
+}
+
+/// @brief 1フレーム分の目標値を設定してL,R系統を駆動する. 目標値は毎フレーム変える.
+void sim_frame(Meridim90Union &a_meridim, ServoParam &a_sv, int a_frame, IcsBaseClass &a_bus_l,
+               IcsBaseClass &a_bus_r)
+{
+  for (int line = 0; line < 2; line++)
+  {
+    const int orig = (line == 0) ? MRD_L_ORIGIDX : MRD_R_ORIGIDX;
+    for (int i = 0; i < SV_NUM; i++)
+    {
+      a_meridim.sval[orig + i * 2] = 1; // ポジション指定
+      a_sv.tgt_past[line][i] = a_sv.tgt[line][i];
+      a_sv.tgt[line][i] = int16_t(((a_frame * 37 + i * 500) % 6000) - 3000);
+    }
+  }
+  mrd_sv_drive_ics_double(a_meridim, a_sv, a_sv.mount[L], a_sv.mount[R], a_bus_l, a_bus_r);
+}
+
+//------------------------------------------------------------------------------------
+//  試験
+//------------------------------------------------------------------------------------
+
+/// @brief 全サーボが返信する場合.
+void test_clean()
+{
+  ServoParam sv;
+  Meridim90Union meridim = {};
+  IcsSimBusClass bus_l(SERVO_BAUDRATE_L, SERVO_TIMEOUT_L);
+  IcsSimBusClass bus_r(SERVO_BAUDRATE_R, SERVO_TIMEOUT_R);
+  sim_setup(sv, bus_l, bus_r);
+
+  sim_frame(meridim, sv, 1, bus_l, bus_r);
+  for (int line = 0; line < 2; line++)
+  {
+    CHECK(sv.stale[line] == 0, "line %d stale=0x%x", line, sv.stale[line]);
+    CHECK(sv.err[line] == 0, "line %d err=0x%x", line, sv.err[line]);
+    CHECK(sv.synced[line] == MASK, "line %d synced=0x%x", line, sv.synced[line]);
+  }
+  CHECK(bus_l.tx_count() == SV_NUM, "L tx=%u", bus_l.tx_count());
+  CHECK(bus_l.bus_us() == SV_NUM * ok_us(SERVO_BAUDRATE_L), "L bus_us=%llu expect=%llu",
+        (unsigned long long)bus_l.bus_us(), (unsigned long long)(SV_NUM * ok_us(SERVO_BAUDRATE_L)));
+  CHECK(bus_r.bus_us() == SV_NUM * ok_us(SERVO_BAUDRATE_R), "R bus_us=%llu expect=%llu",
+        (unsigned long long)bus_r.bus_us(), (unsigned long long)(SV_NUM * ok_us(SERVO_BAUDRATE_R)));
+  printf("clean  : L %llu us, R %llu us / frame\n", (unsigned long long)bus_l.bus_us(),
+         (unsigned long long)bus_r.bus_us());
+}
+
+/// @brief 1個のサーボにSERVO_LOST_ERR_WAIT回の強制タイムアウトを注入する場合.
+void test_inject()
+{
+  ServoParam sv;
+  Meridim90Union meridim = {};
+  IcsSimBusClass bus_l(SERVO_BAUDRATE_L, SERVO_TIMEOUT_L);
+  IcsSimBusClass bus_r(SERVO_BAUDRATE_R, SERVO_TIMEOUT_R);
+  sim_setup(sv, bus_l, bus_r);
+  sim_frame(meridim, sv, 0, bus_l, bus_r);
+
+  const uint32_t bit = 1UL << SV_LOST_IDX;
+  bus_l.inject_timeout(sv.id[L][SV_LOST_IDX], SERVO_LOST_ERR_WAIT);
+  for (int k = 1; k <= SERVO_LOST_ERR_WAIT; k++)
+  {
+    bus_l.reset_stats();
+    bus_r.reset_stats();
+    sim_frame(meridim, sv, k, bus_l, bus_r);
+    const uint32_t err_expect = (k >= SERVO_LOST_ERR_WAIT) ? bit : 0;
+    CHECK(sv.stale[L] == bit, "frame %d L stale=0x%x", k, sv.stale[L]);
+    CHECK(sv.err[L] == err_expect, "frame %d L err=0x%x expect=0x%x", k, sv.err[L], err_expect);
+    CHECK(!(sv.synced[L] & bit), "frame %d L synced=0x%x", k, sv.synced[L]);
+    CHECK(sv.stale[R] == 0 && sv.err[R] == 0, "frame %d R stale=0x%x err=0x%x", k, sv.stale[R], sv.err[R]);
+
+    // 返信がないサーボは前回の目標値で代用する(固定小数点の往復で1以内)
+    const int diff = sv.tgt[L][SV_LOST_IDX] - sv.tgt_past[L][SV_LOST_IDX];
+    CHECK(diff >= -1 && diff <= 1, "frame %d stale value=%d past=%d", k, sv.tgt[L][SV_LOST_IDX],
+          sv.tgt_past[L][SV_LOST_IDX]);
+
+    const uint64_t expect = (SV_NUM - 1) * ok_us(SERVO_BAUDRATE_L) + to_us(SERVO_BAUDRATE_L, SERVO_TIMEOUT_L);
+    CHECK(bus_l.bus_us() == expect, "frame %d L bus_us=%llu expect=%llu", k, (unsigned long long)bus_l.bus_us(),
+          (unsigned long long)expect);
+    CHECK(bus_l.timeout_count() == 1, "frame %d L timeout=%u", k, bus_l.timeout_count());
+  }
+
+  // 返信が戻ればstaleとerrは下りる
+  sim_frame(meridim, sv, SERVO_LOST_ERR_WAIT + 1, bus_l, bus_r);
+  CHECK(sv.stale[L] == 0 && sv.err[L] == 0, "recover L stale=0x%x err=0x%x", sv.stale[L], sv.err[L]);
+  CHECK(sv.synced[L] == MASK, "recover L synced=0x%x", sv.synced[L]);
+  CHECK(sv.err_cnt[L][SV_LOST_IDX] == 0, "recover err_cnt=%d", sv.err_cnt[L][SV_LOST_IDX]);
+  printf("inject : %d frames lost, err after frame %d\n", SERVO_LOST_ERR_WAIT, SERVO_LOST_ERR_WAIT);
+}
+
+// 確率タイムアウトの試験結果
+struct FaultResult
+{
+  uint32_t timeout[2] = {0};  // タイムアウト数
+  uint64_t bus_us[2] = {0};   // 積算通信時間(us)
+  uint32_t err_frames = 0;    // errが立っていたサーボ×フレームの数
+  uint32_t hash = 2166136261; // 毎フレームのstaleとerrのFNV-1aハッシュ
+};
+
+/// @brief 種を指定して確率タイムアウトの試験を行う.
+FaultResult run_fault(uint32_t a_seed)
+{
+  FaultResult res;
+  ServoParam sv;
+  Meridim90Union meridim = {};
+  IcsSimBusClass bus_l(SERVO_BAUDRATE_L, SERVO_TIMEOUT_L);
+  IcsSimBusClass bus_r(SERVO_BAUDRATE_R, SERVO_TIMEOUT_R);
+  IcsSimBusClass *bus_tmp[2] = {&bus_l, &bus_r};
+  const long baud[2] = {SERVO_BAUDRATE_L, SERVO_BAUDRATE_R};
+  const int timeout_ms[2] = {SERVO_TIMEOUT_L, SERVO_TIMEOUT_R};
+  sim_setup(sv, bus_l, bus_r);
+  bus_l.set_fault_rate(FAULT_PERMIL, 0, a_seed);
+  bus_r.set_fault_rate(FAULT_PERMIL, 0, a_seed * 7 + 1);
+
+  int consec[2][SV_NUM] = {{0}};
+  for (int f = 0; f < FAULT_FRAMES; f++)
+  {
+    uint32_t to_prev[2];
+    uint64_t us_prev[2];
+    for (int line = 0; line < 2; line++)
+    {
+      to_prev[line] = bus_tmp[line]->timeout_count();
+      us_prev[line] = bus_tmp[line]->bus_us();
+    }
+    sim_frame(meridim, sv, f, bus_l, bus_r);
+    for (int line = 0; line < 2; line++)
+    {
+      const uint32_t to_num = bus_tmp[line]->timeout_count() - to_prev[line];
+      const uint64_t us_num = bus_tmp[line]->bus_us() - us_prev[line];
+      const uint32_t stale_num = __builtin_popcount(sv.stale[line]);
+      CHECK(stale_num == to_num, "frame %d line %d stale=%u timeout=%u", f, line, stale_num, to_num);
+      const uint64_t expect = (SV_NUM - to_num) * ok_us(baud[line]) + to_num * to_us(baud[line], timeout_ms[line]);
+      CHECK(us_num == expect, "frame %d line %d bus_us=%llu expect=%llu", f, line, (unsigned long long)us_num,
+            (unsigned long long)expect);
+
+      // errは連続したstaleの数がSERVO_LOST_ERR_WAITに届いたサーボのみ
+      uint32_t err_expect = 0;
+      for (int i = 0; i < SV_NUM; i++)
+      {
+        consec[line][i] = (sv.stale[line] & (1UL << i)) ? consec[line][i] + 1 : 0;
+        if (consec[line][i] >= SERVO_LOST_ERR_WAIT)
+        {
+          err_expect |= 1UL << i;
+        }
+      }
+      CHECK(sv.err[line] == err_expect, "frame %d line %d err=0x%x expect=0x%x", f, line, sv.err[line], err_expect);
+      CHECK((sv.synced[line] & sv.stale[line]) == 0, "frame %d line %d synced=0x%x stale=0x%x", f, line,
+            sv.synced[line], sv.stale[line]);
+      res.err_frames += __builtin_popcount(sv.err[line]);
+      res.hash = (res.hash ^ sv.stale[line]) * 16777619;
+      res.hash = (res.hash ^ sv.err[line]) * 16777619;
+    }
+  }
+  for (int line = 0; line < 2; line++)
+  {
+    res.timeout[line] = bus_tmp[line]->timeout_count();
+    res.bus_us[line] = bus_tmp[line]->bus_us();
+    CHECK(bus_tmp[line]->tx_count() == uint32_t(FAULT_FRAMES * SV_NUM), "line %d tx=%u", line,
+          bus_tmp[line]->tx_count());
+  }
+  return res;
+}
+
+/// @brief 確率タイムアウトの試験. 同じ種で2回実行し, 結果が一致することも確認する.
+void test_fault_rate()
+{
+  const FaultResult res_a = run_fault(FAULT_SEED);
+  const FaultResult res_b = run_fault(FAULT_SEED);
+  CHECK(memcmp(res_a.timeout, res_b.timeout, sizeof res_a.timeout) == 0 &&
+            memcmp(res_a.bus_us, res_b.bus_us, sizeof res_a.bus_us) == 0 && res_a.hash == res_b.hash,
+        "seed %d not reproducible", FAULT_SEED);
+
+  // 発生率がおおむね設定どおりで, errに届く連続タイムアウトも起きていること
+  const uint32_t total = FAULT_FRAMES * SV_NUM;
+  for (int line = 0; line < 2; line++)
+  {
+    CHECK(res_a.timeout[line] > total * FAULT_PERMIL / 1000 * 9 / 10 &&
+              res_a.timeout[line] < total * FAULT_PERMIL / 1000 * 11 / 10,
+          "line %d timeout=%u / %u", line, res_a.timeout[line], total);
+  }
+  CHECK(res_a.err_frames > 0, "no servo reached SERVO_LOST_ERR_WAIT");
+  printf("fault  : timeout L %u R %u / %u, err %u servo-frames, L %llu us, R %llu us\n", res_a.timeout[0],
+         res_a.timeout[1], total, res_a.err_frames, (unsigned long long)res_a.bus_us[0],
+         (unsigned long long)res_a.bus_us[1]);
+}
+
+int main()
+{
+  test_clean();
+  test_inject();
+  test_fault_rate();
+  if (g_fail)
+  {
+    printf("NG: %d failures\n", g_fail);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
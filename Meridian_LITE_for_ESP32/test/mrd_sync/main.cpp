@@ -0,0 +1,174 @@
+// mrd_sync.hのスレッド間受け渡しの2スレッド負荷試験
+//
+// MrdTripleBuffer : 書込み側が連番と連番から決まる値の一式を公開し続け, 読出し側が
+//                   一式が欠けていないこと(torn), 連番が戻らないこと(backward), 最後の一式に
+//                   必ず追いつくこと(lost)を確認する.
+// MrdSpscRing     : 書込み側が連番を積み続け, 読出し側が取り出した要素が欠けておらず連番が増加のみで,
+//                   取り出した数と捨てた数(dropped)の和がpush()の呼出し数と一致することを確認する.
+//                   前半は満杯なら積めるまで再試行し(連番が1ずつ増えることも確認), 後半は満杯なら捨てる.
+// 異常があれば内容を表示して1を返す.
+//
+// ビルドと実行(Meridian_LITE_for_ESP32で). データ競合の検出はThreadSanitizerで行う:
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -I src test/mrd_sync/main.cpp -o mrd_sync -lpthread && ./mrd_sync
+
+#include "mrd_sync.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#define TB_PUBLISH_NUM 1000000 // トリプルバッファに公開する一式の数
+#define RING_PUSH_NUM  1000000 // リングに積む要素の数
+#define RING_LEN       64      // リングの長さ
+
+// トリプルバッファで受け渡す一式(AhrsSampleと同程度の大きさ)
+struct TbSample
+{
+  float v[16];
+  uint32_t seq;
+};
+
+// リングで受け渡す要素
+struct RingItem
+{
+  uint32_t seq;
+  uint32_t check;
+};
+
+/// @brief 連番から一式の各値を決める.
+inline float tb_value(uint32_t a_seq, int a_k)
+{
+  return float(a_seq % 100000) + a_k;
+}
+
+/// @brief MrdTripleBufferの試験.
+/// @return 異常がなければtrue.
+bool test_triple_buffer()
+{
+  MrdTripleBuffer<TbSample> tb;
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (uint32_t i = 1; i <= TB_PUBLISH_NUM; i++)
+    {
+      TbSample &s = tb.back();
+      for (int k = 0; k < 16; k++)
+      {
+        s.v[k] = tb_value(i, k);
+      }
+      s.seq = i;
+      tb.publish();
+    }
+    done.store(true);
+  });
+
+  bool ok = true;
+  uint32_t last = 0;
+  uint32_t reads = 0;
+  uint32_t fresh = 0;
+  while (ok)
+  {
+    const bool done_tmp = done.load();
+    TbSample s;
+    if (tb.read(s))
+    {
+      fresh++;
+    }
+    reads++;
+    if (s.seq != 0)
+    {
+      for (int k = 0; k < 16; k++)
+      {
+        if (s.v[k] != tb_value(s.seq, k))
+        {
+          printf("triple buffer: TORN seq %u k %d\n", s.seq, k);
+          ok = false;
+          break;
+        }
+      }
+      if (s.seq < last)
+      {
+        printf("triple buffer: BACKWARD %u -> %u\n", last, s.seq);
+        ok = false;
+      }
+      last = s.seq;
+    }
+    if (done_tmp && last == TB_PUBLISH_NUM)
+    {
+      break;
+    }
+    if (done_tmp && !tb.update() && last != TB_PUBLISH_NUM)
+    { // 書込みが終わった後に, 最後の一式に追いつけない
+      printf("triple buffer: LOST last %u\n", last);
+      ok = false;
+    }
+  }
+  writer.join();
+  printf("triple buffer: %s reads %u fresh %u last %u\n", ok ? "ok" : "NG", reads, fresh, last);
+  return ok;
+}
+
+/// @brief MrdSpscRingの試験.
+/// @return 異常がなければtrue.
+bool test_spsc_ring()
+{
+  static MrdSpscRing<RingItem, RING_LEN> ring;
+  std::atomic<bool> done{false};
+  uint32_t attempts = 0;
+  std::thread producer([&] {
+    for (uint32_t i = 1; i <= RING_PUSH_NUM; i++)
+    {
+      attempts++;
+      while (!ring.push(RingItem{i, i * 3 + 1}) && i <= RING_PUSH_NUM / 2)
+      { // 前半は取り出されるまで待って積み直す
+        attempts++;
+        std::this_thread::yield();
+      }
+    }
+    done.store(true);
+  });
+
+  bool ok = true;
+  uint32_t last = 0;
+  uint32_t got = 0;
+  auto check = [&](const RingItem &a_item) {
+    if (a_item.check != a_item.seq * 3 + 1)
+    {
+      printf("spsc ring: TORN seq %u\n", a_item.seq);
+      ok = false;
+    }
+    if (a_item.seq <= last || (a_item.seq <= RING_PUSH_NUM / 2 && a_item.seq != last + 1))
+    {
+      printf("spsc ring: ORDER %u -> %u\n", last, a_item.seq);
+      ok = false;
+    }
+    last = a_item.seq;
+    got++;
+  };
+  RingItem item;
+  while (ok && !done.load())
+  {
+    if (ring.pop(item))
+    {
+      check(item);
+    }
+  }
+  producer.join();
+  while (ok && ring.pop(item))
+  {
+    check(item);
+  }
+  if (got + ring.dropped() != attempts)
+  {
+    printf("spsc ring: COUNT got %u + dropped %u != %u\n", got, ring.dropped(), attempts);
+    ok = false;
+  }
+  printf("spsc ring: %s got %u dropped %u last %u\n", ok ? "ok" : "NG", got, ring.dropped(), last);
+  return ok;
+}
+
+int main()
+{
+  const bool tb_ok = test_triple_buffer();
+  const bool ring_ok = test_spsc_ring();
+  return (tb_ok && ring_ok) ? 0 : 1;
+}